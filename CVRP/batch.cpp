@@ -0,0 +1,175 @@
+#include "batch.h"
+#include "parser.h"
+#include "distances.h"
+#include "parallel.h"
+#include "tabu.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <atomic>
+#include <cerrno>
+#include <stdint.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    struct instanceFile{
+        string name;
+        uint64_t size;
+    };
+
+    string joinPath(const string& directory, const string& name){
+        if (directory.empty()) return name;
+        char last = directory.back();
+        return last == '/' || last == '\\' ? directory + name : directory + '/' + name;
+    }
+
+    bool hasVrpExtension(const string& name){
+        return name.size() > 4 && name.compare(name.size() - 4, 4, ".vrp") == 0;
+    }
+
+    // Returns the name and size of every .vrp file in a directory
+    vector<instanceFile> listInstances(const string& directory){
+        vector<instanceFile> files;
+#ifdef _WIN32
+        WIN32_FIND_DATAA entry;
+        HANDLE search = FindFirstFileA(joinPath(directory, "*.vrp").c_str(), &entry);
+        if (search == INVALID_HANDLE_VALUE) throw runtime_error("Batch directory could not be read.");
+        do{
+            if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+            instanceFile file;
+            file.name = entry.cFileName;
+            file.size = (static_cast<uint64_t>(entry.nFileSizeHigh) << 32) | entry.nFileSizeLow;
+            if (hasVrpExtension(file.name)) files.push_back(file);
+        } while (FindNextFileA(search, &entry));
+        FindClose(search);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) throw runtime_error("Batch directory could not be read.");
+        while (dirent* entry = readdir(dir)){
+            instanceFile file;
+            file.name = entry->d_name;
+            if (!hasVrpExtension(file.name)) continue;
+            struct stat status;
+            if (stat(joinPath(directory, file.name).c_str(), &status) != 0 || !S_ISREG(status.st_mode)) continue;
+            file.size = static_cast<uint64_t>(status.st_size);
+            files.push_back(file);
+        }
+        closedir(dir);
+#endif
+        return files;
+    }
+
+    void makeDirectory(const string& directory){
+#ifdef _WIN32
+        if (_mkdir(directory.c_str()) != 0 && errno != EEXIST) throw runtime_error("Output directory could not be created.");
+#else
+        if (mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST) throw runtime_error("Output directory could not be created.");
+#endif
+    }
+
+    // Loads, solves and writes out a single instance, recording any failure in the result
+    batchResult solveInstance(const batchOptions& options, const string& outputDirectory, const string& name,
+                              tabu::searchWorkspace& workspace){
+        CVRP_SCOPE("instance");
+        chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+        batchResult result;
+        result.instance = name;
+        try{
+            problemParameters problem = loadProblem(joinPath(options.inputDirectory, name));
+            result.nodes = problem.dimension;
+            tabu::searchControl control;
+            if (options.timeLimit > 0) control.setTimeLimit(options.timeLimit);
+            control.iterationLimit = options.iterationLimit;
+            control.localSearch = options.localSearch;
+            control.savingsNeighbours = options.savingsNeighbours;
+            control.savingsSweep = options.savingsSweep;
+            control.sweepThreads = 1;
+            control.routeOptimization = options.routeOptimization;
+            control.workspace = &workspace;
+            distanceCache distances(problem, max(defaultNeighbourCount, options.savingsNeighbours));
+            default_random_engine rng(options.seed);
+            compactSolution best = tabu::taburoute(problem.nodes, problem.capacity, distances, rng, control);
+            result.cost = best.reportedCost();
+            result.vehicles = best.routeCount();
+            result.feasible = best.isFeasible(problem.capacity);
+            ofstream out(joinPath(outputDirectory, name.substr(0, name.size() - 4) + ".sol"));
+            if (!out) throw runtime_error("Result file could not be written.");
+            best.printSolution(out);
+        }
+        catch (const exception& e){
+            result.error = e.what();
+        }
+        result.seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        return result;
+    }
+
+    // Quotes a CSV field if it contains a separator, quote or line break
+    string csvField(const string& field){
+        if (field.find_first_of(",\"\n\r") == string::npos) return field;
+        string quoted = "\"";
+        for (char c : field){
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+
+}
+
+vector<batchResult> cvrp::solveBatch(const batchOptions& options){
+    string outputDirectory = options.outputDirectory.empty() ? options.inputDirectory : options.outputDirectory;
+    makeDirectory(outputDirectory);
+    vector<instanceFile> files = listInstances(options.inputDirectory);
+    // Results are kept in name order; work is handed out largest file first, file size being a proxy for
+    // instance size that needs no parsing
+    sort(files.begin(), files.end(), [](const instanceFile& a, const instanceFile& b) { return a.name < b.name; });
+    vector<size_t> order(files.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return files[a].size > files[b].size; });
+
+    vector<batchResult> results(files.size());
+    {
+        threadPool pool(options.jobs);
+        vector<tabu::searchWorkspace> workspaces(pool.size());
+        // Each worker takes the largest instance not yet started whenever it finishes one
+        atomic<size_t> next(0);
+        for (size_t w = 0; w < pool.size(); w++){
+            pool.submit([&](size_t worker){
+                for (size_t k = next++; k < order.size(); k = next++){
+                    size_t i = order[k];
+                    results[i] = solveInstance(options, outputDirectory, files[i].name, workspaces[worker]);
+                }
+            });
+        }
+        pool.wait();
+    }
+    ofstream summary(joinPath(outputDirectory, "summary.csv"));
+    if (!summary) throw runtime_error("Summary file could not be written.");
+    writeBatchSummary(summary, results);
+    return results;
+}
+
+void cvrp::writeBatchSummary(ostream& out, const vector<batchResult>& results){
+    out << "instance,nodes,cost,vehicles,seconds,feasible,error\n";
+    for (const auto& r : results){
+        out << csvField(r.instance) << ',' << r.nodes << ',' << fixed << setprecision(6) << r.cost << ','
+            << r.vehicles << ',' << setprecision(3) << r.seconds << ',' << (r.feasible ? "yes" : "no") << ','
+            << csvField(r.error) << '\n';
+    }
+    out.flush();
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    struct batchOptions{
+        batchOptions()
+            : jobs(0), seed(0), timeLimit(0), iterationLimit(0), localSearch(true), savingsNeighbours(0),
+              savingsSweep(false), routeOptimization(true) {}
+        // Directory searched for .vrp files
+        string inputDirectory;
+        // Directory the result files and summary are written to; the input directory if empty
+        string outputDirectory;
+        // Number of instances solved at once, or 0 for one per hardware thread
+        size_t jobs;
+        unsigned seed;
+        // Time and iteration limits applied to each instance (0 disables)
+        double timeLimit;
+        size_t iterationLimit;
+        // Applies local search within each Taburoute search
+        bool localSearch;
+        // Nearest neighbours per customer in the savings list, or 0 to choose by problem size
+        size_t savingsNeighbours;
+        // Starts each search from the best of a savings parameter sweep, run on the instance's own job thread
+        bool savingsSweep;
+        // Reorders the routes changed by each tabu move with intra-route 2-opt
+        bool routeOptimization;
+    };
+
+    struct batchResult{
+        batchResult()
+            : nodes(0), cost(0), vehicles(0), seconds(0), feasible(false) {}
+        string instance;
+        int nodes;
+        double cost;
+        size_t vehicles;
+        // Time taken to load and solve the instance
+        double seconds;
+        bool feasible;
+        // Reason the instance could not be solved, if any
+        string error;
+    };
+
+    // Solves every .vrp file in a directory with Taburoute, running one instance per worker thread and starting
+    // the largest files first so that a long instance is not left running alone at the end. Each worker keeps its
+    // search scratch space from one instance to the next.
+    // Writes each solution to <instance>.sol in the output directory, along with summary.csv, and returns the
+    // results in instance name order.
+    vector<batchResult> solveBatch(const batchOptions& options);
+
+    // Writes results as CSV with a header row
+    void writeBatchSummary(ostream& out, const vector<batchResult>& results);
+
+}
@@ -0,0 +1,605 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "cvrp.h"
+#include "parser.h"
+#include "distances.h"
+#include "savings.h"
+#include "localsearch.h"
+#include "tabu.h"
+#include "generator.h"
+#include "checker.h"
+#include "telemetry.h"
+#include "dynamic.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+using namespace cvrp;
+
+// Benchmark of the solver's phases over a deterministic suite of generated instances. Every phase of every
+// instance is run several times, reporting the median and 95th percentile times, the peak resident memory of the
+// process so far, the solution quality and, given the JSON output of an earlier run, the change in time and cost
+// since then.
+// With --dynamic N it instead replays N random customer events on the dynamic solver for each instance, checking
+// the solution after every event.
+
+namespace{
+
+    const size_t defaultSizes[] = { 100, 1000, 5000 };
+    // The full suite; the complete savings list is only built for instances below sparseSavingsThreshold nodes
+    const size_t fullSizes[] = { 100, 200, 500, 1000, 2000, 5000, 10000, 20000 };
+
+    const char* phaseNames[] = { "parse", "distances", "savings", "clarkeWright", "sparseSavings", "sparseClarkeWright",
+                                 "localSearch", "geni", "tabu", "total" };
+    enum phase { parsePhase, distancesPhase, savingsPhase, clarkeWrightPhase, sparseSavingsPhase,
+                 sparseClarkeWrightPhase, localSearchPhase, geniPhase, tabuPhase, totalPhase, phaseCount };
+
+    struct benchOptions{
+        benchOptions()
+            : repeat(3), iterations(1000), seed(1), sparseNeighbours(defaultSparseSavingsNeighbours),
+              dynamicEvents(0) {}
+        vector<instanceType> types;
+        vector<size_t> sizes;
+        size_t repeat;
+        size_t iterations;
+        unsigned seed;
+        // Nearest neighbours per customer in the sparse savings list
+        size_t sparseNeighbours;
+        // Random events replayed on the dynamic solver for each instance, or 0 to benchmark the phases
+        size_t dynamicEvents;
+        string jsonFilename;
+        string baselineFilename;
+    };
+
+    struct phaseTiming{
+        phaseTiming()
+            : median(0), p95(0) {}
+        double median;
+        double p95;
+    };
+
+    struct instanceResult{
+        instanceResult()
+            : customers(0), capacity(0), feasible(false), cost(0), clarkeWrightCost(0), sparseClarkeWrightCost(0),
+              lowerBound(0), geniCalls(0), processPeakBytes(0) {}
+        string name;
+        instanceType type;
+        size_t customers;
+        int capacity;
+        bool feasible;
+        string error;
+        double cost;
+        // Cost of the Clarke-Wright solution from the complete savings list, or 0 if it was not built
+        double clarkeWrightCost;
+        double sparseClarkeWrightCost;
+        double lowerBound;
+        size_t geniCalls;
+        // Peak resident memory of the process by the end of the instance, which includes every earlier instance
+        size_t processPeakBytes;
+        phaseTiming phases[phaseCount];
+        // Telemetry counter totals over every repetition, if instrumentation is compiled in
+        vector<uint64_t> counters;
+    };
+
+    struct dynamicResult{
+        dynamicResult()
+            : customers(0), feasible(true), infeasibleEvents(0), initialCost(0), finalCost(0), improvedCost(0),
+              improveSeconds(0) {}
+        string name;
+        size_t customers;
+        bool feasible;
+        // Events after which the solution failed the check, and the first failure
+        size_t infeasibleEvents;
+        string error;
+        double initialCost;
+        // Cost after the last event, and after the final improve()
+        double finalCost;
+        double improvedCost;
+        phaseTiming eventTime;
+        double improveSeconds;
+    };
+
+    // Results of an earlier run, by instance name
+    struct baselineEntry{
+        double cost;
+        double totalMedian;
+    };
+
+    // Returns the highest resident memory of the process since it started
+    size_t peakResidentBytes(){
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+    }
+
+    double secondsSince(chrono::steady_clock::time_point start){
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    // Returns the value at the given fraction of the sorted samples, by the nearest rank method, or 0 if the
+    // phase was not run
+    double percentile(vector<double> samples, double fraction){
+        if (samples.empty()) return 0;
+        sort(samples.begin(), samples.end());
+        size_t rank = static_cast<size_t>(ceil(fraction * samples.size()));
+        return samples[rank == 0 ? 0 : rank - 1];
+    }
+
+    // Lower bound on the cost of any solution: each unit of demand must be carried out from the depot and the
+    // vehicle brought back, by a vehicle carrying at most 'capacity' units
+    double radialLowerBound(const problemParameters& problem, const distanceCache& distances){
+        double bound = 0;
+        for (size_t i = 1; i < problem.nodes.size(); i++) bound += distances(0, i) * problem.nodes[i].demand;
+        return 2 * bound / problem.capacity;
+    }
+
+    // Reinserts the first customer of every route of 'routes' with GENI, returning the number of insertions
+    size_t runGeniInsertions(const compactSolution& routes, tabu::geniWorkspace& workspace){
+        const distanceCache& distances = routes.problemDistances();
+        vector<uint16_t> tour;
+        size_t calls = 0;
+        for (size_t r = 0; r < routes.routeCount(); r++){
+            size_t length = routes.routeLength(r);
+            if (length < 2) continue;
+            tour.assign(1, 0);
+            tour.insert(tour.end(), routes.route(r) + 1, routes.route(r) + length);
+            uint16_t v = routes.route(r)[0];
+            tabu::geniMove move = tabu::geniEvaluate(tour.data(), tour.size(), v, distances, workspace);
+            tabu::geniApply(tour.data(), tour.size(), v, move, workspace.insertedTour);
+            calls++;
+        }
+        return calls;
+    }
+
+    instanceResult runInstance(instanceType type, size_t customers, const benchOptions& options){
+        instanceResult result;
+        result.type = type;
+        result.customers = customers;
+        uint32_t instanceSeed = options.seed * 1000003u + static_cast<uint32_t>(type) * 65536u
+                              + static_cast<uint32_t>(customers);
+        problemParameters generated = generateProblem(type, customers, instanceSeed);
+        result.name = generated.name;
+        result.capacity = generated.capacity;
+        ostringstream text;
+        writeProblem(text, generated);
+        string data = text.str();
+        generated = problemParameters();
+
+        vector<double> samples[phaseCount];
+        telemetry::reset();
+        try{
+            for (size_t rep = 0; rep < options.repeat; rep++){
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                chrono::steady_clock::time_point phaseStart = start;
+                problemParameters problem = parseProblem(data.data(), data.size(), result.name);
+                samples[parsePhase].push_back(secondsSince(phaseStart));
+
+                phaseStart = chrono::steady_clock::now();
+                distanceCache distances(problem, max(defaultNeighbourCount, options.sparseNeighbours));
+                samples[distancesPhase].push_back(secondsSince(phaseStart));
+
+                // The search continues from the complete list's solution where it is built, as the solver does
+                compactSolution initial;
+                if (problem.nodes.size() < sparseSavingsThreshold){
+                    phaseStart = chrono::steady_clock::now();
+                    vector<saving> savings = calculateSavings(problem.nodes, distances);
+                    samples[savingsPhase].push_back(secondsSince(phaseStart));
+
+                    phaseStart = chrono::steady_clock::now();
+                    initial = calculateClarkeWrightRoutes(problem.nodes, savings, problem.capacity, distances);
+                    samples[clarkeWrightPhase].push_back(secondsSince(phaseStart));
+                    result.clarkeWrightCost = initial.cost();
+                }
+
+                phaseStart = chrono::steady_clock::now();
+                vector<compactSaving> sparseSavings = calculateSparseSavings(problem.nodes, distances,
+                                                                             options.sparseNeighbours);
+                samples[sparseSavingsPhase].push_back(secondsSince(phaseStart));
+
+                phaseStart = chrono::steady_clock::now();
+                compactSolution sparse = calculateClarkeWrightRoutes(problem.nodes, sparseSavings, problem.capacity,
+                                                                     distances);
+                samples[sparseClarkeWrightPhase].push_back(secondsSince(phaseStart));
+                vector<compactSaving>().swap(sparseSavings);
+                result.sparseClarkeWrightCost = sparse.cost();
+                if (initial.routeCount() == 0) initial = sparse;
+
+                tabu::searchWorkspace workspace;
+                phaseStart = chrono::steady_clock::now();
+                result.geniCalls = runGeniInsertions(initial, workspace.geni);
+                samples[geniPhase].push_back(secondsSince(phaseStart));
+
+                phaseStart = chrono::steady_clock::now();
+                local::improve(initial, problem.capacity, workspace.localSearch);
+                initial.removeEmptyRoutes();
+                samples[localSearchPhase].push_back(secondsSince(phaseStart));
+
+                phaseStart = chrono::steady_clock::now();
+                tabu::searchControl control;
+                control.iterationLimit = options.iterations;
+                control.workspace = &workspace;
+                default_random_engine rng(options.seed);
+                compactSolution best = tabu::improve(initial, problem.capacity, rng, control);
+                samples[tabuPhase].push_back(secondsSince(phaseStart));
+                samples[totalPhase].push_back(secondsSince(start));
+
+                // Check the solution as printed, independently of the solver's own bookkeeping
+                stringstream printed;
+                best.printSolution(printed);
+                checkResult check = checkSolution(problem, printed);
+                result.feasible = check.feasible;
+                result.error = check.error;
+                result.cost = check.cost;
+                result.lowerBound = radialLowerBound(problem, distances);
+            }
+        }
+        catch (const exception& e){
+            result.feasible = false;
+            result.error = e.what();
+            return result;
+        }
+        for (size_t p = 0; p < phaseCount; p++){
+            result.phases[p].median = percentile(samples[p], 0.5);
+            result.phases[p].p95 = percentile(samples[p], 0.95);
+        }
+        result.processPeakBytes = peakResidentBytes();
+        if (telemetry::compiledIn) result.counters = telemetry::totals();
+        return result;
+    }
+
+    // Checks the dynamic solver's current solution as printed, against its current customers
+    checkResult checkDynamic(const dynamicSolver& solver, int capacity){
+        problemParameters problem;
+        problem.capacity = capacity;
+        problem.nodes = solver.currentSolution().problemNodes();
+        problem.dimension = static_cast<int>(problem.nodes.size());
+        stringstream printed;
+        solver.currentSolution().printSolution(printed);
+        return checkSolution(problem, printed);
+    }
+
+    // Replays options.dynamicEvents seeded random events on a dynamic solver started from a generated instance:
+    // customers are added anywhere on the grid, removed or given a new demand, and the solution is checked after
+    // each event. A tabu search of options.iterations iterations is run from the final solution.
+    dynamicResult runDynamic(instanceType type, size_t customers, const benchOptions& options){
+        dynamicResult result;
+        result.customers = customers;
+        uint32_t instanceSeed = options.seed * 1000003u + static_cast<uint32_t>(type) * 65536u
+                              + static_cast<uint32_t>(customers);
+        problemParameters problem = generateProblem(type, customers, instanceSeed);
+        result.name = problem.name;
+        uint16_t maxDemand = static_cast<uint16_t>(min(100, problem.capacity));
+        default_random_engine rng(instanceSeed);
+        uniform_real_distribution<float> coordinate(0, static_cast<float>(generatedGridSize));
+        uniform_int_distribution<int> demand(1, maxDemand);
+        uniform_int_distribution<int> eventType(0, 9);
+
+        auto recordCheck = [&](const dynamicSolver& solver){
+            checkResult check = checkDynamic(solver, problem.capacity);
+            if (check.feasible) return;
+            if (result.infeasibleEvents++ == 0) result.error = check.error;
+            result.feasible = false;
+        };
+        try{
+            dynamicSolver solver(problem, options.seed);
+            result.initialCost = solver.cost();
+            recordCheck(solver);
+            // Ids of the present customers, so that events pick one uniformly
+            vector<uint32_t> present;
+            for (uint32_t id = 1; id < problem.nodes.size(); id++) present.push_back(id);
+            vector<double> samples;
+            for (size_t e = 0; e < options.dynamicEvents; e++){
+                // Four in ten events add a customer, three remove one and three change a demand
+                int kind = eventType(rng);
+                if (present.size() < 2) kind = 0;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                if (kind < 4){
+                    float x = coordinate(rng), y = coordinate(rng);
+                    present.push_back(solver.addCustomer(x, y, static_cast<uint16_t>(demand(rng))));
+                }
+                else{
+                    size_t pick = uniform_int_distribution<size_t>(0, present.size() - 1)(rng);
+                    if (kind < 7){
+                        solver.removeCustomer(present[pick]);
+                        present[pick] = present.back();
+                        present.pop_back();
+                    }
+                    else{
+                        solver.updateDemand(present[pick], static_cast<uint16_t>(demand(rng)));
+                    }
+                }
+                samples.push_back(secondsSince(start));
+                recordCheck(solver);
+            }
+            result.eventTime.median = percentile(samples, 0.5);
+            result.eventTime.p95 = percentile(samples, 0.95);
+            result.finalCost = solver.cost();
+
+            tabu::searchControl control;
+            control.iterationLimit = options.iterations;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            solver.improve(control);
+            result.improveSeconds = secondsSince(start);
+            result.improvedCost = solver.cost();
+            recordCheck(solver);
+        }
+        catch (const exception& e){
+            result.feasible = false;
+            result.error = e.what();
+        }
+        return result;
+    }
+
+    // Runs the dynamic replay for every instance and prints a table of the results, returning 1 if any solution
+    // failed its check
+    int runDynamicSuite(const benchOptions& options){
+        cout << left << setw(18) << "instance" << right << setw(10) << "events" << setw(13) << "median ms"
+             << setw(13) << "p95 ms" << setw(16) << "initial" << setw(16) << "final" << setw(13) << "improve ms"
+             << setw(16) << "improved" << endl;
+        bool allFeasible = true;
+        for (size_t customers : options.sizes){
+            for (instanceType type : options.types){
+                dynamicResult r = runDynamic(type, customers, options);
+                allFeasible = allFeasible && r.feasible;
+                cout << left << setw(18) << r.name << right << fixed << setprecision(2) << setw(10)
+                     << options.dynamicEvents << setw(13) << r.eventTime.median * 1000 << setw(13)
+                     << r.eventTime.p95 * 1000 << setw(16) << r.initialCost << setw(16) << r.finalCost << setw(13)
+                     << r.improveSeconds * 1000 << setw(16) << r.improvedCost;
+                if (!r.feasible){
+                    cout << "   INFEASIBLE after " << r.infeasibleEvents << " events: " << r.error;
+                }
+                cout << defaultfloat << endl;
+            }
+        }
+        return allFeasible ? 0 : 1;
+    }
+
+    string jsonString(const string& value){
+        string quoted = "\"";
+        for (char c : value){
+            if (c == '"' || c == '\\') quoted += '\\';
+            if (static_cast<unsigned char>(c) < 0x20) continue;
+            quoted += c;
+        }
+        return quoted + '"';
+    }
+
+    // Returns the excess cost of the sparse savings list's Clarke-Wright solution over the complete list's, or 0
+    // if the complete list was not built
+    double sparseGapPercent(const instanceResult& r){
+        if (r.clarkeWrightCost <= 0) return 0;
+        return 100 * (r.sparseClarkeWrightCost - r.clarkeWrightCost) / r.clarkeWrightCost;
+    }
+
+    // Writes the results as JSON, with each instance on a line of its own so that readBaseline can read them
+    // back without a JSON parser
+    void writeJson(ostream& out, const benchOptions& options, const vector<instanceResult>& results){
+        out << setprecision(10);
+        out << "{\n\"repeat\": " << options.repeat << ",\n\"iterations\": " << options.iterations
+            << ",\n\"seed\": " << options.seed
+            << ",\n\"sparseNeighbours\": " << options.sparseNeighbours << ",\n\"instances\": [\n";
+        for (size_t i = 0; i < results.size(); i++){
+            const instanceResult& r = results[i];
+            out << "{\"name\": " << jsonString(r.name) << ", \"type\": " << jsonString(instanceTypeName(r.type))
+                << ", \"customers\": " << r.customers << ", \"capacity\": " << r.capacity
+                << ", \"feasible\": " << (r.feasible ? "true" : "false") << ", \"error\": " << jsonString(r.error)
+                << ", \"cost\": " << r.cost << ", \"clarkeWrightCost\": " << r.clarkeWrightCost
+                << ", \"sparseClarkeWrightCost\": " << r.sparseClarkeWrightCost
+                << ", \"sparseGapPercent\": " << sparseGapPercent(r)
+                << ", \"lowerBound\": " << r.lowerBound
+                << ", \"gapPercent\": " << (r.lowerBound > 0 ? 100 * (r.cost - r.lowerBound) / r.lowerBound : 0)
+                << ", \"geniCalls\": " << r.geniCalls << ", \"processPeakRssBytes\": " << r.processPeakBytes
+                << ", \"phases\": {";
+            for (size_t p = 0; p < phaseCount; p++){
+                out << (p ? ", " : "") << '"' << phaseNames[p] << "\": {\"median\": " << r.phases[p].median
+                    << ", \"p95\": " << r.phases[p].p95 << '}';
+            }
+            out << '}';
+            if (!r.counters.empty()){
+                out << ", \"counters\": {";
+                for (size_t c = 0; c < r.counters.size(); c++){
+                    out << (c ? ", " : "") << '"' << telemetry::counterName(static_cast<telemetry::counter>(c))
+                        << "\": " << r.counters[c];
+                }
+                out << '}';
+            }
+            out << '}' << (i + 1 < results.size() ? "," : "") << '\n';
+        }
+        out << "]\n}" << endl;
+    }
+
+    // Returns the number following "key": on the line, or a negative value if there is none
+    double jsonNumber(const string& line, const string& key){
+        size_t at = line.find('"' + key + "\": ");
+        if (at == string::npos) return -1;
+        return strtod(line.c_str() + at + key.size() + 4, nullptr);
+    }
+
+    // Reads the cost and median total time of each instance from JSON written by writeJson
+    map<string, baselineEntry> readBaseline(const string& filename){
+        ifstream in(filename);
+        if (!in) throw runtime_error("Baseline file could not be opened.");
+        map<string, baselineEntry> baseline;
+        string line;
+        while (getline(in, line)){
+            const string nameKey = "{\"name\": \"";
+            if (line.compare(0, nameKey.size(), nameKey) != 0) continue;
+            size_t end = line.find('"', nameKey.size());
+            if (end == string::npos) continue;
+            baselineEntry entry;
+            entry.cost = jsonNumber(line, "cost");
+            size_t total = line.find("\"total\": ");
+            entry.totalMedian = total == string::npos ? -1 : jsonNumber(line.substr(total), "median");
+            baseline[line.substr(nameKey.size(), end - nameKey.size())] = entry;
+        }
+        return baseline;
+    }
+
+    void printUsage(){
+        cout << "Usage: cvrpBench [--sizes N,N,...|--full] [--types uniform,clustered,depotcorner] [--repeat N]"
+             << " [--iterations N] [--seed S] [--sparse K] [--json FILE|-] [--baseline FILE] [--dynamic EVENTS]"
+             << endl;
+    }
+
+    // Returns the width of a phase's column in the results table
+    int phaseWidth(size_t p){
+        return max(13, static_cast<int>(strlen(phaseNames[p])) + 2);
+    }
+
+    vector<string> splitList(const string& list){
+        vector<string> items;
+        stringstream in(list);
+        string item;
+        while (getline(in, item, ',')) if (!item.empty()) items.push_back(item);
+        return items;
+    }
+
+}
+
+int main(int argc, char** argv){
+    benchOptions options;
+    try{
+        for (int a = 1; a < argc; a++){
+            string arg(argv[a]);
+            if (arg == "--full"){
+                options.sizes.assign(begin(fullSizes), end(fullSizes));
+                continue;
+            }
+            if (a + 1 == argc) throw invalid_argument("missing value for " + arg);
+            string value(argv[++a]);
+            if (arg == "--sizes"){
+                options.sizes.clear();
+                for (const string& size : splitList(value)) options.sizes.push_back(stoul(size));
+            }
+            else if (arg == "--types"){
+                for (const string& type : splitList(value)){
+                    if (type == "uniform") options.types.push_back(uniformInstance);
+                    else if (type == "clustered") options.types.push_back(clusteredInstance);
+                    else if (type == "depotcorner") options.types.push_back(depotCornerInstance);
+                    else throw invalid_argument("unknown instance type " + type);
+                }
+            }
+            else if (arg == "--repeat"){
+                options.repeat = max<size_t>(1, stoul(value));
+            }
+            else if (arg == "--iterations"){
+                options.iterations = stoul(value);
+            }
+            else if (arg == "--seed"){
+                options.seed = static_cast<unsigned>(stoul(value));
+            }
+            else if (arg == "--sparse"){
+                options.sparseNeighbours = max<size_t>(1, stoul(value));
+            }
+            else if (arg == "--dynamic"){
+                options.dynamicEvents = stoul(value);
+            }
+            else if (arg == "--json"){
+                options.jsonFilename = value;
+            }
+            else if (arg == "--baseline"){
+                options.baselineFilename = value;
+            }
+            else{
+                throw invalid_argument("unknown option " + arg);
+            }
+        }
+    }
+    catch (const logic_error& e){
+        cout << "Invalid arguments: " << e.what() << endl;
+        printUsage();
+        return 1;
+    }
+    if (options.sizes.empty()) options.sizes.assign(begin(defaultSizes), end(defaultSizes));
+    if (options.types.empty()) options.types = { uniformInstance, clusteredInstance, depotCornerInstance };
+    if (options.dynamicEvents > 0){
+        sort(options.sizes.begin(), options.sizes.end());
+        return runDynamicSuite(options);
+    }
+    map<string, baselineEntry> baseline;
+    try{
+        if (!options.baselineFilename.empty()) baseline = readBaseline(options.baselineFilename);
+    }
+    catch (const runtime_error& e){
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    // Smaller instances run first, so that the process peak memory reported for each is mostly its own
+    sort(options.sizes.begin(), options.sizes.end());
+    ostream& table = options.jsonFilename == "-" ? cerr : cout;
+    table << left << setw(18) << "instance";
+    for (size_t p = 0; p < phaseCount; p++){
+        table << right << setw(phaseWidth(p)) << phaseNames[p] << setw(10) << "p95";
+    }
+    table << setw(16) << "cost" << setw(9) << "gap%" << setw(10) << "sparse%" << setw(17) << "process peak MB";
+    if (!baseline.empty()) table << setw(10) << "cost%" << setw(10) << "time%";
+    table << "   (median and p95 ms)" << endl;
+
+    vector<instanceResult> results;
+    bool allFeasible = true;
+    for (size_t customers : options.sizes){
+        for (instanceType type : options.types){
+            instanceResult r = runInstance(type, customers, options);
+            results.push_back(r);
+            allFeasible = allFeasible && r.feasible;
+            table << left << setw(18) << r.name << right << fixed << setprecision(2);
+            for (size_t p = 0; p < phaseCount; p++){
+                table << setw(phaseWidth(p)) << r.phases[p].median * 1000 << setw(10) << r.phases[p].p95 * 1000;
+            }
+            table << setw(16) << r.cost << setw(9)
+                  << (r.lowerBound > 0 ? 100 * (r.cost - r.lowerBound) / r.lowerBound : 0.0)
+                  << setw(10) << sparseGapPercent(r)
+                  << setw(17) << r.processPeakBytes / 1048576.0;
+            auto previous = baseline.find(r.name);
+            if (previous != baseline.end() && previous->second.cost > 0 && previous->second.totalMedian > 0){
+                table << showpos << setw(10) << 100 * (r.cost - previous->second.cost) / previous->second.cost
+                      << setw(10) << 100 * (r.phases[totalPhase].median - previous->second.totalMedian)
+                                     / previous->second.totalMedian << noshowpos;
+            }
+            if (!r.feasible) table << "   INFEASIBLE: " << r.error;
+            table << defaultfloat << endl;
+        }
+    }
+
+    if (options.jsonFilename == "-"){
+        writeJson(cout, options, results);
+    }
+    else if (!options.jsonFilename.empty()){
+        ofstream out(options.jsonFilename);
+        if (!out){
+            cout << "JSON file could not be written." << endl;
+            return 1;
+        }
+        writeJson(out, options, results);
+    }
+    return allFeasible ? 0 : 1;
+}
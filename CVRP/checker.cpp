@@ -0,0 +1,121 @@
+#include "checker.h"
+#include <sstream>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    double edgeCost(const problemParameters& problem, int a, int b){
+        if (!problem.edgeWeights.empty()) return problem.edgeWeights[static_cast<size_t>(a)*problem.nodes.size() + b];
+        const node& u = problem.nodes[a];
+        const node& v = problem.nodes[b];
+        double dx = static_cast<double>(u.x) - v.x;
+        double dy = static_cast<double>(u.y) - v.y;
+        return sqrt(dx*dx + dy*dy);
+    }
+
+    // Parses a route of the form "1->a->...->1", returning false if it is malformed
+    bool parseRoute(const string& line, vector<int>& route){
+        route.clear();
+        const char* p = line.c_str();
+        while (true){
+            char* end;
+            long num = strtol(p, &end, 10);
+            if (end == p || num <= 0 || num > 65535) return false;
+            route.push_back(static_cast<int>(num));
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+            if (*p == '\0') return true;
+            if (p[0] != '-' || p[1] != '>') return false;
+            p += 2;
+        }
+    }
+
+}
+
+checkResult cvrp::checkRoutes(const problemParameters& problem, const vector<vector<int>>& routes){
+    checkResult result;
+    result.vehicles = routes.size();
+    size_t n = problem.nodes.size();
+    vector<bool> visited(n, false);
+    size_t visitedCount = 0;
+    for (size_t r = 0; r < routes.size(); r++){
+        const vector<int>& route = routes[r];
+        string routeName = "route " + to_string(r + 1);
+        if (route.size() < 3 || route.front() != 1 || route.back() != 1){
+            if (result.error.empty()) result.error = routeName + " does not start and end at the depot with a customer between";
+            continue;
+        }
+        long long load = 0;
+        for (size_t p = 0; p + 1 < route.size(); p++){
+            int a = route[p] - 1, b = route[p + 1] - 1;
+            if (a < 0 || b < 0 || static_cast<size_t>(a) >= n || static_cast<size_t>(b) >= n){
+                if (result.error.empty()) result.error = routeName + " visits a node that does not exist";
+                break;
+            }
+            result.cost += edgeCost(problem, a, b);
+            if (p == 0) continue;
+            if (a == 0){
+                if (result.error.empty()) result.error = routeName + " passes through the depot";
+                continue;
+            }
+            if (visited[a]){
+                if (result.error.empty()) result.error = "node " + to_string(a + 1) + " is visited more than once";
+                continue;
+            }
+            visited[a] = true;
+            visitedCount++;
+            load += problem.nodes[a].demand;
+        }
+        if (load > problem.capacity && result.error.empty()){
+            result.error = routeName + " carries " + to_string(load) + ", over the capacity of " + to_string(problem.capacity);
+        }
+    }
+    if (visitedCount + 1 != n && result.error.empty()){
+        result.error = to_string(n - 1 - visitedCount) + " customers are not visited";
+    }
+    result.feasible = result.error.empty();
+    return result;
+}
+
+checkResult cvrp::checkSolution(const problemParameters& problem, istream& in, double relativeTolerance){
+    string line;
+    bool hasCost = false;
+    double reportedCost = 0;
+    vector<vector<int>> routes;
+    vector<int> route;
+    while (getline(in, line)){
+        if (!hasCost){
+            if (line.compare(0, 5, "cost ") == 0){
+                istringstream costText(line.substr(5));
+                hasCost = static_cast<bool>(costText >> reportedCost);
+            }
+            continue;
+        }
+        if (line.find_first_not_of(" \t\r") == string::npos) break;
+        if (!parseRoute(line, route)){
+            checkResult result;
+            result.error = "malformed route \"" + line + "\"";
+            return result;
+        }
+        routes.push_back(route);
+    }
+    if (!hasCost){
+        checkResult result;
+        result.error = "no cost line found";
+        return result;
+    }
+    checkResult result = checkRoutes(problem, routes);
+    result.reportedCost = reportedCost;
+    if (fabs(reportedCost - result.cost) > relativeTolerance * max(1.0, result.cost) && result.error.empty()){
+        ostringstream message;
+        message.precision(10);
+        message << "reported cost " << reportedCost << " differs from the actual cost " << result.cost;
+        result.error = message.str();
+        result.feasible = false;
+    }
+    return result;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    struct checkResult{
+        checkResult()
+            : feasible(false), cost(0), reportedCost(0), vehicles(0) {}
+        // True if every customer is visited exactly once, no route is overloaded and any reported cost matches
+        bool feasible;
+        // Cost of the routes, computed from the problem alone
+        double cost;
+        // Cost stated by the solution, if it was read from text
+        double reportedCost;
+        size_t vehicles;
+        // Description of the first fault found, if any
+        string error;
+    };
+
+    // Checks routes given as node numbers, each starting and ending at the depot (node 1). Distances are
+    // recomputed from the problem's coordinates or edge weights, independently of the solver's distance caches.
+    checkResult checkRoutes(const problemParameters& problem, const vector<vector<int>>& routes);
+
+    // Reads a solution in the format written by printSolution ("cost C" followed by one "1->a->...->1" line per
+    // route, any earlier lines being ignored) and checks it as above. The reported cost must match the routes to
+    // within 'relativeTolerance' of the cost.
+    checkResult checkSolution(const problemParameters& problem, istream& in, double relativeTolerance = 1e-9);
+
+}
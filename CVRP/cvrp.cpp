@@ -1,12 +1,15 @@
 #include "cvrp.h"
 #include <iomanip>
+#include <cmath>
 #include "savings.h"
+#include "distances.h"
+#include "parser.h"
 
 using namespace std;
 using namespace cvrp;
 
 // Returns the total used capacity of this vehicle
-uint16_t vehicle::usedCapacity(){
+uint16_t vehicle::usedCapacity() const{
     uint16_t totalCapacity = 0;
     for (auto n : route) totalCapacity += n.demand;
     return totalCapacity;
@@ -24,6 +27,9 @@ bool vehicle::containsNode(uint16_t nodeNum) const{
 double vehicle::getRouteCost(){
     return cost(route);
 }
+double vehicle::getRouteCost(const distanceCache& distances) const{
+    return cost(route, distances);
+}
 // Returns a string of the route in the form "a->b->c->...->a"
 string vehicle::getRouteString(){
     string output;
@@ -38,17 +44,33 @@ string vehicle::getRouteString(){
 
 double solution::getCost(){
     double totalCost = 0;
-    for (auto v : vehicles){
+    for (auto& v : vehicles){
         totalCost += v.getRouteCost();
     }
     return totalCost;
 }
+double solution::getCost(const distanceCache& distances) const{
+    double totalCost = 0;
+    for (const auto& v : vehicles){
+        totalCost += v.getRouteCost(distances);
+    }
+    return totalCost;
+}
 double solution::getInfeasibleCost(uint16_t vehicleCapacity, double scaling){
     double totalCost = 0;
-    for (auto v : vehicles){
+    for (auto& v : vehicles){
         totalCost += v.getRouteCost();
         int16_t overCapacity = v.usedCapacity() - vehicleCapacity;
-        if (overCapacity > 0) totalCost += overCapacity;
+        if (overCapacity > 0) totalCost += scaling * overCapacity;
+    }
+    return totalCost;
+}
+double solution::getInfeasibleCost(uint16_t vehicleCapacity, double scaling, const distanceCache& distances) const{
+    double totalCost = 0;
+    for (const auto& v : vehicles){
+        totalCost += v.getRouteCost(distances);
+        int16_t overCapacity = v.usedCapacity() - vehicleCapacity;
+        if (overCapacity > 0) totalCost += scaling * overCapacity;
     }
     return totalCost;
 }
@@ -67,67 +89,43 @@ void solution::printSolution(ostream& out){
     }
     out << endl;
 }
+void solution::printSolution(ostream& out, const distanceCache& distances){
+    out << "cost " << setprecision(10) << getCost(distances);
+    for (auto v : vehicles){
+        out << '\n' << v.getRouteString();
+    }
+    out << endl;
+}
 // Checks that each node is included in exactly 1 vehicle route, and no vehicle is over-capacity
-bool solution::isFeasible(size_t nodeCount, int16_t vehicleCapacity){
+bool solution::isFeasible(size_t nodeCount, uint16_t vehicleCapacity){
     vector<bool> nodeFound(nodeCount,false);
     // Depot should not be in any vehicle route except as the first node
     nodeFound[0] = true;
-    for (auto v : vehicles){
-        // Check that vehicles are not over-capacity
-        if (v.usedCapacity() > vehicleCapacity) return false;
+    for (const auto& v : vehicles){
         // Check that the first node on the vehicle's route is the depot
-        if (v.route[0].num != 1) return false;
+        if (v.route.empty() || v.route[0].num != 1) return false;
+        // Check that vehicles are not over-capacity, without the overflow of usedCapacity
+        size_t load = 0;
         // Check that no node in the vehicle's route is duplicated anywhere
         for (size_t i = 1; i < v.route.size(); i++){
             size_t nodeIndex = v.route[i].num - 1;
-            if (nodeFound[nodeIndex]) return false;
+            if (nodeIndex >= nodeCount || nodeFound[nodeIndex]) return false;
             nodeFound[nodeIndex] = true;
+            load += v.route[i].demand;
         }
+        if (load > vehicleCapacity) return false;
     }
-    return true;
+    // Check that every node has been visited
+    return find(nodeFound.begin(), nodeFound.end(), false) == nodeFound.end();
 }
 
 problemParameters cvrp::getParameters(string filename){
-    problemParameters problem;
-    ifstream fileIn(filename);
-    if (fileIn){
-        string in;
-        while (fileIn){
-            fileIn >> in;
-            if (in == "DIMENSION"){
-                fileIn >> in;
-                fileIn >> problem.dimension;
-            }
-            else if (in == "CAPACITY"){
-                fileIn >> in;
-                fileIn >> problem.capacity;
-            }
-            else if (in == "NODE_COORD_SECTION"){
-                for (int i = 0; i < problem.dimension; i++){
-                    node n;
-                    fileIn >> n.num;
-                    fileIn >> n.x;
-                    fileIn >> n.y;
-                    problem.nodes.push_back(n);
-                }
-            }
-            else if (in == "DEMAND_SECTION"){
-                for (int i = 0; i < problem.dimension; i++){
-                    fileIn >> in;
-                    fileIn >> problem.nodes[i].demand;
-                }
-            }
-        }
-    }
-    else{
-        throw runtime_error("Filename is invalid.");
-    }
-    return problem;
+    return loadProblem(filename);
 }
 
-uint32_t cvrp::sqrDistance(node a, node b){
-    int16_t distX = a.x - b.x;
-    int16_t distY = a.y - b.y;
+double cvrp::sqrDistance(node a, node b){
+    double distX = static_cast<double>(a.x) - b.x;
+    double distY = static_cast<double>(a.y) - b.y;
     return (distX*distX) + (distY*distY);
 }
 
@@ -136,15 +134,7 @@ double cvrp::distance(node a, node b){
 }
 
 
-uint64_t cvrp::sqrCost(vector<node> nodes){
-    uint64_t totalCost = 0;
-    for (size_t i = 0; i < nodes.size() - 1; i++){
-        totalCost += sqrDistance(nodes[i], nodes[i+1]);
-    }
-    totalCost += sqrDistance(nodes[0], nodes.back());
-    return totalCost;
-}
-double cvrp::cost(vector<node> nodes){
+double cvrp::cost(const vector<node>& nodes){
     double totalCost = 0;
     for (size_t i = 0; i < nodes.size() - 1; i++){
         totalCost += distance(nodes[i], nodes[i+1]);
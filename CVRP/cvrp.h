@@ -12,31 +12,75 @@ using namespace std;
 
 namespace cvrp{
 
+    // Cost policies, which set the type that distances are stored in; sums of distances and move gains are
+    // always added up in double precision. exactCost keeps the exact distances in double precision. floatCost
+    // halves the memory of a stored matrix and the width of each distance. scaledIntegerCost stores each
+    // distance multiplied by Scale and rounded to the nearest integer, as TSPLIB's EUC_2D does with a scale of
+    // 1, so that every cost and every difference of costs is an integer, exactly represented in a double, and
+    // compared alike on every thread and platform.
+    // A policy maps an exact distance to its stored value and maps sums of stored values back to distances.
+    struct exactCost{
+        typedef double value_type;
+        static const bool exact = true;
+        static double fromDistance(double distance) { return distance; }
+        static double toDistance(double cost) { return cost; }
+    };
+    struct floatCost{
+        typedef float value_type;
+        static const bool exact = false;
+        static float fromDistance(double distance) { return static_cast<float>(distance); }
+        static double toDistance(double cost) { return cost; }
+    };
+    template<int Scale>
+    struct scaledIntegerCost{
+        typedef int32_t value_type;
+        static const bool exact = false;
+        static int32_t fromDistance(double distance) { return static_cast<int32_t>(distance * Scale + 0.5); }
+        static double toDistance(double cost) { return cost / Scale; }
+    };
+
+    // The cost policy of the whole solver, chosen at compile time with make COST=float or make COST=int32
+    // (and COST_SCALE=N for a scale other than 1)
+#if defined(CVRP_COST_FLOAT)
+    typedef floatCost costPolicy;
+#elif defined(CVRP_COST_INT32)
+#ifndef CVRP_COST_SCALE
+#define CVRP_COST_SCALE 1
+#endif
+    typedef scaledIntegerCost<CVRP_COST_SCALE> costPolicy;
+#else
+    typedef exactCost costPolicy;
+#endif
+
+    template<typename Policy> class basicDistanceCache;
+    typedef basicDistanceCache<costPolicy> distanceCache;
+
+    // Coordinates are held in single precision, which is exact for integer coordinates up to 2^24
     struct node{
         uint16_t num;
-        int16_t x;
-        int16_t y;
         uint16_t demand;
+        float x;
+        float y;
     };
 
-    uint32_t sqrDistance(node a, node b);
+    double sqrDistance(node a, node b);
     double distance(node a, node b);
 
-    uint64_t sqrCost(vector<node> nodes);
-    double cost(vector<node> nodes);
+    double cost(const vector<node>& nodes);
 
     class vehicle{
     public:
         vehicle(node depot)
             : route(1, depot), routeCost(0) {}
         // Returns the total used capacity of this vehicle
-        uint16_t usedCapacity();
+        uint16_t usedCapacity() const;
         // Returns a copy of this vehicle's route
         vector<node> getRoute();
         // Returns true if this vehicle's route contains the given node
         bool containsNode(uint16_t nodeNum) const;
         // Returns the total cost of the vehicle's route
         double getRouteCost();
+        double getRouteCost(const distanceCache& distances) const;
         // Returns a string of the route in the form "a->b->c->...->a"
         string getRouteString();
         vector<node> route;
@@ -47,17 +91,35 @@ namespace cvrp{
     class solution{
     public:
         double getCost();
+        double getCost(const distanceCache& distances) const;
+        // Returns the total cost plus 'scaling' times the total demand carried over vehicle capacity
         double getInfeasibleCost(uint16_t vehicleCapacity, double scaling);
+        double getInfeasibleCost(uint16_t vehicleCapacity, double scaling, const distanceCache& distances) const;
         vector<vehicle>::iterator containingVehicle(uint16_t nodeNum);
         vector<vehicle> vehicles;
         void printSolution(ostream& out);
-        bool isFeasible(size_t nodeCount, int16_t vehicleCapacity);
+        void printSolution(ostream& out, const distanceCache& distances);
+        bool isFeasible(size_t nodeCount, uint16_t vehicleCapacity);
     };
 
     struct problemParameters{
+        problemParameters()
+            : dimension(0), capacity(0), vehicles(0), maxRouteLength(0), serviceTime(0), parseSeconds(0) {}
+        string name;
         int dimension;
         int capacity;
+        // Number of vehicles given by the VEHICLES header, or 0 if unspecified
+        int vehicles;
+        // Route length limit and service time given by the DISTANCE and SERVICE_TIME headers, or 0 if unspecified;
+        // these are recorded but not enforced by the solvers
+        double maxRouteLength;
+        double serviceTime;
         vector<node> nodes;
+        // Row-major dimension*dimension matrix of the distances between nodes, for problems whose edge weights
+        // are not the euclidean distances between node coordinates; empty otherwise
+        vector<double> edgeWeights;
+        // Time taken to read and parse the problem file
+        double parseSeconds;
     };
 
     problemParameters getParameters(string filename);
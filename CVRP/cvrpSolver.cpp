@@ -1,30 +1,491 @@
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 #include <vector>
 #include <string>
 #include <random>
 #include <chrono>
 #include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <limits>
+#include <thread>
 #include "cvrp.h"
 #include "tabu.h"
+#include "hgs.h"
+#include "decomposition.h"
+#include "parser.h"
+#include "distances.h"
+#include "batch.h"
+#include "checker.h"
+#include "telemetry.h"
+#include "snapshot.h"
+#include "server.h"
+#include <atomic>
+#include <csignal>
 
 using namespace std;
 
+void printUsage(){
+    cout << "Usage: cvrpSolver [--algorithm tabu|hgs|decompose] [--threads N] [--starts N] [--elite N] [--seed S] [--target-cost C]"
+         << " [--time-limit SECONDS] [--subproblem-size N] [--rounds N] [--memory-budget MB]"
+         << " [--iteration-limit N] [--stream FILE|-] [--no-local-search] [--sparse-savings K]"
+         << " [--savings-sweep] [--no-route-optimization] [--trace FILE]"
+         << " [--checkpoint FILE] [--checkpoint-interval SECONDS] [--verbose] file" << endl;
+    cout << "       cvrpSolver --resume CHECKPOINT [--checkpoint FILE] [--checkpoint-interval SECONDS] [--time-limit SECONDS]"
+         << " [--stream FILE|-] [--verbose]" << endl;
+    cout << "       cvrpSolver --snapshot OUTPUT [--snapshot-matrix] file" << endl;
+    cout << "       cvrpSolver --batch DIRECTORY [--jobs N] [--output DIRECTORY] [--seed S] [--time-limit SECONDS]"
+         << " [--iteration-limit N] [--no-local-search] [--sparse-savings K]"
+         << " [--savings-sweep] [--no-route-optimization]" << endl;
+    cout << "       cvrpSolver --check SOLUTION file" << endl;
+    cout << "       cvrpSolver --serve SOCKET [--cache N] [--max-threads N] [--request-timeout SECONDS] [--verbose]" << endl;
+}
+
+// Largest thread, job or parallel search count accepted on the command line
+const size_t maxParallelCount = 1024;
+
+// Largest number of problems whose distances the solve server may keep
+const size_t maxCachedProblems = 1024;
+
+// Parses the count given to an option, rejecting negative counts, which stoul would wrap around, and counts
+// above 'limit'
+size_t countArgument(const string& option, const string& value, size_t limit){
+    size_t end = 0;
+    unsigned long count = stoul(value, &end);
+    if (value[0] == '-' || end != value.size()) throw invalid_argument(option + " needs a count");
+    if (count > limit) throw invalid_argument(option + " is limited to " + to_string(limit));
+    return count;
+}
+
+// Set by SIGINT or SIGTERM to stop the solve server, which then removes its socket
+static atomic<bool> serverStop(false);
+
+extern "C" void stopServer(int){
+    serverStop.store(true);
+}
+
+// Checks a solution file written by the solver against its problem, printing the recomputed cost or the first
+// fault found
+int checkSolutionFile(const string& problemFilename, const string& solutionFilename){
+    cvrp::problemParameters problem;
+    try{
+        problem = cvrp::loadProblem(problemFilename);
+    }
+    catch (const runtime_error& e){
+        cout << "Invalid problem: " << e.what() << endl;
+        return 1;
+    }
+    ifstream in(solutionFilename);
+    if (!in){
+        cout << "Solution file could not be opened." << endl;
+        return 1;
+    }
+    cvrp::checkResult result = cvrp::checkSolution(problem, in);
+    if (!result.feasible){
+        cout << "infeasible: " << result.error << endl;
+        return 1;
+    }
+    cout << "feasible cost " << setprecision(10) << result.cost << " vehicles " << result.vehicles << endl;
+    return 0;
+}
+
+// Writes each new best solution, with its cost, the time since the solver started and the iteration it was
+// found at, followed by its routes and a blank line. Every entry is flushed so that a reader can stop the
+// solver at any moment and still have the best solution so far.
+void streamSolution(ostream& out, const cvrp::compactSolution& best, double cost, double elapsed, size_t iteration){
+    out << "best " << setprecision(10) << cost << " elapsed " << setprecision(6) << elapsed
+        << " iteration " << iteration;
+    for (size_t r = 0; r < best.routeCount(); r++){
+        out << '\n' << best.getRouteString(r);
+    }
+    out << '\n' << endl;
+}
+
 int main(int argc, char** argv){
-    if (argc != 2){
-        cout << "Invalid argument count." << endl;
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    string filename;
+    string streamFilename;
+    string checkFilename;
+    string traceFilename;
+    string checkpointFilename;
+    string resumeFilename;
+    string snapshotFilename;
+    bool snapshotMatrix = false;
+    cvrp::batchOptions batch;
+    cvrp::tabu::multiStartOptions options;
+    cvrp::tabu::searchControl control;
+    bool multiStart = false;
+    bool threadsGiven = false;
+    bool startsGiven = false;
+    string algorithm = "tabu";
+    cvrp::decomposition::decompositionOptions decomposition;
+    bool decompositionOptionsGiven = false;
+    bool seeded = false;
+    bool verbose = false;
+    double batchTimeLimit = 0;
+    cvrp::serverOptions server;
+    bool serverOptionsGiven = false;
+    try{
+        for (int a = 1; a < argc; a++){
+            string arg(argv[a]);
+            if (arg.compare(0, 2, "--") != 0){
+                if (!filename.empty()) throw invalid_argument("more than one problem file given");
+                filename = arg;
+                continue;
+            }
+            if (arg == "--verbose"){
+                verbose = true;
+                continue;
+            }
+            if (arg == "--no-local-search"){
+                control.localSearch = false;
+                continue;
+            }
+            if (arg == "--no-route-optimization"){
+                control.routeOptimization = false;
+                continue;
+            }
+            if (arg == "--snapshot-matrix"){
+                snapshotMatrix = true;
+                continue;
+            }
+            if (arg == "--savings-sweep"){
+                control.savingsSweep = true;
+                continue;
+            }
+            if (a + 1 == argc) throw invalid_argument("missing value for " + arg);
+            string value(argv[++a]);
+            if (arg == "--algorithm"){
+                if (value != "tabu" && value != "hgs" && value != "decompose") throw invalid_argument("unknown algorithm " + value);
+                algorithm = value;
+            }
+            else if (arg == "--subproblem-size"){
+                decomposition.subproblemSize = countArgument(arg, value, UINT16_MAX);
+                if (decomposition.subproblemSize == 0) throw invalid_argument("--subproblem-size needs at least 1 customer");
+                decompositionOptionsGiven = true;
+            }
+            else if (arg == "--rounds"){
+                decomposition.rounds = countArgument(arg, value, numeric_limits<size_t>::max());
+                decompositionOptionsGiven = true;
+            }
+            else if (arg == "--memory-budget"){
+                // Checked before the conversion, which is undefined for negative or out-of-range budgets
+                double megabytes = stod(value);
+                if (!(megabytes >= 0) || megabytes * 1024 * 1024 >= static_cast<double>(numeric_limits<size_t>::max())){
+                    throw invalid_argument("--memory-budget needs a number of megabytes from 0 to the size of the address space");
+                }
+                decomposition.memoryBudget = static_cast<size_t>(megabytes * 1024 * 1024);
+                decompositionOptionsGiven = true;
+            }
+            else if (arg == "--threads"){
+                options.threads = countArgument(arg, value, maxParallelCount);
+                threadsGiven = true;
+                multiStart = true;
+            }
+            else if (arg == "--starts"){
+                options.starts = countArgument(arg, value, maxParallelCount);
+                startsGiven = true;
+                multiStart = true;
+            }
+            else if (arg == "--seed"){
+                options.seed = static_cast<unsigned>(stoul(value));
+                seeded = true;
+            }
+            else if (arg == "--elite"){
+                options.eliteSize = countArgument(arg, value, maxParallelCount);
+                multiStart = true;
+            }
+            else if (arg == "--target-cost"){
+                options.targetCost = stod(value);
+                multiStart = true;
+            }
+            else if (arg == "--time-limit"){
+                // The budget covers the whole run, including reading the problem, or each instance of a batch
+                batchTimeLimit = stod(value);
+                control.hasDeadline = true;
+                control.deadline = startTime + chrono::duration_cast<chrono::steady_clock::duration>(
+                    chrono::duration<double>(batchTimeLimit));
+            }
+            else if (arg == "--iteration-limit"){
+                control.iterationLimit = countArgument(arg, value, numeric_limits<size_t>::max());
+            }
+            else if (arg == "--sparse-savings"){
+                control.savingsNeighbours = countArgument(arg, value, UINT16_MAX);
+                if (control.savingsNeighbours == 0) throw invalid_argument("--sparse-savings needs at least 1 neighbour");
+            }
+            else if (arg == "--stream"){
+                streamFilename = value;
+            }
+            else if (arg == "--trace"){
+                traceFilename = value;
+            }
+            else if (arg == "--checkpoint"){
+                checkpointFilename = value;
+            }
+            else if (arg == "--checkpoint-interval"){
+                control.checkpointSeconds = stod(value);
+            }
+            else if (arg == "--resume"){
+                resumeFilename = value;
+            }
+            else if (arg == "--snapshot"){
+                snapshotFilename = value;
+            }
+            else if (arg == "--check"){
+                checkFilename = value;
+            }
+            else if (arg == "--batch"){
+                batch.inputDirectory = value;
+            }
+            else if (arg == "--jobs"){
+                batch.jobs = countArgument(arg, value, maxParallelCount);
+            }
+            else if (arg == "--serve"){
+                server.socketPath = value;
+            }
+            else if (arg == "--cache"){
+                server.cachedProblems = countArgument(arg, value, maxCachedProblems);
+                serverOptionsGiven = true;
+            }
+            else if (arg == "--max-threads"){
+                server.maxThreads = countArgument(arg, value, maxParallelCount);
+                if (server.maxThreads == 0) throw invalid_argument("--max-threads needs at least 1 thread");
+                serverOptionsGiven = true;
+            }
+            else if (arg == "--request-timeout"){
+                server.requestTimeout = stod(value);
+                if (!(server.requestTimeout > 0)) throw invalid_argument("--request-timeout needs a positive number of seconds");
+                serverOptionsGiven = true;
+            }
+            else if (arg == "--output"){
+                batch.outputDirectory = value;
+            }
+            else{
+                throw invalid_argument("unknown option " + arg);
+            }
+        }
+        if (algorithm != "tabu"){
+            if (!batch.inputDirectory.empty() || !resumeFilename.empty() || !checkpointFilename.empty()){
+                throw invalid_argument("--batch and checkpoints run Taburoute searches");
+            }
+            if (options.starts != 1 || options.targetCost != 0 || options.eliteSize != 0){
+                throw invalid_argument("--starts, --target-cost and --elite apply to Taburoute");
+            }
+        }
+        else if (threadsGiven && !startsGiven){
+            // --threads alone runs one Taburoute search on each thread
+            options.starts = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+        }
+        if (decompositionOptionsGiven && algorithm != "decompose"){
+            throw invalid_argument("--subproblem-size, --rounds and --memory-budget apply to --algorithm decompose");
+        }
+        if (!checkFilename.empty()){
+            if (filename.empty()) throw invalid_argument("--check needs the problem file");
+        }
+        else if (!batch.inputDirectory.empty()){
+            if (!filename.empty()) throw invalid_argument("a problem file cannot be given with --batch");
+            if (multiStart || !streamFilename.empty()) throw invalid_argument("--batch solves each instance with a single search");
+        }
+        else if (!resumeFilename.empty()){
+            if (!filename.empty()) throw invalid_argument("the problem is read from the checkpoint with --resume");
+            if (multiStart) throw invalid_argument("checkpoints hold a single search");
+        }
+        else if (!server.socketPath.empty()){
+            if (!filename.empty() || multiStart || algorithm != "tabu"){
+                throw invalid_argument("the solve server takes each problem and its settings from the request");
+            }
+        }
+        else if (filename.empty()){
+            throw invalid_argument("no problem file given");
+        }
+        if (!checkpointFilename.empty() && multiStart) throw invalid_argument("checkpoints hold a single search");
+        if (serverOptionsGiven && server.socketPath.empty()){
+            throw invalid_argument("--cache, --max-threads and --request-timeout apply to --serve");
+        }
+    }
+    catch (const logic_error& e){
+        cout << "Invalid arguments: " << e.what() << endl;
+        printUsage();
         return 0;
     }
-    string filename(argv[1]);
-    cvrp::problemParameters problem = cvrp::getParameters(filename);
-    unsigned seed = static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
-    default_random_engine rng(seed);
-    // Find solution using Taburoute
-    cvrp::solution solution = cvrp::tabu::taburoute(problem.nodes, problem.capacity, rng);
+    if (!checkFilename.empty()){
+        return checkSolutionFile(filename, checkFilename);
+    }
+    if (!server.socketPath.empty()){
+        // Serve solve requests until a client asks the server to shut down or the process is interrupted
+        signal(SIGINT, stopServer);
+        signal(SIGTERM, stopServer);
+        try{
+            cvrp::serve(server, &serverStop, verbose ? &cerr : nullptr);
+        }
+        catch (const runtime_error& e){
+            cout << "Server failed: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (!batch.inputDirectory.empty()){
+        // Solve every instance in the directory
+        batch.seed = seeded ? options.seed : static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+        batch.iterationLimit = control.iterationLimit;
+        batch.localSearch = control.localSearch;
+        batch.savingsNeighbours = control.savingsNeighbours;
+        batch.savingsSweep = control.savingsSweep;
+        batch.routeOptimization = control.routeOptimization;
+        batch.timeLimit = batchTimeLimit;
+        vector<cvrp::batchResult> results;
+        try{
+            results = cvrp::solveBatch(batch);
+        }
+        catch (const runtime_error& e){
+            cout << "Batch failed: " << e.what() << endl;
+            return 1;
+        }
+        size_t feasible = count_if(results.begin(), results.end(), [](const cvrp::batchResult& r) { return r.feasible; });
+        cout << "solved " << results.size() << " instances, " << feasible << " feasible" << endl;
+        return feasible == results.size() ? 0 : 1;
+    }
+    ofstream streamFile;
+    ostream* stream = nullptr;
+    if (streamFilename == "-"){
+        stream = &cout;
+    }
+    else if (!streamFilename.empty()){
+        streamFile.open(streamFilename);
+        if (!streamFile){
+            cout << "Stream file could not be opened." << endl;
+            return 1;
+        }
+        stream = &streamFile;
+    }
+    if (stream){
+        control.improved = [&](const cvrp::compactSolution& best, double, size_t iteration){
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - startTime;
+            streamSolution(*stream, best, best.reportedCost(), elapsed.count(), iteration);
+        };
+    }
+    if (!traceFilename.empty()){
+        if (!cvrp::telemetry::compiledIn) cerr << "warning: --trace needs a build with INSTRUMENT=1" << endl;
+        cvrp::telemetry::setTracing(true);
+    }
+    // Problems are read from text or from a snapshot, which also holds their distances and perhaps a search
+    cvrp::snapshot loaded;
+    try{
+        string source = resumeFilename.empty() ? filename : resumeFilename;
+        chrono::steady_clock::time_point loadStart = chrono::steady_clock::now();
+        if (!resumeFilename.empty() || cvrp::isSnapshotFile(filename)){
+            loaded = cvrp::loadSnapshot(source);
+            if (!resumeFilename.empty() && !loaded.hasSearchState) throw runtime_error("the snapshot holds no search to resume");
+        }
+        else{
+            loaded.problem = cvrp::loadProblem(filename);
+        }
+        // The cache holds at least as many neighbours per node as the sparse savings list is asked for; one
+        // restored from a snapshot with fewer is built again
+        size_t neighbourCount = max(cvrp::defaultNeighbourCount, control.savingsNeighbours);
+        if (!loaded.distances || (loaded.distances->neighbourCount() < neighbourCount
+                                  && loaded.distances->neighbourCount() + 1 < loaded.problem.nodes.size())){
+            loaded.distances.reset(new cvrp::distanceCache(loaded.problem, neighbourCount));
+        }
+        if (verbose){
+            chrono::duration<double> loadTime = chrono::steady_clock::now() - loadStart;
+            cerr << "loaded " << source << " (" << loaded.problem.dimension << " nodes) in "
+                 << loadTime.count() * 1000 << " ms" << endl;
+        }
+    }
+    catch (const runtime_error& e){
+        cout << "Invalid problem: " << e.what() << endl;
+        return 1;
+    }
+    const cvrp::problemParameters& problem = loaded.problem;
+    const cvrp::distanceCache& distances = *loaded.distances;
+    if (!snapshotFilename.empty()){
+        try{
+            cvrp::saveSnapshot(snapshotFilename, problem, distances, snapshotMatrix);
+        }
+        catch (const runtime_error& e){
+            cout << e.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    if (problem.maxRouteLength > 0 || problem.serviceTime > 0){
+        cerr << "warning: route length limits and service times are ignored" << endl;
+    }
+    if (!checkpointFilename.empty()){
+        // A failed checkpoint is reported but does not stop the search
+        control.checkpoint = [&](const cvrp::tabu::searchState& state){
+            try{
+                cvrp::saveSnapshot(checkpointFilename, problem, distances, false, &state);
+            }
+            catch (const runtime_error& e){
+                cerr << "warning: " << e.what() << endl;
+            }
+        };
+    }
+    if (!seeded){
+        options.seed = static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count());
+    }
+    // The sweep shares the threads given for the searches
+    control.sweepThreads = options.threads;
+    cvrp::compactSolution solution;
+    // Threads that cannot be started, such as when memory is short, end the run with an error
+    try{
+        if (loaded.hasSearchState){
+            // Carry on the search saved in the checkpoint
+            try{
+                solution = cvrp::tabu::resumeSearch(loaded.searchState, problem.nodes, problem.capacity, distances, control);
+            }
+            catch (const invalid_argument& e){
+                cout << "Invalid checkpoint: " << e.what() << endl;
+                return 1;
+            }
+        }
+        else if (algorithm == "hgs"){
+            // Find solution using the hybrid genetic search, breeding on every requested thread
+            cvrp::hgs::geneticOptions geneticOptions;
+            geneticOptions.threads = options.threads;
+            geneticOptions.seed = options.seed;
+            solution = cvrp::hgs::solve(problem.nodes, problem.capacity, distances, geneticOptions, control);
+        }
+        else if (algorithm == "decompose"){
+            // Find solution by solving clusters of routes as separate Taburoute sub-problems
+            decomposition.threads = options.threads;
+            decomposition.seed = options.seed;
+            solution = cvrp::decomposition::solve(problem.nodes, problem.capacity, distances, decomposition, control);
+        }
+        else if (multiStart){
+            // Find solution using several Taburoute searches in parallel
+            solution = cvrp::tabu::multiStartTaburoute(problem.nodes, problem.capacity, distances, options, control);
+        }
+        else{
+            // Find solution using Taburoute
+            default_random_engine rng(options.seed);
+            solution = cvrp::tabu::taburoute(problem.nodes, problem.capacity, distances, rng, control);
+        }
+    }
+    catch (const system_error& e){
+        cout << "Solve failed: " << e.what() << endl;
+        return 1;
+    }
     // Output solution
     cout << "login sl12754 58774" << '\n';
     cout << "name Stephen Tozer" << '\n';
-    cout << "algorithm Tabu Search with savings heuristic" << '\n';
+    if (algorithm == "hgs") cout << "algorithm Hybrid Genetic Search with Split and local search" << '\n';
+    else if (algorithm == "decompose") cout << "algorithm Route decomposition with Taburoute sub-problems" << '\n';
+    else cout << "algorithm Tabu Search with savings heuristic" << '\n';
     solution.printSolution(cout);
+    if (verbose && cvrp::telemetry::compiledIn){
+        cvrp::telemetry::writeCounters(cerr);
+    }
+    if (!traceFilename.empty()){
+        ofstream trace(traceFilename);
+        if (!trace){
+            cerr << "Trace file could not be written." << endl;
+            return 1;
+        }
+        cvrp::telemetry::writeChromeTrace(trace);
+    }
     return 0;
 }
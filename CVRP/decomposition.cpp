@@ -0,0 +1,178 @@
+#include "decomposition.h"
+#include "savings.h"
+#include "localsearch.h"
+#include "routecache.h"
+#include "parallel.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <limits>
+
+using namespace std;
+using namespace cvrp;
+
+size_t decomposition::subproblemMemory(size_t customers){
+    size_t n = customers + 1;
+    // Full storage below symmetricStorageThreshold, the lower triangle above it
+    size_t matrix = n < symmetricStorageThreshold ? n * n : (n * (n + 1)) / 2;
+    // A route cache entry holds its list and index nodes and an optimised route of about 20 customers
+    size_t routeCacheEntry = 192;
+    return matrix * sizeof(double) + n * defaultNeighbourCount * sizeof(uint16_t)
+         + n * (sizeof(node) + 2 * sizeof(float)) + n * 8 * sizeof(size_t)
+         + subproblemRouteCacheSize * routeCacheEntry;
+}
+
+vector<vector<size_t>> decomposition::partitionRoutes(const compactSolution& routes, size_t maxCustomers, size_t offset){
+    vector<pair<double, size_t>> angles;
+    for (size_t r = 0; r < routes.routeCount(); r++){
+        if (routes.routeLength(r) > 0) angles.push_back(make_pair(routes.centroidAngle(r), r));
+    }
+    sort(angles.begin(), angles.end());
+    vector<vector<size_t>> clusters;
+    size_t customers = 0;
+    for (size_t k = 0; k < angles.size(); k++){
+        size_t r = angles[(offset + k) % angles.size()].second;
+        if (clusters.empty() || customers + routes.routeLength(r) > maxCustomers){
+            clusters.push_back(vector<size_t>());
+            customers = 0;
+        }
+        clusters.back().push_back(r);
+        customers += routes.routeLength(r);
+    }
+    return clusters;
+}
+
+namespace{
+
+    // Improves the given routes as a sub-problem of their own with Taburoute's tabu search, and returns the
+    // resulting routes as node indices of the whole problem, or the given routes if the search found nothing
+    // cheaper
+    vector<vector<uint16_t>> solveCluster(const compactSolution& current, const vector<size_t>& cluster,
+                                          uint16_t vehicleCapacity, default_random_engine& rng,
+                                          const tabu::searchControl& control){
+        vector<vector<uint16_t>> original;
+        double originalCost = 0;
+        for (size_t r : cluster){
+            original.push_back(vector<uint16_t>(current.route(r), current.route(r) + current.routeLength(r)));
+            originalCost += current.routeCost(r);
+        }
+        // A single route has nothing to exchange with
+        if (cluster.size() < 2) return original;
+
+        // Sub-problem node k + 1 is customers[k] of the whole problem; the depot stays node 0
+        const vector<node>& nodes = current.problemNodes();
+        const distanceCache& distances = current.problemDistances();
+        vector<uint16_t> customers;
+        for (const auto& route : original) customers.insert(customers.end(), route.begin(), route.end());
+        vector<node> subNodes(1, nodes[0]);
+        for (uint16_t v : customers){
+            node customer = nodes[v];
+            customer.num = static_cast<uint16_t>(subNodes.size() + 1);
+            subNodes.push_back(customer);
+        }
+        // Distances that do not come from the coordinates are copied from the whole problem
+        vector<double> weights;
+        if (!distances.spatialIndex()){
+            weights.resize(subNodes.size() * subNodes.size());
+            for (size_t i = 0; i < subNodes.size(); i++){
+                for (size_t j = 0; j < subNodes.size(); j++){
+                    weights[i * subNodes.size() + j] = distances(i == 0 ? 0 : customers[i - 1], j == 0 ? 0 : customers[j - 1]);
+                }
+            }
+        }
+        distanceCache subDistances(subNodes, weights);
+        // The search starts from the cluster's own routes, which the customers were numbered along
+        compactSolution initial(subNodes, subDistances);
+        vector<uint16_t> indices;
+        uint16_t next = 1;
+        for (const auto& route : original){
+            indices.clear();
+            for (size_t p = 0; p < route.size(); p++) indices.push_back(next++);
+            initial.appendRoute(indices.data(), indices.size());
+        }
+        compactSolution solved = tabu::improve(initial, vehicleCapacity, rng, control);
+        if (!solved.isFeasible(vehicleCapacity) || solved.cost() >= originalCost - local::improvementEpsilon){
+            return original;
+        }
+        vector<vector<uint16_t>> result;
+        for (size_t r = 0; r < solved.routeCount(); r++){
+            if (solved.routeLength(r) == 0) continue;
+            result.push_back(vector<uint16_t>());
+            for (size_t p = 0; p < solved.routeLength(r); p++) result.back().push_back(customers[solved.route(r)[p] - 1]);
+        }
+        return result;
+    }
+
+}
+
+// Each cluster is solved with its own random engine, seeded from the base seed, the round and the cluster's
+// index, and the clusters' routes are gathered in cluster order, so that the result does not depend on which
+// worker solves which cluster.
+compactSolution decomposition::solve(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                     const decompositionOptions& options, const tabu::searchControl& control){
+    CVRP_SCOPE("decomposition");
+    compactSolution current = clarkeWrightRoutes(nodes, vehicleCapacity, distances, control.savingsNeighbours);
+    if (control.localSearch){
+        local::workspace scratch;
+        local::improve(current, vehicleCapacity, scratch);
+    }
+    current.removeEmptyRoutes();
+    double currentCost = current.cost();
+    if (control.improved && current.isFeasible(vehicleCapacity)) control.improved(current, currentCost, 0);
+
+    // Shrink the sub-problems, and then the number solved at once, until they fit the memory budget
+    size_t threads = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+    size_t subproblemSize = max<size_t>(1, options.subproblemSize);
+    if (options.memoryBudget){
+        while (subproblemSize > minimumSubproblemSize && threads * subproblemMemory(subproblemSize) > options.memoryBudget){
+            subproblemSize = max(minimumSubproblemSize, subproblemSize * 3 / 4);
+        }
+        threads = max<size_t>(1, min(threads, options.memoryBudget / subproblemMemory(subproblemSize)));
+    }
+    threadPool pool(threads);
+    vector<tabu::searchWorkspace> workspaces(pool.size());
+
+    size_t customerCount = nodes.size() - 1;
+    for (size_t round = 0; round < options.rounds; round++){
+        if (control.stop && control.stop->load(memory_order_relaxed)) break;
+        if (control.hasDeadline && chrono::steady_clock::now() >= control.deadline) break;
+        // Shift the cuts by about half a cluster each round
+        size_t routesPerCluster = max<size_t>(1, current.routeCount() * subproblemSize / max<size_t>(1, customerCount));
+        size_t offset = round * max<size_t>(1, routesPerCluster / 2);
+        vector<vector<size_t>> clusters = partitionRoutes(current, subproblemSize, offset);
+        vector<vector<vector<uint16_t>>> results(clusters.size());
+        for (size_t c = 0; c < clusters.size(); c++){
+            pool.submit([&, c, round](size_t worker){
+                seed_seq seeds{ options.seed, static_cast<unsigned>(round), static_cast<unsigned>(c) };
+                default_random_engine rng(seeds);
+                // Each search gets a small route cache of its own, as the cache is keyed by the sub-problem's
+                // node indices
+                routeCache routes(subproblemRouteCacheSize);
+                tabu::searchControl subControl;
+                subControl.stop = control.stop;
+                subControl.hasDeadline = control.hasDeadline;
+                subControl.deadline = control.deadline;
+                subControl.iterationLimit = control.iterationLimit;
+                subControl.localSearch = control.localSearch;
+                subControl.routeOptimization = control.routeOptimization;
+                subControl.routes = &routes;
+                subControl.workspace = &workspaces[worker];
+                results[c] = solveCluster(current, clusters[c], vehicleCapacity, rng, subControl);
+                CVRP_GAUGE(routeCacheRoutes, routes.size());
+            });
+        }
+        pool.wait();
+        compactSolution stitched(nodes, distances);
+        for (const auto& cluster : results){
+            for (const auto& route : cluster) stitched.appendRoute(route.data(), route.size());
+        }
+        double stitchedCost = stitched.cost();
+        if (stitchedCost < currentCost - local::improvementEpsilon){
+            current = stitched;
+            currentCost = stitchedCost;
+            if (control.improved) control.improved(current, currentCost, round + 1);
+        }
+    }
+    return current;
+}
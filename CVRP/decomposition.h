@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "cvrp.h"
+#include "distances.h"
+#include "routes.h"
+#include "tabu.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Route decomposition for problems too large for a single search. The Clarke-Wright routes, improved by
+    // local search, are ordered by the polar angle of their centroid around the depot and cut into clusters
+    // of neighbouring routes with at most a given number of customers. Each cluster's customers form a
+    // sub-problem with the same depot and capacity, whose routes are improved independently by Taburoute's
+    // tabu search starting from the cluster's routes; the sub-problems are solved in parallel and a
+    // sub-problem's routes replace the cluster's only if they are cheaper.
+    // Further rounds cut the clusters starting half a cluster further round, so that routes on either side
+    // of one round's cluster boundaries are solved together in the next.
+    // Only the sub-problems store distance matrices; the whole problem's distances are whatever its own
+    // cache holds, computed on demand from the coordinates above computedStorageThreshold nodes.
+    namespace decomposition{
+
+        // Largest number of customers in a sub-problem unless otherwise requested
+        const size_t defaultSubproblemSize = 200;
+        // Smallest sub-problem size that a memory budget may shrink sub-problems to
+        const size_t minimumSubproblemSize = 50;
+        const size_t defaultRounds = 4;
+        // Number of routes remembered by the route cache of each sub-problem's search
+        const size_t subproblemRouteCacheSize = 4096;
+
+        struct decompositionOptions{
+            decompositionOptions()
+                : subproblemSize(defaultSubproblemSize), rounds(defaultRounds), threads(0), seed(0),
+                  memoryBudget(0) {}
+            size_t subproblemSize;
+            size_t rounds;
+            // Number of sub-problems solved at once, or 0 for one per hardware thread
+            size_t threads;
+            unsigned seed;
+            // Bytes that the sub-problems being solved at once may use together, or 0 for no limit. Within
+            // the budget, the thread count is kept and the sub-problems are made smaller, down to
+            // minimumSubproblemSize customers, after which fewer are solved at once.
+            size_t memoryBudget;
+        };
+
+        // Returns an estimate of the memory used while solving a sub-problem with the given number of
+        // customers: its distance matrix and neighbour lists, its nodes, the search's state and route cache
+        size_t subproblemMemory(size_t customers);
+
+        // Returns the route indices of each cluster of 'routes', cut from the routes in order of centroid angle
+        // starting 'offset' routes round, each holding at most 'maxCustomers' customers unless a single route
+        // holds more
+        vector<vector<size_t>> partitionRoutes(const compactSolution& routes, size_t maxCustomers, size_t offset);
+
+        // Solves the problem by decomposition. The stop flag, deadline, iteration limit, local search and route
+        // optimisation settings of 'control' apply to every sub-problem's search; its callback is called after
+        // every round that improves the solution, with the round number as the iteration. The result depends
+        // only on the options and not on thread scheduling, unless the deadline or stop flag ends the search.
+        compactSolution solve(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                              const decompositionOptions& options = decompositionOptions(),
+                              const tabu::searchControl& control = tabu::searchControl());
+
+    }
+
+}
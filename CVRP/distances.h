@@ -0,0 +1,307 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <type_traits>
+#include <memory>
+#include <stdint.h>
+#include "cvrp.h"
+#include "kernels.h"
+#include "spatial.h"
+#include "telemetry.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Storage layout of a distance cache: 'full' keeps the complete row-major n*n matrix, 'symmetric'
+    // keeps only the lower triangle (half the memory, no contiguous rows), 'computed' keeps no matrix and
+    // computes each distance from the node coordinates when asked (memory linear in the node count),
+    // 'automatic' picks 'symmetric' once the node count reaches symmetricStorageThreshold and 'computed' once
+    // it reaches computedStorageThreshold, if the distances come from coordinates
+    enum class distanceStorage { full, symmetric, computed, automatic };
+
+    const size_t symmetricStorageThreshold = 4096;
+    const size_t computedStorageThreshold = 16384;
+
+    // Number of nearest neighbours stored for each node unless otherwise requested
+    const size_t defaultNeighbourCount = 30;
+
+    // Distances between every pair of nodes in a problem, computed once and shared by every part of the
+    // solver, along with a list of the nearest neighbours of each node.
+    // All indices are node indices, i.e. node.num - 1, so that the depot is index 0. Distances are held as
+    // the value type of the cost policy (see cvrp.h), converted from the exact distances by the policy.
+    template<typename Policy>
+    class basicDistanceCache{
+    public:
+        typedef Policy policy;
+        typedef typename Policy::value_type value_type;
+
+        basicDistanceCache(const vector<node>& nodes, size_t neighbourCount = defaultNeighbourCount,
+                           distanceStorage storage = distanceStorage::automatic)
+            : basicDistanceCache(nodes, vector<double>(), neighbourCount, storage) {}
+        // Takes the distances from the row-major matrix 'weights' instead of the node coordinates, unless it is empty
+        basicDistanceCache(const vector<node>& nodes, const vector<double>& weights,
+                           size_t neighbourCount = defaultNeighbourCount,
+                           distanceStorage storage = distanceStorage::automatic);
+        basicDistanceCache(const problemParameters& problem, size_t neighbourCount = defaultNeighbourCount,
+                           distanceStorage storage = distanceStorage::automatic)
+            : basicDistanceCache(problem.nodes, problem.edgeWeights, neighbourCount, storage) {}
+        // Restores a cache from the stored distances and neighbour lists of one built for the same nodes and
+        // weights, as returned by storedDistances() and neighbourLists(). The 'storedCount' distances at
+        // 'stored' are used in place, without a copy, and 'owner' is held to keep them alive, such as the
+        // mapping of a snapshot file. 'stored' is ignored with computed storage, and the distances are computed
+        // again if it is null, as are the neighbour lists if they do not match the node and neighbour counts.
+        basicDistanceCache(const vector<node>& nodes, const vector<double>& weights, distanceStorage storage,
+                           const value_type* stored, size_t storedCount, shared_ptr<const void> owner,
+                           vector<uint16_t> neighbourLists, size_t neighbourCount);
+
+        // Returns the distance between the nodes with indices i and j, widened to double so that sums and move
+        // gains are never rounded to the stored type
+        double operator()(size_t i, size_t j) const{
+            if (computed){
+                double dx = coords.x[i] - coords.x[j], dy = coords.y[i] - coords.y[j];
+                return Policy::fromDistance(sqrt(dx*dx + dy*dy));
+            }
+            if (!symmetric) return matrix[i*nodeCount + j];
+            if (i < j) swap(i, j);
+            return matrix[((i*(i+1)) >> 1) + j];
+        }
+        // Returns the distance between nodes a and b
+        double operator()(node a, node b) const { return (*this)(a.num - 1, b.num - 1); }
+        // Returns the distance between the nodes with indices i and j before the policy rounded it: the
+        // euclidean distance, or the edge weight the cache was given
+        double exactDistance(size_t i, size_t j) const{
+            if (Policy::exact) return (*this)(i, j);
+            if (!coordinateDistances) return exactWeights[i*nodeCount + j];
+            double dx = static_cast<double>(coords.x[i]) - coords.x[j], dy = static_cast<double>(coords.y[i]) - coords.y[j];
+            return sqrt(dx*dx + dy*dy);
+        }
+
+        // Returns the number of nodes covered by this cache
+        size_t size() const { return nodeCount; }
+        // Returns true if only the lower triangle of the matrix is stored
+        bool isSymmetric() const { return symmetric; }
+        // Returns true if no matrix is stored and distances are computed from the coordinates
+        bool isComputed() const { return computed; }
+        // Returns the contiguous row of distances from node i; only available with full storage
+        const value_type* row(size_t i) const{
+            if (symmetric || computed) throw logic_error("Distance rows are only stored with full storage.");
+            return matrix + i*nodeCount;
+        }
+
+        // Returns the distances from node i to nodes 0 to i, which are contiguous with full or symmetric storage
+        const value_type* lowerRow(size_t i) const{
+            if (computed) throw logic_error("Distance rows are not stored with computed storage.");
+            return matrix + (symmetric ? (i*(i+1)) >> 1 : i*nodeCount);
+        }
+        // Returns the node coordinates
+        const nodeArrays& coordinates() const { return coords; }
+        // Returns true if the distances are the euclidean distances between the node coordinates, so that
+        // they can be recomputed by the distance kernels and rounded by the policy
+        bool hasCoordinateDistances() const { return coordinateDistances; }
+
+        // Writes the distances from node 'from' to nodes 'begin' to 'end' - 1 to out
+        void distancesFrom(size_t from, size_t begin, size_t end, double* out) const{
+            if (hasCoordinateDistances()){
+                kernels::distancesFrom(coords, from, begin, end, out);
+                roundDistances(out, end - begin);
+                return;
+            }
+            for (size_t j = begin; j < end; j++) out[j - begin] = (*this)(from, j);
+        }
+        // Writes the distances from node 'from' to each of the 'count' nodes in 'indices' to out
+        void distancesTo(size_t from, const uint16_t* indices, size_t count, double* out) const{
+            if (hasCoordinateDistances()){
+                kernels::distancesTo(coords, from, indices, count, out);
+                roundDistances(out, count);
+                return;
+            }
+            for (size_t k = 0; k < count; k++) out[k] = (*this)(from, indices[k]);
+        }
+        // Writes the cost of inserting node v after each position of the closed tour 'route' to out, as
+        // kernels::insertionCosts. The kernel adds up unrounded distances, so other policies sum stored ones.
+        void insertionCosts(size_t v, const uint16_t* route, size_t length, double* out) const{
+            if (hasCoordinateDistances() && Policy::exact){
+                kernels::insertionCosts(coords, v, route, length, out);
+                return;
+            }
+            for (size_t p = 0; p < length; p++){
+                size_t next = p + 1 == length ? 0 : p + 1;
+                out[p] = (*this)(route[p], v) + (*this)(v, route[next]) - (*this)(route[p], route[next]);
+            }
+        }
+
+        // Returns a spatial index over the node coordinates, or nullptr if the distances are not the euclidean
+        // distances between them
+        const spatialGrid* spatialIndex() const { return coordinateDistances ? &grid : nullptr; }
+
+        // Returns the number of neighbours stored for each node
+        size_t neighbourCount() const { return neighboursPerNode; }
+        // Returns the indices of the nearest neighbours of node i, nearest first; the depot is included
+        // if it is near enough, node i itself is not
+        const uint16_t* neighbours(size_t i) const { return nearest.data() + i*neighboursPerNode; }
+
+        // Returns the stored matrix, in the layout given by isSymmetric(), and its number of distances; there
+        // is none with computed storage
+        const value_type* storedDistances() const { return matrix; }
+        size_t storedDistanceCount() const { return computed ? 0 : matrixSize(); }
+        // Returns the neighbour lists of every node, one after another
+        const vector<uint16_t>& neighbourLists() const { return nearest; }
+
+    private:
+        // Rounds distances computed by the kernels to the values the policy stores, in a loop the compiler
+        // vectorises; exact distances are left as they are
+        static void roundDistances(double* out, size_t count){
+            if (Policy::exact) return;
+            for (size_t k = 0; k < count; k++) out[k] = Policy::fromDistance(out[k]);
+        }
+        // Sets the storage layout, resolving 'automatic' by node count
+        void setStorage(distanceStorage storage);
+        // Computes the matrix from the coordinates or copies it from 'weights'
+        void fillMatrix(const vector<double>& weights);
+        // Builds the neighbour list of every node
+        void buildNeighbours();
+        // Returns the number of distances in the stored matrix
+        size_t matrixSize() const { return symmetric ? (nodeCount*(nodeCount+1)) >> 1 : nodeCount*nodeCount; }
+
+        size_t nodeCount;
+        nodeArrays coords;
+        bool coordinateDistances;
+        bool symmetric;
+        bool computed;
+        // The stored matrix, which is either 'distances' or memory kept alive by 'storedOwner'
+        const value_type* matrix;
+        vector<value_type> distances;
+        shared_ptr<const void> storedOwner;
+        size_t neighboursPerNode;
+        vector<uint16_t> nearest;
+        spatialGrid grid;
+        // The edge weights as given, kept by policies that round them so that costs can be reported exactly
+        vector<double> exactWeights;
+    };
+
+    template<typename Policy>
+    basicDistanceCache<Policy>::basicDistanceCache(const vector<node>& nodes, const vector<double>& weights,
+                                                   size_t neighbourCount, distanceStorage storage)
+        : nodeCount(nodes.size()), coords(nodes), coordinateDistances(weights.empty()),
+          matrix(nullptr), neighboursPerNode(min(neighbourCount, nodes.empty() ? 0 : nodes.size() - 1)),
+          exactWeights(Policy::exact ? vector<double>() : weights){
+        CVRP_SCOPE("distances");
+        if (!weights.empty() && weights.size() != nodeCount*nodeCount){
+            throw invalid_argument("Edge weight matrix does not match the node count.");
+        }
+        setStorage(storage);
+        fillMatrix(weights);
+        buildNeighbours();
+    }
+
+    template<typename Policy>
+    basicDistanceCache<Policy>::basicDistanceCache(const vector<node>& nodes, const vector<double>& weights,
+                                                   distanceStorage storage, const value_type* stored,
+                                                   size_t storedCount, shared_ptr<const void> owner,
+                                                   vector<uint16_t> neighbourLists, size_t neighbourCount)
+        : nodeCount(nodes.size()), coords(nodes), coordinateDistances(weights.empty()),
+          matrix(nullptr), neighboursPerNode(min(neighbourCount, nodes.empty() ? 0 : nodes.size() - 1)),
+          exactWeights(Policy::exact ? vector<double>() : weights){
+        CVRP_SCOPE("distances");
+        if (!weights.empty() && weights.size() != nodeCount*nodeCount){
+            throw invalid_argument("Edge weight matrix does not match the node count.");
+        }
+        setStorage(storage);
+        if (!stored || computed){
+            fillMatrix(weights);
+        }
+        else if (storedCount != matrixSize()){
+            throw invalid_argument("Stored distances do not match the node count.");
+        }
+        else{
+            matrix = stored;
+            storedOwner = move(owner);
+        }
+        if (neighbourLists.size() != nodeCount*neighboursPerNode){
+            buildNeighbours();
+            return;
+        }
+        for (uint16_t j : neighbourLists){
+            if (j >= nodeCount) throw invalid_argument("Stored neighbour lists refer to a missing node.");
+        }
+        nearest = move(neighbourLists);
+        if (coordinateDistances) grid = spatialGrid(coords);
+    }
+
+    template<typename Policy>
+    void basicDistanceCache<Policy>::setStorage(distanceStorage storage){
+        if (storage == distanceStorage::computed && !coordinateDistances){
+            throw invalid_argument("Distances can only be computed on demand from coordinates.");
+        }
+        if (storage == distanceStorage::automatic){
+            if (nodeCount >= computedStorageThreshold && coordinateDistances) storage = distanceStorage::computed;
+            else if (nodeCount >= symmetricStorageThreshold) storage = distanceStorage::symmetric;
+            else storage = distanceStorage::full;
+        }
+        symmetric = storage == distanceStorage::symmetric;
+        computed = storage == distanceStorage::computed;
+    }
+
+    template<typename Policy>
+    void basicDistanceCache<Policy>::fillMatrix(const vector<double>& weights){
+        if (!computed) distances.resize(matrixSize());
+        matrix = distances.data();
+        // Each lower row is computed with a single vectorised one-to-many kernel call, or copied from the
+        // given weights
+        vector<double> rowDistances(computed ? 0 : nodeCount);
+        for (size_t i = 0; i < nodeCount && !computed; i++){
+            if (coordinateDistances) kernels::distancesFrom(coords, i, 0, i + 1, rowDistances.data());
+            else copy(weights.begin() + i*nodeCount, weights.begin() + i*nodeCount + i + 1, rowDistances.begin());
+            value_type* lower = distances.data() + (symmetric ? (i*(i+1)) >> 1 : i*nodeCount);
+            for (size_t j = 0; j <= i; j++){
+                lower[j] = Policy::fromDistance(rowDistances[j]);
+                if (!symmetric) distances[j*nodeCount + i] = lower[j];
+            }
+        }
+    }
+
+    template<typename Policy>
+    void basicDistanceCache<Policy>::buildNeighbours(){
+        nearest.resize(nodeCount*neighboursPerNode);
+        if (coordinateDistances){
+            // Build the neighbour lists from a spatial index, which only looks at the nodes near each node
+            grid = spatialGrid(coords);
+            for (size_t i = 0; i < nodeCount; i++){
+                grid.nearest(coords.x[i], coords.y[i], neighboursPerNode, nearest.data() + i*neighboursPerNode,
+                             [i](size_t j) { return j != i; });
+            }
+            return;
+        }
+        // Build the neighbour lists with a partial sort of each row, ordering equally distant nodes by index
+        vector<uint16_t> candidates;
+        candidates.reserve(nodeCount);
+        for (size_t i = 0; i < nodeCount; i++){
+            candidates.clear();
+            for (size_t j = 0; j < nodeCount; j++){
+                if (j != i) candidates.push_back(static_cast<uint16_t>(j));
+            }
+            partial_sort(candidates.begin(), candidates.begin() + neighboursPerNode, candidates.end(),
+                         [&](uint16_t a, uint16_t b){
+                             double da = (*this)(i, a), db = (*this)(i, b);
+                             return da < db || (da == db && a < b);
+                         });
+            copy(candidates.begin(), candidates.begin() + neighboursPerNode, nearest.begin() + i*neighboursPerNode);
+        }
+    }
+
+    // Returns the total cost of travelling the cycle formed by 'nodes', using precomputed distances
+    template<typename Policy>
+    double cost(const vector<node>& nodes, const basicDistanceCache<Policy>& distances){
+        double totalCost = 0;
+        for (size_t i = 0; i < nodes.size() - 1; i++){
+            totalCost += distances(nodes[i], nodes[i+1]);
+        }
+        totalCost += distances(nodes[0], nodes.back());
+        return totalCost;
+    }
+
+}
@@ -0,0 +1,187 @@
+#include "dynamic.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "telemetry.h"
+
+using namespace std;
+using namespace cvrp;
+
+dynamicSolver::dynamicSolver(const problemParameters& problem, unsigned seed, const tabu::searchControl& control)
+    : capacity(static_cast<uint16_t>(problem.capacity)), nodes(problem.nodes), nextId(1), rng(seed){
+    if (!problem.edgeWeights.empty()){
+        throw invalid_argument("Dynamic problems need distances given by node coordinates.");
+    }
+    if (nodes.empty()) throw invalid_argument("Dynamic problems need a depot.");
+    ids.assign(1, 0);
+    for (size_t v = 1; v < nodes.size(); v++){
+        ids.push_back(nextId);
+        indices[nextId++] = v;
+    }
+    distances.reset(new distanceCache(nodes, defaultNeighbourCount, distanceStorage::computed));
+    if (nodes.size() > 1){
+        solution = tabu::taburoute(nodes, capacity, *distances, rng, control);
+    }
+    else{
+        solution = compactSolution(nodes, *distances);
+    }
+}
+
+size_t dynamicSolver::indexOf(uint32_t id) const{
+    auto found = indices.find(id);
+    if (found == indices.end()) throw invalid_argument("No customer has the given id.");
+    return found->second;
+}
+
+vector<uint32_t> dynamicSolver::routeCustomers(size_t r) const{
+    vector<uint32_t> customers;
+    for (size_t p = 0; p < solution.routeLength(r); p++) customers.push_back(ids[solution.route(r)[p]]);
+    return customers;
+}
+
+vector<vector<uint16_t>> dynamicSolver::currentRoutes(const vector<size_t>& newIndex) const{
+    vector<vector<uint16_t>> routes;
+    for (size_t r = 0; r < solution.routeCount(); r++){
+        routes.emplace_back();
+        for (size_t p = 0; p < solution.routeLength(r); p++){
+            size_t v = solution.route(r)[p];
+            routes.back().push_back(static_cast<uint16_t>(newIndex.empty() ? v : newIndex[v]));
+        }
+    }
+    return routes;
+}
+
+// The solution refers to the distances, so it is rebuilt alongside them; routes that end up empty are dropped
+void dynamicSolver::rebuild(const vector<vector<uint16_t>>& routes){
+    unique_ptr<distanceCache> rebuilt(new distanceCache(nodes, defaultNeighbourCount, distanceStorage::computed));
+    compactSolution patched(nodes, *rebuilt);
+    for (const auto& customers : routes){
+        if (!customers.empty()) patched.appendRoute(customers.data(), customers.size());
+    }
+    solution = move(patched);
+    distances = move(rebuilt);
+}
+
+// Only the routes of v's nearest neighbours are tried, as in the tabu search, and the cheapest GENI insertion
+// among those with room for v is taken unless serving v from a route of its own costs less
+size_t dynamicSolver::insertCustomer(size_t v){
+    size_t bestRoute = solution.routeCount();
+    double bestDelta = 2 * (*distances)(0, v);
+    tabu::geniMove bestMove;
+    const uint16_t* neighbours = distances->neighbours(v);
+    size_t neighbourCount = min(tabu::tabuNeighbours, distances->neighbourCount());
+    for (size_t n = 0; n < neighbourCount; n++){
+        size_t r = solution.routeOf(neighbours[n]);
+        if (r == compactSolution::noRoute || solution.load(r) + nodes[v].demand > capacity) continue;
+        // Each route is evaluated once, from the nearest of its customers
+        bool seen = false;
+        for (size_t m = 0; m < n && !seen; m++) seen = solution.routeOf(neighbours[m]) == r;
+        if (seen) continue;
+        tour.assign(1, 0);
+        tour.insert(tour.end(), solution.route(r), solution.route(r) + solution.routeLength(r));
+        tabu::geniMove move = tabu::geniEvaluate(tour.data(), tour.size(), v, *distances, geni);
+        if (move.delta < bestDelta){
+            bestDelta = move.delta;
+            bestMove = move;
+            bestRoute = r;
+        }
+    }
+    if (bestRoute == solution.routeCount()){
+        uint16_t customer = static_cast<uint16_t>(v);
+        solution.appendRoute(&customer, 1);
+        return bestRoute;
+    }
+    tour.assign(1, 0);
+    tour.insert(tour.end(), solution.route(bestRoute), solution.route(bestRoute) + solution.routeLength(bestRoute));
+    vector<uint16_t>& inserted = geni.insertedTour;
+    tabu::geniApply(tour.data(), tour.size(), static_cast<uint16_t>(v), bestMove, inserted);
+    rotate(inserted.begin(), find(inserted.begin(), inserted.end(), 0), inserted.end());
+    solution.setRoute(bestRoute, inserted.data() + 1, inserted.size() - 1);
+    return bestRoute;
+}
+
+void dynamicSolver::reoptimize(const vector<size_t>& routes, const vector<size_t>& around){
+    CVRP_SCOPE("reoptimize");
+    seeds.clear();
+    for (size_t r : routes){
+        if (r < solution.routeCount()) seeds.insert(seeds.end(), solution.route(r), solution.route(r) + solution.routeLength(r));
+    }
+    size_t neighbourCount = min(local::defaultNeighbours, distances->neighbourCount());
+    for (size_t v : around){
+        seeds.push_back(static_cast<uint16_t>(v));
+        const uint16_t* neighbours = distances->neighbours(v);
+        for (size_t n = 0; n < neighbourCount; n++){
+            if (neighbours[n] != 0) seeds.push_back(neighbours[n]);
+        }
+    }
+    sort(seeds.begin(), seeds.end());
+    seeds.erase(unique(seeds.begin(), seeds.end()), seeds.end());
+    local::improve(solution, capacity, seeds.data(), seeds.size(), localSearch);
+    solution.removeEmptyRoutes();
+}
+
+uint32_t dynamicSolver::addCustomer(float x, float y, uint16_t demand){
+    if (demand > capacity) throw invalid_argument("Customer demand exceeds the vehicle capacity.");
+    if (nodes.size() >= compactSolution::noRoute) throw invalid_argument("Too many customers.");
+    size_t v = nodes.size();
+    node added;
+    added.num = static_cast<uint16_t>(v + 1);
+    added.demand = demand;
+    added.x = x;
+    added.y = y;
+    nodes.push_back(added);
+    ids.push_back(nextId);
+    indices[nextId] = v;
+    rebuild(currentRoutes());
+    size_t r = insertCustomer(v);
+    reoptimize(vector<size_t>(1, r), vector<size_t>(1, v));
+    return nextId++;
+}
+
+// Later nodes move down one index to keep the node numbers contiguous
+void dynamicSolver::removeCustomer(uint32_t id){
+    size_t v = indexOf(id);
+    size_t before = solution.previous(v), after = solution.next(v);
+    vector<size_t> newIndex(nodes.size());
+    for (size_t u = 0; u < nodes.size(); u++) newIndex[u] = u < v ? u : u - 1;
+    solution.remove(v);
+    vector<vector<uint16_t>> routes = currentRoutes(newIndex);
+    nodes.erase(nodes.begin() + v);
+    ids.erase(ids.begin() + v);
+    indices.erase(id);
+    for (size_t u = v; u < nodes.size(); u++){
+        nodes[u].num = static_cast<uint16_t>(u + 1);
+        indices[ids[u]] = u;
+    }
+    rebuild(routes);
+    // The customers either side of the removed one are now joined by a new edge
+    vector<size_t> around;
+    if (before != 0) around.push_back(newIndex[before]);
+    if (after != 0) around.push_back(newIndex[after]);
+    vector<size_t> affected;
+    for (size_t u : around) affected.push_back(solution.routeOf(u));
+    reoptimize(affected, around);
+}
+
+void dynamicSolver::updateDemand(uint32_t id, uint16_t demand){
+    if (demand > capacity) throw invalid_argument("Customer demand exceeds the vehicle capacity.");
+    size_t v = indexOf(id);
+    size_t r = solution.routeOf(v);
+    nodes[v].demand = demand;
+    // Setting the route again recomputes its cached load
+    tour.assign(solution.route(r), solution.route(r) + solution.routeLength(r));
+    solution.setRoute(r, tour.data(), tour.size());
+    vector<size_t> affected(1, r);
+    if (solution.load(r) > capacity){
+        solution.remove(v);
+        affected.push_back(insertCustomer(v));
+    }
+    reoptimize(affected, vector<size_t>(1, v));
+}
+
+void dynamicSolver::improve(const tabu::searchControl& control){
+    if (solution.routedCount() == 0) return;
+    compactSolution improved = tabu::improve(solution, capacity, rng, control);
+    if (improved.isFeasible(capacity) && improved.cost() < solution.cost()) solution = move(improved);
+    solution.removeEmptyRoutes();
+}
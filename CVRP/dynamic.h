@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <stdint.h>
+#include "cvrp.h"
+#include "distances.h"
+#include "routes.h"
+#include "localsearch.h"
+#include "tabu.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // A live problem and solution that change as customers are added, cancelled and resized, for dispatching
+    // orders through the day without solving the whole problem again after every change.
+    // Each event patches the current solution: a new customer is inserted with GENI into the cheapest of the
+    // routes near it that can carry it, or into a route of its own, and local search is then run from the
+    // customers of the routes the event touched and the new customer's neighbours, so that only the part of
+    // the solution around the change is reconsidered. improve() runs a full tabu search from the current
+    // solution when there is time for one.
+    // Customers are identified by ids given out when they are added, which stay the same while node indices
+    // are compacted after removals. Distances are computed from the coordinates rather than stored, so that
+    // each event costs time linear in the number of customers.
+    class dynamicSolver{
+    public:
+        // Solves the initial problem, which must have coordinate distances, with Taburoute; its customers are
+        // given the ids 1 to problem.dimension - 1 in node order
+        dynamicSolver(const problemParameters& problem, unsigned seed = 0,
+                      const tabu::searchControl& control = tabu::searchControl());
+        dynamicSolver(const dynamicSolver&) = delete;
+        dynamicSolver& operator=(const dynamicSolver&) = delete;
+
+        // Adds a customer and returns its id
+        uint32_t addCustomer(float x, float y, uint16_t demand);
+        // Removes the customer with the given id
+        void removeCustomer(uint32_t id);
+        // Changes the demand of the customer with the given id, moving it to another route if its own can no
+        // longer carry it
+        void updateDemand(uint32_t id, uint16_t demand);
+        // Runs a tabu search from the current solution and keeps its result if it is cheaper
+        void improve(const tabu::searchControl& control = tabu::searchControl());
+
+        // Returns the current solution, whose node indices are valid until the next event
+        const compactSolution& currentSolution() const { return solution; }
+        double cost() const { return solution.cost(); }
+        size_t customerCount() const { return nodes.size() - 1; }
+        // Returns the ids of the customers of route r in visiting order
+        vector<uint32_t> routeCustomers(size_t r) const;
+        // Returns the id of the customer with node index v
+        uint32_t customerId(size_t v) const { return ids[v]; }
+        // Returns true if a customer with the given id is present
+        bool hasCustomer(uint32_t id) const { return indices.count(id) != 0; }
+
+    private:
+        // Returns the node index of a customer, throwing if there is none with that id
+        size_t indexOf(uint32_t id) const;
+        // Rebuilds the distances for the current nodes and the solution from 'routes', given as node indices
+        void rebuild(const vector<vector<uint16_t>>& routes);
+        // Returns the routes of the current solution as node indices, mapped through 'newIndex' if not empty
+        vector<vector<uint16_t>> currentRoutes(const vector<size_t>& newIndex = vector<size_t>()) const;
+        // Inserts the unrouted customer v into the cheapest nearby route or a new route, returning the route
+        size_t insertCustomer(size_t v);
+        // Runs local search from the customers of 'routes' and the given nodes' neighbours
+        void reoptimize(const vector<size_t>& routes, const vector<size_t>& around);
+
+        uint16_t capacity;
+        vector<node> nodes;
+        // Customer id of each node index, and the node index of each id
+        vector<uint32_t> ids;
+        unordered_map<uint32_t, size_t> indices;
+        uint32_t nextId;
+        default_random_engine rng;
+        unique_ptr<distanceCache> distances;
+        compactSolution solution;
+        tabu::geniWorkspace geni;
+        local::workspace localSearch;
+        vector<uint16_t> tour;
+        vector<uint16_t> seeds;
+    };
+
+}
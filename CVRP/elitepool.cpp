@@ -0,0 +1,197 @@
+#include "elitepool.h"
+#include "distances.h"
+#include "hgs.h"
+#include "localsearch.h"
+#include "telemetry.h"
+#include <limits>
+
+using namespace std;
+using namespace cvrp;
+
+elitePool::elitePool(size_t capacity, size_t participantCount)
+    : globalEpoch(1), gate(numeric_limits<double>::max()), memberCount(0){
+    for (size_t k = 0; k < max<size_t>(1, capacity); k++){
+        slots.push_back(unique_ptr<atomic<const member*>>(new atomic<const member*>(nullptr)));
+    }
+    for (size_t p = 0; p < max<size_t>(1, participantCount); p++){
+        participants.push_back(unique_ptr<participantState>(new participantState()));
+    }
+}
+
+elitePool::~elitePool(){
+    for (const auto& slot : slots) delete slot->load();
+    for (const auto& state : participants){
+        for (const auto& retired : state->retired) delete retired.second;
+    }
+}
+
+// The announcement must be visible before the slots are read, hence the full fence
+elitePool::readGuard::readGuard(elitePool& pool, size_t participant)
+    : state(*pool.participants[participant]){
+    state.epoch.store(pool.globalEpoch.load(), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+elitePool::readGuard::~readGuard(){
+    state.epoch.store(0, memory_order_release);
+}
+
+// Records a member that is no longer in any slot, advances the global epoch if every reading participant has
+// announced the current one, and frees this participant's members that no reader can still hold
+void elitePool::retire(const member* replaced, size_t participant){
+    participantState& state = *participants[participant];
+    state.retired.push_back(make_pair(globalEpoch.load(), replaced));
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t epoch = globalEpoch.load();
+    bool behind = false;
+    for (const auto& other : participants){
+        uint64_t announced = other->epoch.load(memory_order_acquire);
+        if (announced != 0 && announced != epoch){
+            behind = true;
+            break;
+        }
+    }
+    if (!behind) globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+    uint64_t now = globalEpoch.load();
+    size_t kept = 0;
+    for (const auto& retired : state.retired){
+        if (retired.first + 2 <= now) delete retired.second;
+        else state.retired[kept++] = retired;
+    }
+    state.retired.resize(kept);
+}
+
+// Members are only ever replaced by cheaper ones, so the costliest member seen by a scan of the slots is never
+// below the costliest member once the scan ends, and the gate can only fall
+void elitePool::lowerGate(){
+    double costliest = 0;
+    for (const auto& slot : slots){
+        const member* held = slot->load(memory_order_acquire);
+        if (!held) return;
+        costliest = max(costliest, held->cost);
+    }
+    double current = gate.load();
+    while (costliest < current && !gate.compare_exchange_weak(current, costliest)) {}
+}
+
+bool elitePool::offer(const compactSolution& candidate, double cost, size_t participant){
+    if (cost >= admissionCost()) return false;
+    unique_ptr<member> added(new member());
+    added->routes = candidate;
+    added->routes.removeEmptyRoutes();
+    added->cost = cost;
+    readGuard guard(*this, participant);
+    while (true){
+        size_t empty = slots.size(), closest = slots.size(), costliest = slots.size();
+        const member* closestMember = nullptr;
+        const member* costliestMember = nullptr;
+        double closestDistance = numeric_limits<double>::max();
+        for (size_t k = 0; k < slots.size(); k++){
+            const member* held = slots[k]->load(memory_order_acquire);
+            if (!held){
+                if (empty == slots.size()) empty = k;
+                continue;
+            }
+            double distance = hgs::brokenPairsDistance(held->routes, added->routes);
+            if (distance == 0) return false;
+            if (held->cost <= cost) continue;
+            if (distance < closestDistance){
+                closestDistance = distance;
+                closest = k;
+                closestMember = held;
+            }
+            if (!costliestMember || held->cost > costliestMember->cost){
+                costliest = k;
+                costliestMember = held;
+            }
+        }
+        size_t victim;
+        const member* observed;
+        if (empty < slots.size()){
+            victim = empty;
+            observed = nullptr;
+        }
+        else if (closestMember && closestDistance < eliteSimilarity){
+            victim = closest;
+            observed = closestMember;
+        }
+        else if (costliestMember){
+            victim = costliest;
+            observed = costliestMember;
+        }
+        else{
+            lowerGate();
+            return false;
+        }
+        if (slots[victim]->compare_exchange_strong(observed, added.get(), memory_order_acq_rel)){
+            added.release();
+            if (observed) retire(observed, participant);
+            else memberCount.fetch_add(1, memory_order_acq_rel);
+            lowerGate();
+            CVRP_COUNT(eliteInsertions, 1);
+            return true;
+        }
+        // Another participant changed the slot first, so choose again
+    }
+}
+
+bool elitePool::get(size_t slot, compactSolution& result, double& cost, size_t participant){
+    readGuard guard(*this, participant);
+    const member* held = slots[slot]->load(memory_order_acquire);
+    if (!held) return false;
+    result = held->routes;
+    cost = held->cost;
+    return true;
+}
+
+bool cvrp::pathRelink(const compactSolution& from, const compactSolution& to, uint16_t vehicleCapacity,
+                      compactSolution& result, size_t maxSteps){
+    CVRP_SCOPE("pathRelink");
+    compactSolution current = from;
+    current.removeEmptyRoutes();
+    const vector<node>& nodes = current.problemNodes();
+    if (maxSteps == 0) maxSteps = nodes.size();
+    auto overload = [&](int load) { return load > vehicleCapacity ? load - vehicleCapacity : 0; };
+    int totalOverload = 0;
+    for (size_t r = 0; r < current.routeCount(); r++) totalOverload += overload(current.load(r));
+    bool found = false;
+    double bestCost = numeric_limits<double>::max();
+    for (size_t step = 0; ; step++){
+        // Customer w = to.next(v) follows v in 'to' but not in 'current'
+        size_t moveNode = 0, moveAfter = 0;
+        int moveOverload = numeric_limits<int>::max();
+        double moveDelta = numeric_limits<double>::max();
+        for (size_t v = 1; v < nodes.size(); v++){
+            size_t w = to.next(v);
+            if (w == 0 || current.next(v) == w) continue;
+            double delta = current.removalDelta(w) + current.insertionDelta(w, v, current.next(v));
+            size_t rv = current.routeOf(v), rw = current.routeOf(w);
+            int demand = nodes[w].demand;
+            int overloadAfter = totalOverload;
+            if (rv != rw){
+                overloadAfter += overload(current.load(rv) + demand) - overload(current.load(rv))
+                               + overload(current.load(rw) - demand) - overload(current.load(rw));
+            }
+            if (overloadAfter < moveOverload || (overloadAfter == moveOverload && delta < moveDelta)){
+                moveNode = w;
+                moveAfter = v;
+                moveOverload = overloadAfter;
+                moveDelta = delta;
+            }
+        }
+        // Neither end of the path counts as an intermediate solution
+        if (moveNode == 0) break;
+        if (step > 0 && totalOverload == 0 && current.cost() < bestCost - local::improvementEpsilon){
+            bestCost = current.cost();
+            result = current;
+            found = true;
+        }
+        if (step == maxSteps) break;
+        current.remove(moveNode);
+        current.insert(moveNode, current.routeOf(moveAfter), current.positionOf(moveAfter) + 1u);
+        totalOverload = moveOverload;
+    }
+    if (found) result.removeEmptyRoutes();
+    CVRP_COUNT(pathRelinks, 1);
+    return found;
+}
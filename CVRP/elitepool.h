@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "cvrp.h"
+#include "routes.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Broken-pairs distance below which a new solution replaces its closest costlier member of an elite pool
+    // instead of the costliest one, so that near-copies of one solution do not crowd out the others
+    const double eliteSimilarity = 0.15;
+
+    // The best distinct feasible solutions found by several concurrent searches, held without locks. Each
+    // slot holds a pointer to an immutable member, which insertions swap with a compare-and-swap. A full
+    // pool's admission cost, the cost of its costliest member, is kept in an atomic that only ever falls, so
+    // that searches discard solutions that are no improvement with a single load. Replaced members are
+    // reclaimed by epoch: a participant announces the global epoch while it reads the slots, and a member
+    // retired in epoch e is only freed once the epoch has reached e + 2, which needs every participant
+    // reading the slots to have announced e + 1.
+    // Participants are the threads using the pool, identified by an index below the participant count as
+    // given by threadPool, and each participant index may only be used by one thread at a time.
+    class elitePool{
+    public:
+        // Creates a pool of up to 'capacity' solutions shared by 'participants' threads
+        elitePool(size_t capacity, size_t participants);
+        ~elitePool();
+        elitePool(const elitePool&) = delete;
+        elitePool& operator=(const elitePool&) = delete;
+
+        // Returns the number of slots
+        size_t capacity() const { return slots.size(); }
+        // Returns the number of solutions held
+        size_t size() const { return memberCount.load(memory_order_acquire); }
+        // Returns the cost that a solution must beat to enter the pool, the largest double while it has an empty
+        // slot. It may be higher than the costliest member while another insertion completes, but never lower.
+        double admissionCost() const { return gate.load(memory_order_acquire); }
+
+        // Adds a feasible solution with the given cost, returning true if it entered the pool. It fills an
+        // empty slot, replaces its closest costlier member if that is within eliteSimilarity, or replaces the
+        // costliest member if it is cheaper. Copies of a member are turned away.
+        bool offer(const compactSolution& candidate, double cost, size_t participant);
+        // Copies the member in the given slot and its cost, returning false if the slot is empty
+        bool get(size_t slot, compactSolution& result, double& cost, size_t participant);
+
+    private:
+        struct member{
+            compactSolution routes;
+            double cost;
+        };
+        struct participantState{
+            participantState()
+                : epoch(0) {}
+            // Global epoch announced while reading the slots, or 0 outside
+            atomic<uint64_t> epoch;
+            // Members this participant has replaced, with the epoch they were retired in
+            vector<pair<uint64_t, const member*>> retired;
+        };
+        // Announces the participant for the lifetime of a read of the slots
+        class readGuard{
+        public:
+            readGuard(elitePool& pool, size_t participant);
+            ~readGuard();
+        private:
+            participantState& state;
+        };
+
+        void retire(const member* replaced, size_t participant);
+        void lowerGate();
+
+        vector<unique_ptr<atomic<const member*>>> slots;
+        vector<unique_ptr<participantState>> participants;
+        atomic<uint64_t> globalEpoch;
+        atomic<double> gate;
+        atomic<size_t> memberCount;
+    };
+
+    // Walks from the solution 'from' towards the guiding solution 'to' one move at a time, each move taking a
+    // customer out of its route and placing it after the customer that precedes it in 'to', so that every move
+    // adds an edge of 'to'. Of the moves available at each step, the one that leaves the least total overload is
+    // made, and of those, the cheapest. Writes the cheapest feasible solution met strictly between the two ends
+    // to 'result' and returns true, or returns false if there was none. At most 'maxSteps' moves are made, or one
+    // per node if it is 0.
+    bool pathRelink(const compactSolution& from, const compactSolution& to, uint16_t vehicleCapacity,
+                    compactSolution& result, size_t maxSteps = 0);
+
+}
@@ -0,0 +1,118 @@
+#include "generator.h"
+#include <random>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    // Draws integers from mt19937, whose output sequence is fixed by the standard, avoiding the
+    // implementation-defined standard distributions
+    class generatorRandom{
+    public:
+        generatorRandom(uint32_t seed)
+            : engine(seed) {}
+        // Returns an integer from 0 to bound - 1
+        int below(int bound){
+            // Rejection sampling removes the bias of a plain modulo
+            uint32_t limit = UINT32_MAX - UINT32_MAX % static_cast<uint32_t>(bound);
+            uint32_t value;
+            do value = engine(); while (value >= limit);
+            return static_cast<int>(value % static_cast<uint32_t>(bound));
+        }
+    private:
+        mt19937 engine;
+    };
+
+}
+
+string cvrp::instanceTypeName(instanceType type){
+    switch (type){
+    case uniformInstance: return "uniform";
+    case clusteredInstance: return "clustered";
+    case depotCornerInstance: return "depotcorner";
+    }
+    return "unknown";
+}
+
+problemParameters cvrp::generateProblem(instanceType type, size_t customers, uint32_t seed, size_t customersPerRoute){
+    if (customers == 0 || customers >= UINT16_MAX) throw invalid_argument("Generated instances need 1 to 65534 customers.");
+    generatorRandom random(seed);
+    problemParameters problem;
+    problem.name = instanceTypeName(type) + "-" + to_string(customers);
+    problem.dimension = static_cast<int>(customers + 1);
+    node depot;
+    depot.num = 1;
+    depot.demand = 0;
+    depot.x = depot.y = type == depotCornerInstance ? 0.0f : generatedGridSize / 2.0f;
+    problem.nodes.push_back(depot);
+
+    // Cluster centres, for clustered instances; customers are placed around them with an offset in each axis
+    // that is the sum of three uniform values, which falls off roughly like a normal distribution
+    vector<pair<int, int>> centres;
+    if (type == clusteredInstance){
+        size_t centreCount = max<size_t>(3, customers / 100);
+        for (size_t c = 0; c < centreCount; c++){
+            centres.push_back(make_pair(random.below(generatedGridSize + 1), random.below(generatedGridSize + 1)));
+        }
+    }
+    const int spread = generatedGridSize / 50;
+    long long totalDemand = 0;
+    for (size_t i = 0; i < customers; i++){
+        node customer;
+        customer.num = static_cast<uint16_t>(i + 2);
+        int x, y;
+        if (type == clusteredInstance){
+            const pair<int, int>& centre = centres[random.below(static_cast<int>(centres.size()))];
+            x = centre.first, y = centre.second;
+            for (int k = 0; k < 3; k++){
+                x += random.below(2*spread + 1) - spread;
+                y += random.below(2*spread + 1) - spread;
+            }
+            x = min(max(x, 0), generatedGridSize);
+            y = min(max(y, 0), generatedGridSize);
+        }
+        else{
+            x = random.below(generatedGridSize + 1);
+            y = random.below(generatedGridSize + 1);
+        }
+        customer.x = static_cast<float>(x);
+        customer.y = static_cast<float>(y);
+        customer.demand = static_cast<uint16_t>(1 + random.below(100));
+        totalDemand += customer.demand;
+        problem.nodes.push_back(customer);
+    }
+    size_t routes = max<size_t>(1, customers / max<size_t>(1, customersPerRoute));
+    problem.capacity = static_cast<int>(max<long long>(100, (totalDemand + routes - 1) / routes));
+    if (problem.capacity > UINT16_MAX) throw invalid_argument("Generated capacity is too large; use shorter routes.");
+    return problem;
+}
+
+void cvrp::writeProblem(ostream& out, const problemParameters& problem){
+    size_t n = problem.nodes.size();
+    out << "NAME : " << problem.name << '\n'
+        << "TYPE : CVRP\n"
+        << "DIMENSION : " << n << '\n'
+        << "CAPACITY : " << problem.capacity << '\n';
+    if (problem.vehicles > 0) out << "VEHICLES : " << problem.vehicles << '\n';
+    out << setprecision(17);
+    if (problem.edgeWeights.empty()){
+        out << "EDGE_WEIGHT_TYPE : EUC_2D\n";
+    }
+    else{
+        out << "EDGE_WEIGHT_TYPE : EXPLICIT\n"
+            << "EDGE_WEIGHT_FORMAT : FULL_MATRIX\n"
+            << "EDGE_WEIGHT_SECTION\n";
+        for (size_t i = 0; i < n; i++){
+            for (size_t j = 0; j < n; j++) out << (j ? " " : "") << problem.edgeWeights[i*n + j];
+            out << '\n';
+        }
+    }
+    out << (problem.edgeWeights.empty() ? "NODE_COORD_SECTION\n" : "DISPLAY_DATA_SECTION\n");
+    for (const node& v : problem.nodes) out << v.num << ' ' << v.x << ' ' << v.y << '\n';
+    out << "DEMAND_SECTION\n";
+    for (const node& v : problem.nodes) out << v.num << ' ' << v.demand << '\n';
+    out << "DEPOT_SECTION\n1\n-1\nEOF\n";
+}
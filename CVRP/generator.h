@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <stdint.h>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Layouts of generated instances
+    enum instanceType{
+        // Customers spread uniformly over the square, with the depot at its centre
+        uniformInstance,
+        // Customers gathered around randomly placed centres, with the depot at the centre of the square
+        clusteredInstance,
+        // Customers spread uniformly over the square, with the depot in a corner
+        depotCornerInstance
+    };
+
+    // Side of the square that generated coordinates lie in
+    const int generatedGridSize = 10000;
+
+    // Returns the name of an instance type, as used in generated instance names
+    string instanceTypeName(instanceType type);
+
+    // Generates a problem with the given number of customers, integer coordinates and demands from 1 to 100.
+    // The capacity is set so that routes hold 'customersPerRoute' customers on average. The instance depends only
+    // on the arguments, and not on the platform or standard library, so a suite can be regenerated anywhere.
+    problemParameters generateProblem(instanceType type, size_t customers, uint32_t seed,
+                                      size_t customersPerRoute = 20);
+
+    // Writes a problem in TSPLIB/CVRPLIB format, with explicit FULL_MATRIX weights if it has edge weights
+    void writeProblem(ostream& out, const problemParameters& problem);
+
+}
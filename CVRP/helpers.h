@@ -23,11 +23,11 @@ template<typename T>
 inline typename vector<T>::iterator randomElement(vector<T>& vec, default_random_engine& rng)
 {
     uniform_int_distribution<size_t> eltSelect(0, vec.size()-1);
-    vector<T>::iterator eltIt = vec.begin() + eltSelect(rng);
+    typename vector<T>::iterator eltIt = vec.begin() + eltSelect(rng);
     return eltIt;
 }
 
-bool cycleAdjacent(size_t vecSize, size_t i, size_t j){
+inline bool cycleAdjacent(size_t vecSize, size_t i, size_t j){
     size_t min;
     size_t max;
     if (i < j){
@@ -45,13 +45,13 @@ bool cycleAdjacent(size_t vecSize, size_t i, size_t j){
 }
 
 inline size_t cycleNext(size_t vecSize, size_t i){
-    return i + 1 % vecSize;
+    return (i + 1) % vecSize;
 }
 inline size_t cyclePrev(size_t vecSize, size_t i){
     return i == 0 ? vecSize - 1 : i - 1;
 }
 
-bool cycleBetween(size_t vecSize, size_t elt, size_t first, size_t last){
+inline bool cycleBetween(size_t vecSize, size_t elt, size_t first, size_t last){
     size_t next = elt;
     while (next != first && next != last) next = cycleNext(vecSize, next);
     return next == last;
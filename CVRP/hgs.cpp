@@ -0,0 +1,335 @@
+#include "hgs.h"
+#include "savings.h"
+#include "parallel.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+using namespace cvrp;
+
+void hgs::split(const uint16_t* tour, size_t count, uint16_t vehicleCapacity, compactSolution& result,
+                splitWorkspace& workspace){
+    const vector<node>& nodes = result.problemNodes();
+    const distanceCache& distances = result.problemDistances();
+    // Positions are 1-based: 'load' and 'distance' are prefix sums over the first k customers of the tour, so
+    // that the route serving customers i + 1 to j costs
+    //   distances(0, tour[i]) + distance[j] - distance[i + 1] + distances(tour[j - 1], 0)
+    // and the best split ending with that route costs entry[i] + distance[j] + distances(tour[j - 1], 0)
+    vector<int>& load = workspace.load;
+    vector<double>& distance = workspace.distance;
+    vector<double>& potential = workspace.potential;
+    vector<double>& entry = workspace.entry;
+    vector<size_t>& predecessor = workspace.predecessor;
+    vector<size_t>& queue = workspace.queue;
+    load.assign(count + 1, 0);
+    distance.assign(count + 1, 0);
+    potential.assign(count + 1, 0);
+    entry.assign(count + 1, 0);
+    predecessor.assign(count + 1, 0);
+    queue.resize(count + 1);
+    for (size_t k = 1; k <= count; k++){
+        uint16_t demand = nodes[tour[k - 1]].demand;
+        if (demand > vehicleCapacity) throw invalid_argument("A customer's demand exceeds the vehicle capacity.");
+        load[k] = load[k - 1] + demand;
+        distance[k] = k == 1 ? 0 : distance[k - 1] + distances(tour[k - 2], tour[k - 1]);
+    }
+    if (count == 0) return;
+    // The queue holds the route starts that can still reach the current customer, in order of position and of
+    // increasing entry cost, so its front is the best start. A start is dropped from the back as soon as a
+    // later start is as cheap, since the later one stays within capacity for longer.
+    size_t front = 0, back = 0;
+    entry[0] = distances(0, tour[0]) - distance[1];
+    queue[back++] = 0;
+    for (size_t j = 1; j <= count; j++){
+        while (load[j] - load[queue[front]] > vehicleCapacity) front++;
+        predecessor[j] = queue[front];
+        potential[j] = entry[queue[front]] + distance[j] + distances(tour[j - 1], 0);
+        if (j < count){
+            entry[j] = potential[j] + distances(0, tour[j]) - distance[j + 1];
+            while (back > front && entry[queue[back - 1]] >= entry[j]) back--;
+            queue[back++] = j;
+        }
+    }
+    // Follow the predecessors back from the end, then add the routes in tour order
+    vector<size_t> ends;
+    for (size_t j = count; j > 0; j = predecessor[j]) ends.push_back(j);
+    size_t start = 0;
+    for (auto end = ends.rbegin(); end != ends.rend(); ++end){
+        result.appendRoute(tour + start, *end - start);
+        start = *end;
+    }
+}
+
+void hgs::orderCrossover(const vector<uint16_t>& a, const vector<uint16_t>& b, default_random_engine& rng,
+                         vector<uint16_t>& child){
+    size_t n = a.size();
+    if (n < 2){
+        child = a;
+        return;
+    }
+    child.assign(n, 0);
+    uniform_int_distribution<size_t> position(0, n - 1);
+    size_t start = position(rng), end = position(rng);
+    while (end == start) end = position(rng);
+    vector<bool> copied(*max_element(a.begin(), a.end()) + 1, false);
+    for (size_t i = start;; i = (i + 1) % n){
+        child[i] = a[i];
+        copied[a[i]] = true;
+        if (i == end) break;
+    }
+    size_t fill = (end + 1) % n;
+    for (size_t k = 1; k <= n; k++){
+        uint16_t v = b[(end + k) % n];
+        if (v >= copied.size() || !copied[v]){
+            child[fill] = v;
+            fill = (fill + 1) % n;
+        }
+    }
+}
+
+double hgs::brokenPairsDistance(const compactSolution& a, const compactSolution& b){
+    size_t nodeCount = a.problemNodes().size();
+    if (nodeCount < 2) return 0;
+    size_t broken = 0;
+    for (size_t v = 1; v < nodeCount; v++){
+        size_t next = a.next(v), previous = a.previous(v);
+        if (next != b.next(v) && next != b.previous(v)) broken++;
+        // An edge from the depot is also broken if v is in the middle of its route in b
+        if (previous == 0 && b.previous(v) != 0 && b.next(v) != 0) broken++;
+    }
+    return static_cast<double>(broken) / (nodeCount - 1);
+}
+
+solution hgs::solve(vector<node> nodes, uint16_t vehicleCapacity, const geneticOptions& options){
+    distanceCache distances(nodes);
+    return hgs::solve(nodes, vehicleCapacity, distances, options).toSolution();
+}
+
+namespace{
+
+    struct individual{
+        compactSolution routes;
+        vector<uint16_t> giantTour;
+        double cost;
+        double biasedFitness;
+        // Broken-pairs distances to the other members of the population, closest first
+        vector<pair<double, const individual*>> proximity;
+    };
+
+    // Scratch space of one worker
+    struct workerState{
+        hgs::splitWorkspace split;
+        local::workspace localSearch;
+    };
+
+    // Writes the customers of 'routes' into 'tour', taking the routes in order of the polar angle of their
+    // centroid around the depot so that routes near each other stay near each other in the tour
+    void writeGiantTour(const compactSolution& routes, vector<uint16_t>& tour){
+        vector<pair<double, size_t>> angles;
+        for (size_t r = 0; r < routes.routeCount(); r++) angles.push_back(make_pair(routes.centroidAngle(r), r));
+        sort(angles.begin(), angles.end());
+        tour.clear();
+        for (const auto& angle : angles){
+            tour.insert(tour.end(), routes.route(angle.second), routes.route(angle.second) + routes.routeLength(angle.second));
+        }
+    }
+
+    // Decodes the individual's giant tour with Split, improves the routes with local search, and writes the
+    // improved routes back into the giant tour
+    void educate(individual& child, const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                 size_t neighbours, workerState& worker){
+        child.routes = compactSolution(nodes, distances);
+        hgs::split(child.giantTour.data(), child.giantTour.size(), vehicleCapacity, child.routes, worker.split);
+        local::improve(child.routes, vehicleCapacity, worker.localSearch, neighbours);
+        child.routes.removeEmptyRoutes();
+        writeGiantTour(child.routes, child.giantTour);
+        child.cost = child.routes.cost();
+    }
+
+    // Individuals ordered by cost, with the broken-pairs distances between every pair of them
+    class population{
+    public:
+        explicit population(const hgs::geneticOptions& options)
+            : options(options) {}
+
+        size_t size() const { return members.size(); }
+        void clear() { members.clear(); }
+
+        // Adds an individual, choosing survivors once the population has grown by a generation
+        void add(unique_ptr<individual> added){
+            for (auto& member : members){
+                double distance = hgs::brokenPairsDistance(added->routes, member->routes);
+                insertProximity(*member, distance, added.get());
+                insertProximity(*added, distance, member.get());
+            }
+            auto position = upper_bound(members.begin(), members.end(), added->cost,
+                                        [](double cost, const unique_ptr<individual>& member){ return cost < member->cost; });
+            members.insert(position, move(added));
+            if (members.size() >= options.populationSize + options.generationSize){
+                while (members.size() > options.populationSize) removeWorst();
+            }
+        }
+
+        // Ranks every individual by cost and by its average distance to its closest individuals, and combines
+        // the ranks into its biased fitness, lower being better
+        void updateFitness(){
+            size_t n = members.size();
+            if (n == 1) members[0]->biasedFitness = 0;
+            if (n <= 1) return;
+            vector<pair<double, size_t>> diversity;
+            for (size_t i = 0; i < n; i++) diversity.push_back(make_pair(-averageDistance(*members[i]), i));
+            sort(diversity.begin(), diversity.end());
+            double diversityWeight = n > options.eliteCount ? 1.0 - static_cast<double>(options.eliteCount) / n : 0;
+            for (size_t rank = 0; rank < n; rank++){
+                size_t i = diversity[rank].second;
+                members[i]->biasedFitness = (static_cast<double>(i) + diversityWeight * rank) / (n - 1);
+            }
+        }
+
+        // Returns the fitter of two random individuals, by the fitness of the last updateFitness()
+        const individual& tournament(default_random_engine& rng) const{
+            uniform_int_distribution<size_t> pick(0, members.size() - 1);
+            const individual& a = *members[pick(rng)];
+            const individual& b = *members[pick(rng)];
+            return b.biasedFitness < a.biasedFitness ? b : a;
+        }
+
+    private:
+        static void insertProximity(individual& member, double distance, const individual* other){
+            auto entry = make_pair(distance, other);
+            member.proximity.insert(upper_bound(member.proximity.begin(), member.proximity.end(), entry,
+                                                [](const pair<double, const individual*>& a, const pair<double, const individual*>& b){
+                                                    return a.first < b.first;
+                                                }), entry);
+        }
+
+        double averageDistance(const individual& member) const{
+            size_t close = min(options.closeCount, member.proximity.size());
+            if (close == 0) return 0;
+            double total = 0;
+            for (size_t k = 0; k < close; k++) total += member.proximity[k].first;
+            return total / close;
+        }
+
+        // Removes the least fit individual other than the cheapest, preferring clones of other individuals
+        void removeWorst(){
+            updateFitness();
+            size_t worst = 1;
+            bool worstIsClone = false;
+            for (size_t i = 1; i < members.size(); i++){
+                bool isClone = !members[i]->proximity.empty() && members[i]->proximity.front().first < local::improvementEpsilon;
+                if ((isClone && !worstIsClone) ||
+                    (isClone == worstIsClone && members[i]->biasedFitness > members[worst]->biasedFitness)){
+                    worst = i;
+                    worstIsClone = isClone;
+                }
+            }
+            const individual* removed = members[worst].get();
+            for (auto& member : members){
+                auto& proximity = member->proximity;
+                proximity.erase(remove_if(proximity.begin(), proximity.end(),
+                                          [removed](const pair<double, const individual*>& entry){ return entry.second == removed; }),
+                                proximity.end());
+            }
+            members.erase(members.begin() + worst);
+        }
+
+        const hgs::geneticOptions& options;
+        vector<unique_ptr<individual>> members;
+    };
+
+}
+
+// Offspring are bred in rounds of one per worker. Each is bred with its own random engine, seeded from the
+// base seed and the offspring's number, from the population as it was at the start of the round, and the
+// round's offspring join the population in order of their number once all of them are educated; the search
+// therefore follows the same course however the workers are scheduled.
+compactSolution hgs::solve(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                           const geneticOptions& options, const tabu::searchControl& control){
+    CVRP_SCOPE("hgs");
+    compactSolution best(nodes, distances);
+    if (nodes.size() < 2) return best;
+    double bestCost = numeric_limits<double>::max();
+    threadPool pool(options.threads);
+    vector<workerState> workers(pool.size());
+    population members(options);
+    size_t offspring = 0;
+    size_t lastImprovement = 0;
+    size_t restarts = 0;
+    // Only a feasible candidate can become the best solution, although Split and local search should never give
+    // any other
+    auto offer = [&](const individual& candidate){
+        if (candidate.cost >= bestCost - local::improvementEpsilon) return;
+        if (!candidate.routes.isFeasible(vehicleCapacity)) return;
+        best = candidate.routes;
+        bestCost = candidate.cost;
+        lastImprovement = offspring;
+        if (control.improved) control.improved(best, bestCost, offspring);
+    };
+    auto finished = [&]{
+        if (control.stop && control.stop->load(memory_order_relaxed)) return true;
+        if (control.hasDeadline && chrono::steady_clock::now() >= control.deadline) return true;
+        if (control.iterationLimit && offspring >= control.iterationLimit) return true;
+        return !control.hasDeadline && offspring - lastImprovement >= options.restartIterations;
+    };
+
+    // The Clarke-Wright solution seeds the first population
+    unique_ptr<individual> start(new individual);
+    start->routes = clarkeWrightRoutes(nodes, vehicleCapacity, distances, control.savingsNeighbours);
+    local::improve(start->routes, vehicleCapacity, workers[0].localSearch, options.neighbours);
+    start->routes.removeEmptyRoutes();
+    writeGiantTour(start->routes, start->giantTour);
+    start->cost = start->routes.cost();
+    offer(*start);
+    members.add(move(start));
+
+    vector<uint16_t> customers;
+    for (size_t v = 1; v < nodes.size(); v++) customers.push_back(static_cast<uint16_t>(v));
+    // A new population starts from this many random giant tours
+    size_t randomRemaining = 4 * options.populationSize;
+    vector<unique_ptr<individual>> bred(pool.size());
+    while (!finished()){
+        bool random = randomRemaining > 0;
+        size_t round = random ? min(pool.size(), randomRemaining) : pool.size();
+        if (!random) members.updateFitness();
+        for (size_t k = 0; k < round; k++){
+            pool.submit([&, k, random](size_t worker){
+                seed_seq seeds{ options.seed, static_cast<unsigned>(offspring + k) };
+                default_random_engine rng(seeds);
+                unique_ptr<individual> child(new individual);
+                if (random){
+                    child->giantTour = customers;
+                    shuffle(child->giantTour.begin(), child->giantTour.end(), rng);
+                }
+                else{
+                    const individual& a = members.tournament(rng);
+                    const individual& b = members.tournament(rng);
+                    hgs::orderCrossover(a.giantTour, b.giantTour, rng, child->giantTour);
+                }
+                educate(*child, nodes, vehicleCapacity, distances, options.neighbours, workers[worker]);
+                bred[k] = move(child);
+            });
+        }
+        pool.wait();
+        for (size_t k = 0; k < round; k++){
+            offspring++;
+            offer(*bred[k]);
+            members.add(move(bred[k]));
+        }
+        if (random) randomRemaining -= round;
+        // Start again from random tours once the population has stopped improving, keeping only the best
+        // solution found
+        if (control.hasDeadline && offspring - lastImprovement >= options.restartIterations){
+            members.clear();
+            randomRemaining = 4 * options.populationSize;
+            lastImprovement = offspring;
+            restarts++;
+        }
+    }
+    CVRP_COUNT(geneticOffspring, offspring);
+    CVRP_COUNT(populationRestarts, restarts);
+    return best;
+}
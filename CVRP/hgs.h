@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include <stdint.h>
+#include "cvrp.h"
+#include "distances.h"
+#include "routes.h"
+#include "localsearch.h"
+#include "tabu.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Hybrid genetic search (after Vidal's HGS-CVRP). Individuals are giant tours, orders of every customer
+    // without route boundaries, decoded into the best routes for that order by Split. Each generation breeds
+    // offspring from pairs of parents by order crossover, decodes them, and educates them with local search;
+    // the routes found by local search are written back into the offspring's giant tour. Survivors are chosen
+    // by a biased fitness that ranks each individual both by cost and by its broken-pairs distance to its
+    // closest neighbours in the population, so that the population keeps diverse solutions instead of
+    // converging on one. The population restarts from random tours once the best solution has not improved
+    // for a while.
+    // Only solutions that respect the vehicle capacity are kept, as Split and local search never overload a
+    // route.
+    namespace hgs{
+
+        // Number of individuals that survive each generation, and number of offspring bred before survivors
+        // are chosen again
+        const size_t defaultPopulationSize = 25;
+        const size_t defaultGenerationSize = 40;
+        // Number of the cheapest individuals whose diversity barely counts towards their fitness
+        const size_t defaultEliteCount = 4;
+        // Number of closest individuals over which an individual's broken-pairs distance is averaged
+        const size_t defaultCloseCount = 5;
+        // Number of offspring without a new best solution after which the population restarts
+        const size_t defaultRestartIterations = 5000;
+
+        struct geneticOptions{
+            geneticOptions()
+                : populationSize(defaultPopulationSize), generationSize(defaultGenerationSize),
+                  eliteCount(defaultEliteCount), closeCount(defaultCloseCount),
+                  restartIterations(defaultRestartIterations), neighbours(local::defaultNeighbours),
+                  threads(0), seed(0) {}
+            size_t populationSize;
+            size_t generationSize;
+            size_t eliteCount;
+            size_t closeCount;
+            // Once this many offspring have not improved on the best solution the population restarts if the
+            // search has a deadline, and the search ends otherwise
+            size_t restartIterations;
+            // Number of nearest neighbours used by local search when educating offspring
+            size_t neighbours;
+            // Number of worker threads breeding and educating offspring, or 0 for one per hardware thread;
+            // each worker breeds one offspring per round
+            size_t threads;
+            unsigned seed;
+        };
+
+        // Scratch buffers for Split
+        struct splitWorkspace{
+            vector<int> load;
+            vector<double> distance;
+            vector<double> potential;
+            vector<double> entry;
+            vector<size_t> predecessor;
+            vector<size_t> queue;
+        };
+
+        // Splits the giant tour of 'count' customers into the routes of least total cost that visit them in
+        // that order without exceeding the vehicle capacity, and appends them to 'result'. Runs in O(count) by
+        // keeping the candidate route starts in a queue ordered by cost (Vidal's linear Split). Throws
+        // invalid_argument if a customer's demand exceeds the capacity.
+        void split(const uint16_t* tour, size_t count, uint16_t vehicleCapacity, compactSolution& result,
+                   splitWorkspace& workspace);
+
+        // Writes the order crossover (OX) of the giant tours a and b to 'child': a random cyclic section of a
+        // is copied in place, and the remaining customers follow in the order they appear in b after the end
+        // of the section
+        void orderCrossover(const vector<uint16_t>& a, const vector<uint16_t>& b, default_random_engine& rng,
+                            vector<uint16_t>& child);
+
+        // Returns the broken-pairs distance between two solutions of the same problem: the fraction of
+        // customers whose neighbours in a are not their neighbours in b
+        double brokenPairsDistance(const compactSolution& a, const compactSolution& b);
+
+        // Runs the hybrid genetic search and returns the best solution found. The stop flag, deadline and
+        // improvement callback of 'control' are honoured and its iteration limit, if nonzero, bounds the
+        // number of offspring. The result depends only on the options and not on thread scheduling, unless the
+        // deadline or stop flag ends the search.
+        compactSolution solve(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                              const geneticOptions& options = geneticOptions(),
+                              const tabu::searchControl& control = tabu::searchControl());
+        solution solve(vector<node> nodes, uint16_t vehicleCapacity, const geneticOptions& options = geneticOptions());
+
+    }
+
+}
@@ -0,0 +1,270 @@
+#include "kernels.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CVRP_X86_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions explicitly marked for it, which lets the AVX2
+// kernels live alongside the baseline ones without compiling the whole program for AVX2
+#if defined(__GNUC__)
+#define CVRP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CVRP_TARGET_AVX2
+#endif
+
+using namespace std;
+using namespace cvrp;
+
+nodeArrays::nodeArrays(const vector<node>& nodes)
+    : x(nodes.size()), y(nodes.size()), demand(nodes.size()){
+    for (const auto& n : nodes){
+        x[n.num - 1] = n.x;
+        y[n.num - 1] = n.y;
+        demand[n.num - 1] = n.demand;
+    }
+}
+
+namespace{
+
+    struct kernelTable{
+        void (*distancesFrom)(const nodeArrays&, size_t, size_t, size_t, double*);
+        void (*distancesTo)(const nodeArrays&, size_t, const uint16_t*, size_t, double*);
+        double (*routeCost)(const nodeArrays&, const uint16_t*, size_t);
+        void (*insertionCosts)(const nodeArrays&, size_t, const uint16_t*, size_t, double*);
+        void (*savingsRow)(const double*, double, const double*, size_t, double*);
+        const char* name;
+    };
+
+    inline double pairDistance(const nodeArrays& nodes, size_t a, size_t b){
+        double dx = nodes.x[a] - nodes.x[b];
+        double dy = nodes.y[a] - nodes.y[b];
+        return sqrt(dx*dx + dy*dy);
+    }
+
+    /////////
+    // Scalar kernels, also used for the remainder of each vectorised loop
+
+    void distancesFromScalar(const nodeArrays& nodes, size_t from, size_t begin, size_t end, double* out){
+        for (size_t i = begin; i < end; i++) out[i - begin] = pairDistance(nodes, from, i);
+    }
+    void distancesToScalar(const nodeArrays& nodes, size_t from, const uint16_t* indices, size_t count, double* out){
+        for (size_t i = 0; i < count; i++) out[i] = pairDistance(nodes, from, indices[i]);
+    }
+    double routeCostScalar(const nodeArrays& nodes, const uint16_t* route, size_t length){
+        double totalCost = 0;
+        for (size_t i = 0; i + 1 < length; i++) totalCost += pairDistance(nodes, route[i], route[i+1]);
+        if (length > 1) totalCost += pairDistance(nodes, route[length-1], route[0]);
+        return totalCost;
+    }
+    void insertionCostsScalar(const nodeArrays& nodes, size_t v, const uint16_t* route, size_t length, double* out){
+        for (size_t p = 0; p < length; p++){
+            size_t a = route[p];
+            size_t b = route[p + 1 < length ? p + 1 : 0];
+            out[p] = pairDistance(nodes, a, v) + pairDistance(nodes, v, b) - pairDistance(nodes, a, b);
+        }
+    }
+    void savingsRowScalar(const double* depotRow, double depotDistance, const double* row, size_t count, double* out){
+        for (size_t i = 0; i < count; i++) out[i] = depotRow[i] + depotDistance - row[i];
+    }
+
+#ifdef CVRP_X86_KERNELS
+
+    /////////
+    // SSE2 kernels, two distances at a time
+
+    inline __m128d distance2(__m128d dx, __m128d dy){
+        return _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+    }
+
+    void distancesFromSSE2(const nodeArrays& nodes, size_t from, size_t begin, size_t end, double* out){
+        __m128d fx = _mm_set1_pd(nodes.x[from]);
+        __m128d fy = _mm_set1_pd(nodes.y[from]);
+        size_t i = begin;
+        for (; i + 2 <= end; i += 2){
+            __m128d dx = _mm_sub_pd(fx, _mm_loadu_pd(&nodes.x[i]));
+            __m128d dy = _mm_sub_pd(fy, _mm_loadu_pd(&nodes.y[i]));
+            _mm_storeu_pd(out + (i - begin), distance2(dx, dy));
+        }
+        distancesFromScalar(nodes, from, i, end, out + (i - begin));
+    }
+    void distancesToSSE2(const nodeArrays& nodes, size_t from, const uint16_t* indices, size_t count, double* out){
+        __m128d fx = _mm_set1_pd(nodes.x[from]);
+        __m128d fy = _mm_set1_pd(nodes.y[from]);
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2){
+            __m128d dx = _mm_sub_pd(fx, _mm_set_pd(nodes.x[indices[i+1]], nodes.x[indices[i]]));
+            __m128d dy = _mm_sub_pd(fy, _mm_set_pd(nodes.y[indices[i+1]], nodes.y[indices[i]]));
+            _mm_storeu_pd(out + i, distance2(dx, dy));
+        }
+        distancesToScalar(nodes, from, indices + i, count - i, out + i);
+    }
+    double routeCostSSE2(const nodeArrays& nodes, const uint16_t* route, size_t length){
+        if (length < 3) return routeCostScalar(nodes, route, length);
+        __m128d sum = _mm_setzero_pd();
+        size_t i = 0;
+        for (; i + 3 <= length; i += 2){
+            __m128d dx = _mm_sub_pd(_mm_set_pd(nodes.x[route[i+1]], nodes.x[route[i]]),
+                                    _mm_set_pd(nodes.x[route[i+2]], nodes.x[route[i+1]]));
+            __m128d dy = _mm_sub_pd(_mm_set_pd(nodes.y[route[i+1]], nodes.y[route[i]]),
+                                    _mm_set_pd(nodes.y[route[i+2]], nodes.y[route[i+1]]));
+            sum = _mm_add_pd(sum, distance2(dx, dy));
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, sum);
+        double totalCost = lanes[0] + lanes[1];
+        for (; i + 1 < length; i++) totalCost += pairDistance(nodes, route[i], route[i+1]);
+        return totalCost + pairDistance(nodes, route[length-1], route[0]);
+    }
+
+    /////////
+    // AVX2 kernels, four distances at a time with gathered coordinates
+
+    CVRP_TARGET_AVX2 inline __m256d distance4(__m256d dx, __m256d dy){
+        return _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+    }
+    CVRP_TARGET_AVX2 inline __m128i loadIndices4(const uint16_t* indices){
+        return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(indices)));
+    }
+    // Masked form of the gather, as the unmasked intrinsic starts from an undefined register
+    CVRP_TARGET_AVX2 inline __m256d gather4(const double* base, __m128i indices){
+        __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, indices, all, 8);
+    }
+
+    CVRP_TARGET_AVX2 void distancesFromAVX2(const nodeArrays& nodes, size_t from, size_t begin, size_t end, double* out){
+        __m256d fx = _mm256_set1_pd(nodes.x[from]);
+        __m256d fy = _mm256_set1_pd(nodes.y[from]);
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4){
+            __m256d dx = _mm256_sub_pd(fx, _mm256_loadu_pd(&nodes.x[i]));
+            __m256d dy = _mm256_sub_pd(fy, _mm256_loadu_pd(&nodes.y[i]));
+            _mm256_storeu_pd(out + (i - begin), distance4(dx, dy));
+        }
+        distancesFromScalar(nodes, from, i, end, out + (i - begin));
+    }
+    CVRP_TARGET_AVX2 void distancesToAVX2(const nodeArrays& nodes, size_t from, const uint16_t* indices, size_t count, double* out){
+        __m256d fx = _mm256_set1_pd(nodes.x[from]);
+        __m256d fy = _mm256_set1_pd(nodes.y[from]);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4){
+            __m128i idx = loadIndices4(indices + i);
+            __m256d dx = _mm256_sub_pd(fx, gather4(nodes.x.data(), idx));
+            __m256d dy = _mm256_sub_pd(fy, gather4(nodes.y.data(), idx));
+            _mm256_storeu_pd(out + i, distance4(dx, dy));
+        }
+        distancesToScalar(nodes, from, indices + i, count - i, out + i);
+    }
+    CVRP_TARGET_AVX2 double routeCostAVX2(const nodeArrays& nodes, const uint16_t* route, size_t length){
+        if (length < 5) return routeCostScalar(nodes, route, length);
+        __m256d sum = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 5 <= length; i += 4){
+            __m128i from = loadIndices4(route + i);
+            __m128i to = loadIndices4(route + i + 1);
+            __m256d dx = _mm256_sub_pd(gather4(nodes.x.data(), from), gather4(nodes.x.data(), to));
+            __m256d dy = _mm256_sub_pd(gather4(nodes.y.data(), from), gather4(nodes.y.data(), to));
+            sum = _mm256_add_pd(sum, distance4(dx, dy));
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        double totalCost = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        for (; i + 1 < length; i++) totalCost += pairDistance(nodes, route[i], route[i+1]);
+        return totalCost + pairDistance(nodes, route[length-1], route[0]);
+    }
+    CVRP_TARGET_AVX2 void insertionCostsAVX2(const nodeArrays& nodes, size_t v, const uint16_t* route, size_t length, double* out){
+        __m256d vx = _mm256_set1_pd(nodes.x[v]);
+        __m256d vy = _mm256_set1_pd(nodes.y[v]);
+        size_t p = 0;
+        for (; p + 5 <= length; p += 4){
+            __m128i from = loadIndices4(route + p);
+            __m128i to = loadIndices4(route + p + 1);
+            __m256d ax = gather4(nodes.x.data(), from);
+            __m256d ay = gather4(nodes.y.data(), from);
+            __m256d bx = gather4(nodes.x.data(), to);
+            __m256d by = gather4(nodes.y.data(), to);
+            __m256d av = distance4(_mm256_sub_pd(ax, vx), _mm256_sub_pd(ay, vy));
+            __m256d vb = distance4(_mm256_sub_pd(vx, bx), _mm256_sub_pd(vy, by));
+            __m256d ab = distance4(_mm256_sub_pd(ax, bx), _mm256_sub_pd(ay, by));
+            _mm256_storeu_pd(out + p, _mm256_sub_pd(_mm256_add_pd(av, vb), ab));
+        }
+        for (; p < length; p++){
+            size_t a = route[p];
+            size_t b = route[p + 1 < length ? p + 1 : 0];
+            out[p] = pairDistance(nodes, a, v) + pairDistance(nodes, v, b) - pairDistance(nodes, a, b);
+        }
+    }
+    CVRP_TARGET_AVX2 void savingsRowAVX2(const double* depotRow, double depotDistance, const double* row, size_t count, double* out){
+        __m256d d = _mm256_set1_pd(depotDistance);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4){
+            __m256d s = _mm256_sub_pd(_mm256_add_pd(_mm256_loadu_pd(depotRow + i), d), _mm256_loadu_pd(row + i));
+            _mm256_storeu_pd(out + i, s);
+        }
+        savingsRowScalar(depotRow + i, depotDistance, row + i, count - i, out + i);
+    }
+
+    bool cpuSupportsAVX2(){
+#if defined(__GNUC__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        // The operating system must also save the AVX registers
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        return avx2 && osxsave && (_xgetbv(0) & 6) == 6;
+#else
+        return false;
+#endif
+    }
+
+#endif
+
+    kernelTable selectKernels(){
+#ifdef CVRP_X86_KERNELS
+        if (cpuSupportsAVX2()){
+            kernelTable avx2 = { distancesFromAVX2, distancesToAVX2, routeCostAVX2, insertionCostsAVX2, savingsRowAVX2, "avx2" };
+            return avx2;
+        }
+        kernelTable sse2 = { distancesFromSSE2, distancesToSSE2, routeCostSSE2, insertionCostsScalar, savingsRowScalar, "sse2" };
+        return sse2;
+#else
+        kernelTable scalar = { distancesFromScalar, distancesToScalar, routeCostScalar, insertionCostsScalar, savingsRowScalar, "scalar" };
+        return scalar;
+#endif
+    }
+
+    const kernelTable& activeKernels(){
+        static const kernelTable table = selectKernels();
+        return table;
+    }
+
+}
+
+void kernels::distancesFrom(const nodeArrays& nodes, size_t from, size_t begin, size_t end, double* out){
+    activeKernels().distancesFrom(nodes, from, begin, end, out);
+}
+void kernels::distancesTo(const nodeArrays& nodes, size_t from, const uint16_t* indices, size_t count, double* out){
+    activeKernels().distancesTo(nodes, from, indices, count, out);
+}
+double kernels::routeCost(const nodeArrays& nodes, const uint16_t* route, size_t length){
+    return activeKernels().routeCost(nodes, route, length);
+}
+void kernels::insertionCosts(const nodeArrays& nodes, size_t v, const uint16_t* route, size_t length, double* out){
+    activeKernels().insertionCosts(nodes, v, route, length, out);
+}
+void kernels::savingsRow(const double* depotRow, double depotDistance, const double* row, size_t count, double* out){
+    activeKernels().savingsRow(depotRow, depotDistance, row, count, out);
+}
+const char* kernels::instructionSet(){
+    return activeKernels().name;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Node coordinates and demands in structure-of-arrays layout, indexed by node index (num - 1)
+    struct nodeArrays{
+        nodeArrays() {}
+        explicit nodeArrays(const vector<node>& nodes);
+        size_t size() const { return x.size(); }
+        vector<double> x;
+        vector<double> y;
+        vector<uint16_t> demand;
+    };
+
+    // Vectorised distance kernels. Each kernel has AVX2, SSE2 and scalar implementations; the best one
+    // supported by the running CPU is selected the first time any kernel is called.
+    // Every distance is computed exactly as sqrt(dx*dx + dy*dy) in double precision, so results are
+    // identical whichever implementation is used, except for the summation order in routeCost.
+    namespace kernels{
+
+        // Writes the distances from node 'from' to each node in [begin, end) to out[0, end - begin)
+        void distancesFrom(const nodeArrays& nodes, size_t from, size_t begin, size_t end, double* out);
+
+        // Writes the distances from node 'from' to each of the 'count' nodes in 'indices' to out
+        void distancesTo(const nodeArrays& nodes, size_t from, const uint16_t* indices, size_t count, double* out);
+
+        // Returns the cost of the closed tour visiting the 'length' nodes in 'route' in order
+        double routeCost(const nodeArrays& nodes, const uint16_t* route, size_t length);
+
+        // Writes the cost of inserting node v after each position p of the closed tour 'route' to out[p],
+        // i.e. d(route[p], v) + d(v, route[p+1]) - d(route[p], route[p+1]), wrapping around at the end
+        void insertionCosts(const nodeArrays& nodes, size_t v, const uint16_t* route, size_t length, double* out);
+
+        // Writes the Clarke-Wright savings (depotRow[i] + depotDistance) - row[i] for i in [0, count) to out
+        void savingsRow(const double* depotRow, double depotDistance, const double* row, size_t count, double* out);
+
+        // Returns the name of the instruction set used by the kernels
+        const char* instructionSet();
+
+    }
+
+}
@@ -0,0 +1,236 @@
+#define CVRP_BUILDING_LIBRARY
+#include "libcvrp.h"
+#include "service.h"
+#include "parser.h"
+#include "snapshot.h"
+#include "distances.h"
+#include <mutex>
+#include <new>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+using namespace cvrp;
+
+// Visual C++ before 2015 only supports thread-local storage of plain data
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define CVRP_THREAD_LOCAL __declspec(thread)
+#else
+#define CVRP_THREAD_LOCAL thread_local
+#endif
+
+struct cvrp_problem{
+    vector<node> nodes;
+    uint16_t capacity;
+    shared_ptr<const distanceCache> distances;
+    // Scratch space kept for single-search solves, which use it one at a time
+    mutable mutex workspaceLock;
+    mutable tabu::searchWorkspace workspace;
+};
+
+struct cvrp_solution{
+    double cost;
+    // Customers of every route, route after route, and the offset of each route's first customer with a final
+    // entry for the end
+    vector<uint32_t> customers;
+    vector<size_t> routeStarts;
+};
+
+namespace{
+
+    CVRP_THREAD_LOCAL char lastError[256];
+
+    cvrp_status fail(cvrp_status status, const char* message){
+        strncpy(lastError, message, sizeof(lastError) - 1);
+        lastError[sizeof(lastError) - 1] = '\0';
+        return status;
+    }
+
+    // Calls f, turning the exceptions it throws into a status and error message; runtime errors are reported
+    // with 'runtimeStatus'
+    template<typename F>
+    cvrp_status guarded(F f, cvrp_status runtimeStatus = CVRP_FAILED){
+        try{
+            f();
+            return CVRP_OK;
+        }
+        catch (const bad_alloc&){
+            return fail(CVRP_OUT_OF_MEMORY, "Out of memory.");
+        }
+        catch (const logic_error& e){
+            return fail(CVRP_INVALID_ARGUMENT, e.what());
+        }
+        catch (const runtime_error& e){
+            return fail(runtimeStatus, e.what());
+        }
+        catch (const exception& e){
+            return fail(CVRP_FAILED, e.what());
+        }
+    }
+
+    solveOptions toSolveOptions(const cvrp_options& options){
+        // cvrp_options has only had its present layout so far; fields added later will be read only if
+        // struct_size covers them
+        if (options.struct_size != sizeof(cvrp_options)){
+            throw invalid_argument("Options were not set up by cvrp_options_init of this version of libcvrp.");
+        }
+        solveOptions result;
+        switch (options.algorithm){
+        case CVRP_ALGORITHM_TABU: result.algorithm = "tabu"; break;
+        case CVRP_ALGORITHM_HGS: result.algorithm = "hgs"; break;
+        case CVRP_ALGORITHM_DECOMPOSE: result.algorithm = "decompose"; break;
+        default: throw invalid_argument("Unknown algorithm.");
+        }
+        result.seed = options.seed;
+        result.threads = options.threads;
+        result.starts = max<size_t>(1, options.starts);
+        result.eliteSize = options.elite_size;
+        if (!(options.time_limit >= 0)) throw invalid_argument("Time limit must not be negative.");
+        result.timeLimit = options.time_limit;
+        result.iterationLimit = options.iteration_limit;
+        result.localSearch = options.local_search != 0;
+        result.routeOptimization = options.route_optimization != 0;
+        return result;
+    }
+
+}
+
+int cvrp_api_version(void){
+    return CVRP_API_VERSION;
+}
+
+const char* cvrp_last_error(void){
+    return lastError;
+}
+
+void cvrp_options_init(cvrp_options* options){
+    if (!options) return;
+    solveOptions defaults;
+    options->struct_size = sizeof(cvrp_options);
+    options->algorithm = CVRP_ALGORITHM_TABU;
+    options->seed = defaults.seed;
+    options->threads = defaults.threads;
+    options->starts = defaults.starts;
+    options->elite_size = defaults.eliteSize;
+    options->time_limit = defaults.timeLimit;
+    options->iteration_limit = defaults.iterationLimit;
+    options->local_search = defaults.localSearch;
+    options->route_optimization = defaults.routeOptimization;
+}
+
+cvrp_status cvrp_problem_create(size_t node_count, const double* x, const double* y, const int* demands,
+                                int capacity, const double* weights, cvrp_problem** problem){
+    if (!problem) return fail(CVRP_INVALID_ARGUMENT, "No problem pointer given.");
+    *problem = nullptr;
+    if (!x || !y || !demands) return fail(CVRP_INVALID_ARGUMENT, "Coordinates and demands are required.");
+    return guarded([&]{
+        unique_ptr<cvrp_problem> created(new cvrp_problem());
+        created->nodes.resize(node_count);
+        for (size_t i = 0; i < node_count; i++){
+            if (!(fabs(x[i]) <= maxCoordinate) || !(fabs(y[i]) <= maxCoordinate)){
+                throw invalid_argument("Coordinates must be finite and at most 2^24 in magnitude.");
+            }
+            int demand = i == 0 ? 0 : demands[i];
+            if (demand < 0 || demand > UINT16_MAX) throw invalid_argument("Demands are out of range.");
+            node& n = created->nodes[i];
+            n.num = static_cast<uint16_t>(i + 1);
+            n.demand = static_cast<uint16_t>(demand);
+            n.x = static_cast<float>(x[i]);
+            n.y = static_cast<float>(y[i]);
+        }
+        validateProblem(created->nodes, capacity);
+        vector<double> matrix;
+        if (weights){
+            matrix.assign(weights, weights + node_count * node_count);
+            for (size_t i = 0; i < node_count; i++){
+                for (size_t j = 0; j < node_count; j++){
+                    double w = matrix[i * node_count + j];
+                    if (!(w >= 0) || std::isinf(w)) throw invalid_argument("Weights must be finite and not negative.");
+                    if (w != matrix[j * node_count + i]) throw invalid_argument("Weights must be symmetric.");
+                }
+            }
+        }
+        created->capacity = static_cast<uint16_t>(capacity);
+        created->distances = make_shared<distanceCache>(created->nodes, matrix);
+        *problem = created.release();
+    });
+}
+
+cvrp_status cvrp_problem_load(const char* filename, cvrp_problem** problem){
+    if (!problem) return fail(CVRP_INVALID_ARGUMENT, "No problem pointer given.");
+    *problem = nullptr;
+    if (!filename) return fail(CVRP_INVALID_ARGUMENT, "No filename given.");
+    return guarded([&]{
+        unique_ptr<cvrp_problem> created(new cvrp_problem());
+        if (isSnapshotFile(filename)){
+            snapshot loaded = loadSnapshot(filename);
+            validateProblem(loaded.problem.nodes, loaded.problem.capacity);
+            created->nodes = loaded.problem.nodes;
+            created->capacity = static_cast<uint16_t>(loaded.problem.capacity);
+            created->distances.reset(loaded.distances.release());
+        }
+        else{
+            problemParameters loaded = loadProblem(filename);
+            validateProblem(loaded.nodes, loaded.capacity);
+            created->nodes = loaded.nodes;
+            created->capacity = static_cast<uint16_t>(loaded.capacity);
+            created->distances = make_shared<distanceCache>(loaded);
+        }
+        *problem = created.release();
+    }, CVRP_IO_ERROR);
+}
+
+void cvrp_problem_free(cvrp_problem* problem){
+    delete problem;
+}
+
+size_t cvrp_problem_node_count(const cvrp_problem* problem){
+    return problem ? problem->nodes.size() : 0;
+}
+
+cvrp_status cvrp_solve(const cvrp_problem* problem, const cvrp_options* options, cvrp_solution** solution){
+    if (!solution) return fail(CVRP_INVALID_ARGUMENT, "No solution pointer given.");
+    *solution = nullptr;
+    if (!problem) return fail(CVRP_INVALID_ARGUMENT, "No problem given.");
+    return guarded([&]{
+        cvrp_options defaults;
+        cvrp_options_init(&defaults);
+        solveOptions settings = toSolveOptions(options ? *options : defaults);
+        // The workspace is only borrowed when no other solve of the problem holds it
+        unique_lock<mutex> workspace(problem->workspaceLock, try_to_lock);
+        compactSolution solved = solveProblem(problem->nodes, problem->capacity, *problem->distances, settings,
+                                              workspace.owns_lock() ? &problem->workspace : nullptr);
+        if (workspace.owns_lock()) workspace.unlock();
+        solved.removeEmptyRoutes();
+        unique_ptr<cvrp_solution> result(new cvrp_solution());
+        result->cost = solved.reportedCost();
+        result->routeStarts.push_back(0);
+        for (size_t r = 0; r < solved.routeCount(); r++){
+            result->customers.insert(result->customers.end(), solved.route(r), solved.route(r) + solved.routeLength(r));
+            result->routeStarts.push_back(result->customers.size());
+        }
+        *solution = result.release();
+    });
+}
+
+void cvrp_solution_free(cvrp_solution* solution){
+    delete solution;
+}
+
+double cvrp_solution_cost(const cvrp_solution* solution){
+    return solution ? solution->cost : 0;
+}
+
+size_t cvrp_solution_route_count(const cvrp_solution* solution){
+    return solution ? solution->routeStarts.size() - 1 : 0;
+}
+
+size_t cvrp_solution_route(const cvrp_solution* solution, size_t r, const uint32_t** customers){
+    if (!solution || r + 1 >= solution->routeStarts.size()){
+        if (customers) *customers = nullptr;
+        return 0;
+    }
+    if (customers) *customers = solution->customers.data() + solution->routeStarts[r];
+    return solution->routeStarts[r + 1] - solution->routeStarts[r];
+}
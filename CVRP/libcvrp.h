@@ -0,0 +1,117 @@
+#pragma once
+
+/* C interface of libcvrp, the solver built as a library (make lib builds libcvrp.a and libcvrp.so).
+   Node 0 of a problem is the depot and nodes 1 to node_count - 1 are its customers; routes list the customers
+   they visit in order, without the depot at either end. Functions that can fail return a cvrp_status, and
+   cvrp_last_error() describes the last failure on the calling thread. Problems and solutions are opaque and
+   are released with their free functions; a problem may be solved by several threads at once. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(CVRP_SHARED)
+#ifdef CVRP_BUILDING_LIBRARY
+#define CVRP_API __declspec(dllexport)
+#else
+#define CVRP_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define CVRP_API __attribute__((visibility("default")))
+#else
+#define CVRP_API
+#endif
+
+/* Version of this interface, raised whenever a declaration below changes incompatibly */
+#define CVRP_API_VERSION 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum cvrp_status{
+    CVRP_OK = 0,
+    /* An argument, option or problem was invalid */
+    CVRP_INVALID_ARGUMENT = 1,
+    /* A file could not be read or parsed */
+    CVRP_IO_ERROR = 2,
+    CVRP_OUT_OF_MEMORY = 3,
+    CVRP_FAILED = 4
+} cvrp_status;
+
+typedef enum cvrp_algorithm{
+    /* Taburoute's tabu search, or several in parallel if starts > 1 or elite_size > 0 */
+    CVRP_ALGORITHM_TABU = 0,
+    /* Hybrid genetic search */
+    CVRP_ALGORITHM_HGS = 1,
+    /* Route decomposition for very large problems */
+    CVRP_ALGORITHM_DECOMPOSE = 2
+} cvrp_algorithm;
+
+/* Options are set up with cvrp_options_init before any are changed. Later versions only add fields at the end,
+   and struct_size tells the library which fields the caller's header had, so that a program keeps working with
+   a newer library. */
+typedef struct cvrp_options{
+    /* sizeof(cvrp_options) as the caller was compiled, set by cvrp_options_init */
+    size_t struct_size;
+    cvrp_algorithm algorithm;
+    unsigned seed;
+    /* Number of worker threads, or 0 for one per hardware thread */
+    size_t threads;
+    /* Number of parallel tabu searches, and the size of the elite pool they share (0 for none) */
+    size_t starts;
+    size_t elite_size;
+    /* Seconds after which the best solution found so far is returned (0 for no limit) */
+    double time_limit;
+    /* Overrides the default iteration count of each search if nonzero */
+    size_t iteration_limit;
+    /* Nonzero to apply local search and intra-route 2-opt within the searches */
+    int local_search;
+    int route_optimization;
+} cvrp_options;
+
+typedef struct cvrp_problem cvrp_problem;
+typedef struct cvrp_solution cvrp_solution;
+
+/* Returns CVRP_API_VERSION as the library was built */
+CVRP_API int cvrp_api_version(void);
+
+/* Returns a description of the last failure on the calling thread, or an empty string */
+CVRP_API const char* cvrp_last_error(void);
+
+/* Sets the default options: a single seeded tabu search with local search and route optimisation */
+CVRP_API void cvrp_options_init(cvrp_options* options);
+
+/* Creates a problem from node_count nodes with coordinates x and y and integer demands (demands[0], the depot's,
+   is ignored), and the vehicle capacity. If weights is not null, it holds the node_count * node_count distances
+   between the nodes in row-major order, which must be symmetric, and replaces the euclidean distances. The
+   distances are computed once, when the problem is created. */
+CVRP_API cvrp_status cvrp_problem_create(size_t node_count, const double* x, const double* y, const int* demands,
+                                         int capacity, const double* weights, cvrp_problem** problem);
+
+/* Reads a problem from a TSPLIB/CVRPLIB file or a snapshot written by cvrpSolver --snapshot */
+CVRP_API cvrp_status cvrp_problem_load(const char* filename, cvrp_problem** problem);
+
+CVRP_API void cvrp_problem_free(cvrp_problem* problem);
+
+/* Returns the number of nodes of a problem, including the depot */
+CVRP_API size_t cvrp_problem_node_count(const cvrp_problem* problem);
+
+/* Solves a problem with the given options, or the defaults if options is null. Options whose struct_size is
+   not that of a cvrp_options this library knows are rejected with CVRP_INVALID_ARGUMENT. */
+CVRP_API cvrp_status cvrp_solve(const cvrp_problem* problem, const cvrp_options* options, cvrp_solution** solution);
+
+CVRP_API void cvrp_solution_free(cvrp_solution* solution);
+
+/* Returns the total cost of a solution */
+CVRP_API double cvrp_solution_cost(const cvrp_solution* solution);
+
+/* Returns the number of routes of a solution */
+CVRP_API size_t cvrp_solution_route_count(const cvrp_solution* solution);
+
+/* Returns the number of customers of route r and points 'customers' at them; the array lives as long as the
+   solution */
+CVRP_API size_t cvrp_solution_route(const cvrp_solution* solution, size_t r, const uint32_t** customers);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,132 @@
+/* Checks the C API of libcvrp from a C program: make lib-check builds it against libcvrp.a and libcvrp.so and
+   runs it on fruitybun250.vrp. Prints each failed check and exits with status 1 if there was any. */
+
+#include "libcvrp.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+static int failures = 0;
+
+static void check(int passed, const char* what){
+    if (passed) return;
+    printf("failed: %s (%s)\n", what, cvrp_last_error());
+    failures++;
+}
+
+/* A solve run on a thread of its own, sharing the problem with the other solves */
+typedef struct concurrentSolve{
+    const cvrp_problem* problem;
+    cvrp_options options;
+    cvrp_status status;
+    double cost;
+} concurrentSolve;
+
+static void* runSolve(void* argument){
+    concurrentSolve* solve = argument;
+    cvrp_solution* solution = NULL;
+    solve->status = cvrp_solve(solve->problem, &solve->options, &solution);
+    solve->cost = cvrp_solution_cost(solution);
+    cvrp_solution_free(solution);
+    return NULL;
+}
+
+/* Returns nonzero if every customer of the problem is visited exactly once by the solution */
+static int visitsEveryCustomer(const cvrp_problem* problem, const cvrp_solution* solution){
+    size_t nodeCount = cvrp_problem_node_count(problem);
+    int* visits = calloc(nodeCount, sizeof(int));
+    int valid = visits != NULL;
+    for (size_t r = 0; valid && r < cvrp_solution_route_count(solution); r++){
+        const uint32_t* customers;
+        size_t length = cvrp_solution_route(solution, r, &customers);
+        for (size_t p = 0; p < length; p++){
+            if (customers[p] == 0 || customers[p] >= nodeCount) valid = 0;
+            else visits[customers[p]]++;
+        }
+    }
+    for (size_t i = 1; valid && i < nodeCount; i++){
+        if (visits[i] != 1) valid = 0;
+    }
+    free(visits);
+    return valid;
+}
+
+int main(int argc, char** argv){
+    if (argc != 2){
+        printf("Usage: libcvrpcheck file\n");
+        return 1;
+    }
+    check(cvrp_api_version() == CVRP_API_VERSION, "library and header versions match");
+
+    cvrp_problem* problem = NULL;
+    cvrp_solution* solution = NULL;
+    if (cvrp_problem_load(argv[1], &problem) != CVRP_OK){
+        printf("failed: load %s (%s)\n", argv[1], cvrp_last_error());
+        return 1;
+    }
+    cvrp_options options;
+    cvrp_options_init(&options);
+    options.seed = 3;
+    double costs[2] = { 0, 0 };
+    for (int run = 0; run < 2; run++){
+        check(cvrp_solve(problem, &options, &solution) == CVRP_OK, "tabu solve");
+        check(visitsEveryCustomer(problem, solution), "tabu solution visits every customer once");
+        costs[run] = cvrp_solution_cost(solution);
+        cvrp_solution_free(solution);
+    }
+    check(costs[0] > 0 && costs[0] == costs[1], "seeded solves give the same cost");
+
+    /* Only one of the solves gets the problem's workspace, and the others must still succeed */
+    enum { solveThreads = 4 };
+    concurrentSolve solves[solveThreads];
+    pthread_t threads[solveThreads];
+    int started[solveThreads];
+    for (int t = 0; t < solveThreads; t++){
+        solves[t].problem = problem;
+        solves[t].options = options;
+        solves[t].options.iteration_limit = 500;
+        solves[t].status = CVRP_FAILED;
+        started[t] = pthread_create(&threads[t], NULL, runSolve, &solves[t]) == 0;
+        check(started[t], "start a solving thread");
+    }
+    for (int t = 0; t < solveThreads; t++){
+        if (!started[t]) continue;
+        pthread_join(threads[t], NULL);
+        check(solves[t].status == CVRP_OK, "concurrent solve of one problem");
+        check(solves[t].cost == solves[0].cost, "concurrent seeded solves give the same cost");
+    }
+
+    options.algorithm = CVRP_ALGORITHM_HGS;
+    options.iteration_limit = 200;
+    options.threads = 2;
+    check(cvrp_solve(problem, &options, &solution) == CVRP_OK, "hgs solve");
+    check(visitsEveryCustomer(problem, solution), "hgs solution visits every customer once");
+    cvrp_solution_free(solution);
+    cvrp_problem_free(problem);
+
+    double x[4] = { 0, 10, 0, -10 }, y[4] = { 0, 0, 10, 0 };
+    int demands[4] = { 0, 5, 5, 20 };
+    check(cvrp_problem_create(4, x, y, demands, 10, NULL, &problem) == CVRP_INVALID_ARGUMENT && !problem,
+          "a demand above the capacity is rejected");
+    demands[3] = 5;
+    check(cvrp_problem_create(4, x, y, demands, 10, NULL, &problem) == CVRP_OK, "create a problem");
+    check(cvrp_solve(problem, NULL, &solution) == CVRP_OK, "solve with the default options");
+    check(visitsEveryCustomer(problem, solution) && cvrp_solution_route_count(solution) == 2,
+          "two vehicles serve the created problem");
+    cvrp_solution_free(solution);
+    cvrp_options unsized = options;
+    unsized.struct_size = 0;
+    check(cvrp_solve(problem, &unsized, &solution) == CVRP_INVALID_ARGUMENT && !solution,
+          "options without their size are rejected");
+    options.algorithm = (cvrp_algorithm)7;
+    check(cvrp_solve(problem, &options, &solution) == CVRP_INVALID_ARGUMENT && !solution,
+          "an unknown algorithm is rejected");
+    cvrp_problem_free(problem);
+
+    check(cvrp_problem_load("/nonexistent/problem.vrp", &problem) == CVRP_IO_ERROR && !problem,
+          "a missing file is reported");
+
+    if (failures) return 1;
+    printf("libcvrp check passed\n");
+    return 0;
+}
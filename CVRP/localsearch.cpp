@@ -0,0 +1,330 @@
+#include "localsearch.h"
+#include "distances.h"
+#include "telemetry.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    // Runs the granular local search over one solution, holding the state shared by every move
+    class localSearcher{
+    public:
+        localSearcher(compactSolution& solution, uint16_t vehicleCapacity, local::workspace& scratch,
+                      size_t neighbours)
+            : s(solution), nodes(solution.problemNodes()), d(solution.problemDistances()), capacity(vehicleCapacity),
+              scratch(scratch), neighbourCount(min(neighbours, d.neighbourCount())), moves(0){
+            scratch.loadBefore.assign(nodes.size(), 0);
+            for (size_t r = 0; r < s.routeCount(); r++) refreshLoads(r);
+            scratch.queue.clear();
+            scratch.queued.assign(nodes.size(), false);
+        }
+
+        // Clears the don't-look bit of customer v
+        void activate(size_t v){
+            if (v == 0 || s.routeOf(v) == compactSolution::noRoute || scratch.queued[v]) return;
+            scratch.queued[v] = true;
+            scratch.queue.push_back(static_cast<uint16_t>(v));
+        }
+
+        void run(){
+            while (!scratch.queue.empty()){
+                size_t v = scratch.queue.front();
+                scratch.queue.pop_front();
+                scratch.queued[v] = false;
+                // A node that moved keeps looking, as its new position may allow further moves
+                if (tryMoves(v)){
+                    activate(v);
+                    moves++;
+                }
+            }
+        }
+
+        // Number of moves made
+        size_t moveCount() const { return moves; }
+
+    private:
+        int demand(size_t v) const { return nodes[v].demand; }
+
+        void refreshLoads(size_t r){
+            const uint16_t* customers = s.route(r);
+            int load = 0;
+            for (size_t p = 0; p < s.routeLength(r); p++){
+                load += demand(customers[p]);
+                scratch.loadBefore[customers[p]] = load;
+            }
+        }
+
+        // Replaces route r with the contents of 'customers', which must not alias the solution
+        void setRoute(size_t r, const vector<uint16_t>& customers){
+            s.setRoute(r, customers.data(), customers.size());
+            refreshLoads(r);
+        }
+
+        // Replaces two different routes at once; customers may move between them
+        void setRoutes(size_t r, const vector<uint16_t>& first, size_t t, const vector<uint16_t>& second){
+            // Emptying t first stops it from unassigning the customers it passed to r
+            s.setRoute(t, nullptr, 0);
+            setRoute(r, first);
+            setRoute(t, second);
+        }
+
+        void copyRoute(size_t r, vector<uint16_t>& out) const{
+            out.assign(s.route(r), s.route(r) + s.routeLength(r));
+        }
+
+        // Returns true if customer v lies in route r between positions first and last inclusive
+        bool within(size_t v, size_t r, size_t first, size_t last) const{
+            return v != 0 && s.routeOf(v) == r && s.positionOf(v) >= first && s.positionOf(v) <= last;
+        }
+
+        // Tries every move creating an edge between v and one of its nearest neighbours, making the first that
+        // improves the solution. Returns true if a move was made.
+        bool tryMoves(size_t v){
+            const uint16_t* neighbours = d.neighbours(v);
+            for (size_t n = 0; n < neighbourCount; n++){
+                size_t w = neighbours[n];
+                if (w == 0 || s.routeOf(w) == compactSolution::noRoute) continue;
+                if (trySegmentMoves(v, w) || trySwaps(v, w)) return true;
+                if (s.routeOf(v) == s.routeOf(w) ? tryTwoOpt(v, w) : tryTwoOptStar(v, w)) return true;
+            }
+            return false;
+        }
+
+        // Relocate (segments of one) and Or-opt (segments of two or three): moves the segment starting at v
+        // next to w, in either orientation
+        bool trySegmentMoves(size_t v, size_t w){
+            size_t r = s.routeOf(v);
+            size_t t = s.routeOf(w);
+            size_t first = s.positionOf(v);
+            size_t prev = s.previous(v);
+            size_t e = v;
+            for (size_t length = 1; length <= 3; length++){
+                if (length > 1){
+                    e = s.next(e);
+                    if (e == 0) break;
+                }
+                size_t last = first + length - 1;
+                if (within(w, r, first, last)) break;
+                size_t after = s.next(e);
+                int segmentLoad = scratch.loadBefore[e] - scratch.loadBefore[v] + demand(v);
+                if (r != t && s.load(t) + segmentLoad > capacity) continue;
+                double removal = d(prev, after) - d(prev, v) - d(e, after);
+                // Either side of w
+                size_t edges[2][2] = { { s.previous(w), w }, { w, s.next(w) } };
+                for (auto& edge : edges){
+                    size_t a = edge[0], b = edge[1];
+                    if (within(a, r, first, last) || within(b, r, first, last)) continue;
+                    double forward = d(a, v) + d(e, b);
+                    double reversed = d(a, e) + d(v, b);
+                    double delta = removal + min(forward, reversed) - d(a, b);
+                    if (delta < -local::improvementEpsilon){
+                        moveSegment(v, e, length, t, a, b, reversed < forward);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Moves the 'length' customers from v to e into route t between a and b
+        void moveSegment(size_t v, size_t e, size_t length, size_t t, size_t a, size_t b, bool reverse){
+            size_t r = s.routeOf(v);
+            size_t first = s.positionOf(v);
+            size_t prev = s.previous(v), after = s.next(e);
+            vector<uint16_t>& source = scratch.routeA;
+            vector<uint16_t>& target = scratch.routeB;
+            copyRoute(r, source);
+            uint16_t segment[3];
+            copy(source.begin() + first, source.begin() + first + length, segment);
+            if (reverse) std::reverse(segment, segment + length);
+            source.erase(source.begin() + first, source.begin() + first + length);
+            vector<uint16_t>& destination = r == t ? source : target;
+            if (r != t) copyRoute(t, target);
+            // Insert after a, or at the start of the route if a is the depot
+            size_t position = a == 0 ? 0 : find(destination.begin(), destination.end(), a) - destination.begin() + 1;
+            destination.insert(destination.begin() + position, segment, segment + length);
+            if (r == t) setRoute(r, source);
+            else setRoutes(r, source, t, target);
+            size_t touched[] = { v, e, prev, after, a, b };
+            for (size_t x : touched) activate(x);
+        }
+
+        // Exchanges v with the customer on either side of w, so that v ends up next to w
+        bool trySwaps(size_t v, size_t w){
+            size_t r = s.routeOf(v);
+            size_t candidates[2] = { s.previous(w), s.next(w) };
+            for (size_t x : candidates){
+                if (x == 0 || x == v) continue;
+                size_t t = s.routeOf(x);
+                size_t pv = s.previous(v), nv = s.next(v);
+                size_t px = s.previous(x), nx = s.next(x);
+                // Adjacent nodes would share an edge; those exchanges are covered by relocation
+                if (r == t && (nv == x || nx == v)) continue;
+                if (r != t){
+                    int change = demand(x) - demand(v);
+                    if (s.load(r) + change > capacity || s.load(t) - change > capacity) continue;
+                }
+                double delta = d(pv, x) + d(x, nv) - d(pv, v) - d(v, nv)
+                             + d(px, v) + d(v, nx) - d(px, x) - d(x, nx);
+                if (delta < -local::improvementEpsilon){
+                    vector<uint16_t>& source = scratch.routeA;
+                    vector<uint16_t>& target = scratch.routeB;
+                    copyRoute(r, source);
+                    if (r == t){
+                        swap(source[s.positionOf(v)], source[s.positionOf(x)]);
+                        setRoute(r, source);
+                    }
+                    else{
+                        copyRoute(t, target);
+                        source[s.positionOf(v)] = static_cast<uint16_t>(x);
+                        target[s.positionOf(x)] = static_cast<uint16_t>(v);
+                        setRoutes(r, source, t, target);
+                    }
+                    size_t touched[] = { v, x, pv, nv, px, nx };
+                    for (size_t y : touched) activate(y);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // 2-opt: reverses the part of a route between v and w so that they become adjacent
+        bool tryTwoOpt(size_t v, size_t w){
+            size_t r = s.routeOf(v);
+            size_t first, last, a, b, c, e;
+            if (s.positionOf(v) < s.positionOf(w)){
+                // v, (next(v) ... w), next(w)  becomes  v, (w ... next(v)), next(w)
+                a = v; b = s.next(v); c = w; e = s.next(w);
+                first = s.positionOf(b); last = s.positionOf(w);
+            }
+            else{
+                // previous(w), (w ... previous(v)), v  becomes  previous(w), (previous(v) ... w), v
+                a = s.previous(w); b = w; c = s.previous(v); e = v;
+                first = s.positionOf(w); last = s.positionOf(c);
+            }
+            if (b == c) return false;
+            double delta = d(a, c) + d(b, e) - d(a, b) - d(c, e);
+            if (delta >= -local::improvementEpsilon) return false;
+            vector<uint16_t>& customers = scratch.routeA;
+            copyRoute(r, customers);
+            reverse(customers.begin() + first, customers.begin() + last + 1);
+            setRoute(r, customers);
+            size_t touched[] = { a, b, c, e };
+            for (size_t x : touched) activate(x);
+            return true;
+        }
+
+        // 2-opt*: exchanges the ends of the routes of v and w so that they become adjacent, either joining the
+        // start of v's route to the end of w's route or, reversing one of them, the starts of both routes
+        bool tryTwoOptStar(size_t v, size_t w){
+            size_t r = s.routeOf(v), t = s.routeOf(w);
+            size_t nv = s.next(v), pw = s.previous(w), nw = s.next(w);
+            int headV = scratch.loadBefore[v], tailV = s.load(r) - headV;
+            int headW = scratch.loadBefore[w], tailW = s.load(t) - headW;
+            // (... v) + (w ...)  and  (... previous(w)) + (next(v) ...)
+            if (headV + tailW + demand(w) <= capacity && headW - demand(w) + tailV <= capacity){
+                double delta = d(v, w) + d(pw, nv) - d(v, nv) - d(pw, w);
+                if (delta < -local::improvementEpsilon){
+                    exchangeTails(r, s.positionOf(v) + 1, t, s.positionOf(w), false);
+                    size_t touched[] = { v, w, nv, pw };
+                    for (size_t x : touched) activate(x);
+                    return true;
+                }
+            }
+            // (... v) + (w ... start of w's route)  and  (end of v's route ... next(v)) + (next(w) ...)
+            if (headV + headW <= capacity && tailV + tailW <= capacity){
+                double delta = d(v, w) + d(nv, nw) - d(v, nv) - d(w, nw);
+                if (delta < -local::improvementEpsilon){
+                    exchangeTails(r, s.positionOf(v) + 1, t, s.positionOf(w) + 1, true);
+                    size_t touched[] = { v, w, nv, nw };
+                    for (size_t x : touched) activate(x);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Splits route r before position 'splitR' and route t before 'splitT'. Without reversal, r's head is
+        // followed by t's tail and t's head by r's tail. With reversal, r's head is followed by t's head reversed,
+        // and r's tail reversed by t's tail.
+        void exchangeTails(size_t r, size_t splitR, size_t t, size_t splitT, bool reversal){
+            vector<uint16_t>& first = scratch.routeA;
+            vector<uint16_t>& second = scratch.routeB;
+            const uint16_t* routeR = s.route(r);
+            const uint16_t* routeT = s.route(t);
+            size_t lengthR = s.routeLength(r), lengthT = s.routeLength(t);
+            first.assign(routeR, routeR + splitR);
+            if (!reversal){
+                first.insert(first.end(), routeT + splitT, routeT + lengthT);
+                second.assign(routeT, routeT + splitT);
+                second.insert(second.end(), routeR + splitR, routeR + lengthR);
+            }
+            else{
+                first.insert(first.end(), reverse_iterator<const uint16_t*>(routeT + splitT),
+                             reverse_iterator<const uint16_t*>(routeT));
+                second.assign(reverse_iterator<const uint16_t*>(routeR + lengthR),
+                              reverse_iterator<const uint16_t*>(routeR + splitR));
+                second.insert(second.end(), routeT + splitT, routeT + lengthT);
+            }
+            setRoutes(r, first, t, second);
+        }
+
+        compactSolution& s;
+        const vector<node>& nodes;
+        const distanceCache& d;
+        int capacity;
+        local::workspace& scratch;
+        size_t neighbourCount;
+        size_t moves;
+    };
+
+}
+
+double local::improve(compactSolution& solution, uint16_t vehicleCapacity, workspace& scratch, size_t neighbours){
+    vector<uint16_t> customers;
+    for (size_t r = 0; r < solution.routeCount(); r++){
+        customers.insert(customers.end(), solution.route(r), solution.route(r) + solution.routeLength(r));
+    }
+    return improve(solution, vehicleCapacity, customers.data(), customers.size(), scratch, neighbours);
+}
+
+double local::improve(compactSolution& solution, uint16_t vehicleCapacity, const uint16_t* start, size_t count,
+                      workspace& scratch, size_t neighbours){
+    CVRP_SCOPE("localSearch");
+    double initialCost = solution.cost();
+    localSearcher searcher(solution, vehicleCapacity, scratch, neighbours);
+    for (size_t i = 0; i < count; i++) searcher.activate(start[i]);
+    searcher.run();
+    CVRP_COUNT(localSearchMoves, searcher.moveCount());
+    return initialCost - solution.cost();
+}
+
+// Position p stands for the edge from the node before the p-th customer (the depot for p = 0) to that customer,
+// and position 'count' for the edge back to the depot
+double local::twoOptRoute(uint16_t* customers, size_t count, const distanceCache& distances){
+    double total = 0;
+    auto at = [&](size_t p) -> size_t { return p == 0 || p > count ? 0 : customers[p - 1]; };
+    for (;;){
+        double bestGain = improvementEpsilon;
+        size_t bestI = 0, bestJ = 0;
+        // Reversing customers i to j - 1 (1-based) replaces edges (i-1, i) and (j-1, j) with (i-1, j-1) and (i, j)
+        for (size_t i = 1; i < count; i++){
+            size_t a = at(i - 1), b = at(i);
+            for (size_t j = i + 2; j <= count + 1; j++){
+                size_t c = at(j - 1), e = at(j);
+                double gain = distances(a, b) + distances(c, e) - distances(a, c) - distances(b, e);
+                if (gain > bestGain){
+                    bestGain = gain;
+                    bestI = i;
+                    bestJ = j;
+                }
+            }
+        }
+        if (bestJ == 0) return total;
+        reverse(customers + bestI - 1, customers + bestJ - 1);
+        total += bestGain;
+    }
+}
+
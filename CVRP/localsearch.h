@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <stdint.h>
+#include "cvrp.h"
+#include "routes.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    namespace local{
+
+        // Number of nearest neighbours of a node considered when creating an edge to it
+        const size_t defaultNeighbours = 10;
+
+        // Smallest cost decrease accepted as an improvement, which stops rounding errors from cycling moves
+        const double improvementEpsilon = 1e-9;
+
+        // Scratch buffers for local search, reusable across calls and problems
+        struct workspace{
+            // Load of each node's route from its start up to and including the node, indexed by node
+            vector<int> loadBefore;
+            // Nodes whose don't-look bit is clear, in the order they will be examined
+            deque<uint16_t> queue;
+            vector<bool> queued;
+            vector<uint16_t> routeA;
+            vector<uint16_t> routeB;
+        };
+
+        // Improves 'solution' with relocate, Or-opt, swap, 2-opt and 2-opt* moves until no improving move remains.
+        // Only moves creating an edge between a node and one of its 'neighbours' nearest neighbours are considered.
+        // Each node carries a don't-look bit that is set when none of its moves improve and cleared when a move
+        // changes one of its edges, and the first improving move found is made. Every move is scored in O(1) from
+        // the edges it changes and the cached route loads, and no move leads to an overloaded route.
+        // Returns the decrease in cost.
+        double improve(compactSolution& solution, uint16_t vehicleCapacity, workspace& scratch,
+                       size_t neighbours = defaultNeighbours);
+        // As above, with the don't-look bits of every node except the 'count' in 'start' initially set
+        double improve(compactSolution& solution, uint16_t vehicleCapacity, const uint16_t* start, size_t count,
+                       workspace& scratch, size_t neighbours = defaultNeighbours);
+
+        // Applies the best improving 2-opt move to the route of 'count' customers, which starts and ends at the
+        // depot, until none remains; every pair of edges is considered. Returns the decrease in cost.
+        double twoOptRoute(uint16_t* customers, size_t count, const distanceCache& distances);
+
+    }
+
+}
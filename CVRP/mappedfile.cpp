@@ -0,0 +1,70 @@
+#include "mappedfile.h"
+#include <stdexcept>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cvrp;
+
+#ifdef _WIN32
+mappedFile::mappedFile(const string& filename, bool sequential)
+    : begin(nullptr), length(0){
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0),
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) throw runtime_error("Filename is invalid.");
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)){
+        CloseHandle(file);
+        throw runtime_error("File could not be read.");
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length > 0){
+        // The view keeps the mapping and file open, so both handles can be closed straight away
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) begin = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (mapping) CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    if (length > 0 && !begin) throw runtime_error("File could not be mapped.");
+}
+
+mappedFile::~mappedFile(){
+    if (begin) UnmapViewOfFile(begin);
+}
+#else
+mappedFile::mappedFile(const string& filename, bool sequential)
+    : begin(nullptr), length(0){
+    int descriptor = open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) throw runtime_error("Filename is invalid.");
+    struct stat status;
+    if (fstat(descriptor, &status) != 0){
+        close(descriptor);
+        throw runtime_error("File could not be read.");
+    }
+    length = static_cast<size_t>(status.st_size);
+    if (length > 0){
+        // The mapping stays valid after the descriptor is closed
+        void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        close(descriptor);
+        if (mapped == MAP_FAILED) throw runtime_error("File could not be mapped.");
+        if (sequential) madvise(mapped, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char*>(mapped);
+    }
+    else{
+        close(descriptor);
+    }
+}
+
+mappedFile::~mappedFile(){
+    if (begin) munmap(const_cast<char*>(begin), length);
+}
+#endif
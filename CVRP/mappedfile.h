@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+using namespace std;
+
+namespace cvrp{
+
+    // Read-only view of a whole file mapped into memory, which stays valid, even if the file is replaced, until
+    // the view is destroyed
+    class mappedFile{
+    public:
+        // Maps the file, advising the system that it will be read from start to end if 'sequential' is set
+        explicit mappedFile(const string& filename, bool sequential = true);
+        ~mappedFile();
+        const char* data() const { return begin; }
+        size_t size() const { return length; }
+    private:
+        mappedFile(const mappedFile&);
+        mappedFile& operator=(const mappedFile&);
+        const char* begin;
+        size_t length;
+    };
+
+}
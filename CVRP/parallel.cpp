@@ -0,0 +1,123 @@
+#include "parallel.h"
+#include <limits>
+
+using namespace std;
+using namespace cvrp;
+
+threadPool::threadPool(size_t threadCount)
+    : queued(0), pending(0), nextQueue(0), stopping(false){
+    if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+    for (size_t w = 0; w < threadCount; w++) queues.emplace_back(new taskQueue());
+    // If a thread cannot be started, the workers already running must be joined before they are destroyed
+    try{
+        for (size_t w = 0; w < threadCount; w++) workers.emplace_back(&threadPool::workerLoop, this, w);
+    }
+    catch (...){
+        stopWorkers();
+        throw;
+    }
+}
+
+threadPool::~threadPool(){
+    stopWorkers();
+}
+
+void threadPool::stopWorkers(){
+    {
+        lock_guard<mutex> guard(stateLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+void threadPool::submit(function<void(size_t worker)> task){
+    pending++;
+    taskQueue& queue = *queues[nextQueue++ % queues.size()];
+    {
+        lock_guard<mutex> guard(queue.lock);
+        queue.tasks.push_back(move(task));
+    }
+    queued++;
+    // Taking the state lock orders this notification after any worker's check of 'queued'
+    {
+        lock_guard<mutex> guard(stateLock);
+    }
+    workAvailable.notify_one();
+}
+
+void threadPool::wait(){
+    unique_lock<mutex> guard(stateLock);
+    allDone.wait(guard, [&]{ return pending == 0; });
+    if (firstError){
+        exception_ptr error = firstError;
+        firstError = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+// Takes a task from the back of the worker's own queue, or steals one from the front of another queue
+bool threadPool::takeTask(size_t worker, function<void(size_t)>& task){
+    {
+        taskQueue& own = *queues[worker];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()){
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < queues.size(); offset++){
+        taskQueue& victim = *queues[(worker + offset) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()){
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void threadPool::workerLoop(size_t worker){
+    while (true){
+        function<void(size_t)> task;
+        if (takeTask(worker, task)){
+            try{
+                task(worker);
+            }
+            catch (...){
+                lock_guard<mutex> guard(stateLock);
+                if (!firstError) firstError = current_exception();
+            }
+            if (--pending == 0){
+                lock_guard<mutex> guard(stateLock);
+                allDone.notify_all();
+            }
+            continue;
+        }
+        unique_lock<mutex> guard(stateLock);
+        workAvailable.wait(guard, [&]{ return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+sharedBestSolution::sharedBestSolution()
+    : bestCost(numeric_limits<double>::max()) {}
+
+bool sharedBestSolution::offer(const compactSolution& candidate, double candidateCost){
+    // Cheap rejection of anything that is not an improvement, without taking the lock
+    if (candidateCost >= bestCost.load(memory_order_acquire)) return false;
+    lock_guard<mutex> guard(lock);
+    if (candidateCost >= bestCost.load(memory_order_relaxed)) return false;
+    best = candidate;
+    bestCost.store(candidateCost, memory_order_release);
+    return true;
+}
+
+compactSolution sharedBestSolution::get(){
+    lock_guard<mutex> guard(lock);
+    return best;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include "cvrp.h"
+#include "routes.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Fixed-size pool of worker threads with one task queue per worker. Tasks are spread over the queues as
+    // they are submitted; each worker runs tasks from the back of its own queue and, once that is empty,
+    // steals from the front of the other workers' queues. Tasks are given the index of the worker running
+    // them, so that per-worker state can be kept without thread-local storage.
+    class threadPool{
+    public:
+        // Creates a pool with the given number of workers, or one per hardware thread if threadCount is 0
+        explicit threadPool(size_t threadCount);
+        ~threadPool();
+        // Queues a task for execution
+        void submit(function<void(size_t worker)> task);
+        // Blocks until every submitted task has finished; rethrows the first exception thrown by a task
+        void wait();
+        // Returns the number of workers in the pool
+        size_t size() const { return workers.size(); }
+    private:
+        struct taskQueue{
+            mutex lock;
+            deque<function<void(size_t)>> tasks;
+        };
+        bool takeTask(size_t worker, function<void(size_t)>& task);
+        // Tells every worker to finish and joins them
+        void stopWorkers();
+        void workerLoop(size_t worker);
+
+        vector<unique_ptr<taskQueue>> queues;
+        vector<thread> workers;
+        mutex stateLock;
+        condition_variable workAvailable;
+        condition_variable allDone;
+        atomic<size_t> queued;
+        atomic<size_t> pending;
+        atomic<size_t> nextQueue;
+        bool stopping;
+        exception_ptr firstError;
+    };
+
+    // The best solution found so far by any of several threads. The cost can be read and tested without
+    // locking, so that threads can cheaply discard solutions that are no improvement; only actual improvements
+    // take the lock guarding the solution itself.
+    class sharedBestSolution{
+    public:
+        sharedBestSolution();
+        // Returns the cost of the best solution offered so far
+        double cost() const { return bestCost.load(memory_order_acquire); }
+        // Replaces the best solution if 'candidate' is cheaper, returning true if it was
+        bool offer(const compactSolution& candidate, double candidateCost);
+        // Returns a copy of the best solution offered so far
+        compactSolution get();
+    private:
+        atomic<double> bestCost;
+        mutex lock;
+        compactSolution best;
+    };
+
+}
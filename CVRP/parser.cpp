@@ -0,0 +1,414 @@
+#include "parser.h"
+#include "telemetry.h"
+#include "mappedfile.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <stdexcept>
+#include <stdint.h>
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    inline bool isSpace(char c){
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v';
+    }
+    inline bool isDigit(char c){
+        return c >= '0' && c <= '9';
+    }
+
+    // Every power of ten that is exactly representable as a double
+    const double powersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    // Scans an integer starting at p, which must be followed by whitespace or the end of the input.
+    // Returns false, leaving p anywhere, if there is no well-formed integer there
+    bool scanInteger(const char*& p, const char* end, long long& value){
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+        if (p == end || !isDigit(*p)) return false;
+        value = 0;
+        while (p < end && isDigit(*p)){
+            value = value*10 + (*p++ - '0');
+            if (value > 1000000000000000LL) return false;
+        }
+        if (negative) value = -value;
+        return p == end || isSpace(*p);
+    }
+
+    // Scans a decimal number with optional fraction and exponent starting at p, which must be followed by
+    // whitespace or the end of the input. Numbers of up to 19 significant digits with a small exponent, which
+    // covers every number in practice, are converted exactly with a single multiplication or division; others
+    // are passed on to strtod
+    bool scanNumber(const char*& p, const char* end, double& value){
+        const char* start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool anyDigits = false;
+        while (p < end && isDigit(*p)){
+            if (digits < 19){
+                mantissa = mantissa*10 + (*p - '0');
+                if (mantissa) digits++;
+            }
+            else{
+                exponent++;
+            }
+            p++;
+            anyDigits = true;
+        }
+        if (p < end && *p == '.'){
+            p++;
+            while (p < end && isDigit(*p)){
+                if (digits < 19){
+                    mantissa = mantissa*10 + (*p - '0');
+                    if (mantissa) digits++;
+                    exponent--;
+                }
+                p++;
+                anyDigits = true;
+            }
+        }
+        if (!anyDigits) return false;
+        if (p < end && (*p == 'e' || *p == 'E')){
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+')) negativeExponent = *p++ == '-';
+            if (p == end || !isDigit(*p)) return false;
+            int written = 0;
+            while (p < end && isDigit(*p)){
+                if (written < 10000) written = written*10 + (*p - '0');
+                p++;
+            }
+            exponent += negativeExponent ? -written : written;
+        }
+        if (p < end && !isSpace(*p)) return false;
+        if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22){
+            value = exponent < 0 ? mantissa / powersOfTen[-exponent] : mantissa * powersOfTen[exponent];
+        }
+        else{
+            char buffer[128];
+            size_t length = min<size_t>(p - start, sizeof(buffer) - 1);
+            memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            value = strtod(buffer, nullptr);
+            return isfinite(value);
+        }
+        if (negative) value = -value;
+        return true;
+    }
+
+    // Cursor over the problem text. Tokens are read in place; nothing is copied except header values that are
+    // kept as strings.
+    class scanner{
+    public:
+        scanner(const char* data, size_t size, const string& sourceName)
+            : start(data), cur(data), end(data + size), source(sourceName) {}
+
+        // Returns true once only whitespace remains
+        bool atEnd(){
+            skipWhitespace();
+            return cur == end;
+        }
+        // Reads the next run of characters up to whitespace or ':'
+        void readKeyword(const char*& word, size_t& length){
+            skipWhitespace();
+            word = cur;
+            while (cur < end && !isSpace(*cur) && *cur != ':') cur++;
+            length = cur - word;
+        }
+        // Reads the rest of the current line after an optional ':' separator, without surrounding whitespace
+        void readValue(const char*& value, size_t& length){
+            while (cur < end && (*cur == ' ' || *cur == '\t')) cur++;
+            if (cur < end && *cur == ':') cur++;
+            while (cur < end && (*cur == ' ' || *cur == '\t')) cur++;
+            value = cur;
+            while (cur < end && *cur != '\n') cur++;
+            const char* valueEnd = cur;
+            while (valueEnd > value && isSpace(valueEnd[-1])) valueEnd--;
+            length = valueEnd - value;
+        }
+        long long readInteger(){
+            skipWhitespace();
+            long long value;
+            if (!scanInteger(cur, end, value)) fail("integer expected");
+            return value;
+        }
+        double readNumber(){
+            skipWhitespace();
+            double value;
+            if (!scanNumber(cur, end, value)) fail("number expected");
+            return value;
+        }
+        // Throws an error naming the current line
+        void fail(const string& message) const{
+            size_t line = 1 + count(start, cur, '\n');
+            throw runtime_error(source + ":" + to_string(line) + ": " + message);
+        }
+
+    private:
+        void skipWhitespace(){
+            while (cur < end && isSpace(*cur)) cur++;
+        }
+
+        const char* start;
+        const char* cur;
+        const char* end;
+        const string& source;
+    };
+
+    // Returns the TSPLIB "nearest integer" of x
+    inline double nint(double x){
+        return floor(x + 0.5);
+    }
+
+    // Converts a TSPLIB GEO coordinate in degrees.minutes to radians
+    double geoRadians(double x){
+        const double pi = 3.141592;
+        double degrees = static_cast<int>(x);
+        double minutes = x - degrees;
+        return pi * (degrees + 5.0*minutes/3.0) / 180.0;
+    }
+
+    // Returns the TSPLIB distance between two points for the coordinate based edge weight types other than EUC_2D
+    double tsplibDistance(const string& type, double xa, double ya, double xb, double yb){
+        double dx = xa - xb;
+        double dy = ya - yb;
+        if (type == "CEIL_2D") return ceil(sqrt(dx*dx + dy*dy));
+        if (type == "MAN_2D") return nint(fabs(dx) + fabs(dy));
+        if (type == "MAX_2D") return max(nint(fabs(dx)), nint(fabs(dy)));
+        if (type == "ATT"){
+            double r = sqrt((dx*dx + dy*dy) / 10.0);
+            double t = nint(r);
+            return t < r ? t + 1 : t;
+        }
+        // GEO: x is latitude and y is longitude
+        const double earthRadius = 6378.388;
+        double q1 = cos(geoRadians(ya) - geoRadians(yb));
+        double q2 = cos(geoRadians(xa) - geoRadians(xb));
+        double q3 = cos(geoRadians(xa) + geoRadians(xb));
+        return static_cast<int>(earthRadius * acos(0.5*((1.0 + q1)*q2 - (1.0 - q1)*q3)) + 1.0);
+    }
+
+}
+
+problemParameters cvrp::parseProblem(const char* data, size_t size, const string& sourceName){
+    CVRP_SCOPE("parse");
+    scanner in(data, size, sourceName);
+    problemParameters problem;
+    string edgeWeightType = "EUC_2D";
+    string edgeWeightFormat;
+    vector<double> xs, ys, displayXs, displayYs;
+    vector<long long> demands;
+    vector<bool> seen;
+    bool hasCoordinates = false, hasDemands = false, hasWeights = false;
+    size_t n = 0;
+
+    // Reads 'n' lines of "number x y" in any order
+    auto readPoints = [&](vector<double>& x, vector<double>& y){
+        x.assign(n, 0);
+        y.assign(n, 0);
+        seen.assign(n, false);
+        for (size_t k = 0; k < n; k++){
+            long long num = in.readInteger();
+            if (num < 1 || num > static_cast<long long>(n)) in.fail("node number out of range");
+            if (seen[num - 1]) in.fail("node " + to_string(num) + " is listed twice");
+            seen[num - 1] = true;
+            x[num - 1] = in.readNumber();
+            y[num - 1] = in.readNumber();
+            if (!(fabs(x[num - 1]) <= maxCoordinate) || !(fabs(y[num - 1]) <= maxCoordinate)){
+                in.fail("coordinate out of range");
+            }
+        }
+    };
+
+    while (!in.atEnd()){
+        const char* word;
+        size_t length;
+        in.readKeyword(word, length);
+        string keyword(word, length);
+        if (keyword == "EOF") break;
+        bool isSection = length > 8 && keyword.compare(length - 8, 8, "_SECTION") == 0;
+        if (isSection && n == 0) in.fail("DIMENSION must be given before " + keyword);
+
+        if (keyword == "NODE_COORD_SECTION"){
+            readPoints(xs, ys);
+            hasCoordinates = true;
+        }
+        else if (keyword == "DISPLAY_DATA_SECTION"){
+            readPoints(displayXs, displayYs);
+        }
+        else if (keyword == "DEMAND_SECTION"){
+            demands.assign(n, 0);
+            seen.assign(n, false);
+            for (size_t k = 0; k < n; k++){
+                long long num = in.readInteger();
+                if (num < 1 || num > static_cast<long long>(n)) in.fail("node number out of range");
+                if (seen[num - 1]) in.fail("node " + to_string(num) + " is listed twice");
+                seen[num - 1] = true;
+                demands[num - 1] = in.readInteger();
+                if (demands[num - 1] < 0 || demands[num - 1] > UINT16_MAX) in.fail("demand out of range");
+            }
+            hasDemands = true;
+        }
+        else if (keyword == "DEPOT_SECTION"){
+            vector<long long> depots;
+            for (long long num = in.readInteger(); num != -1; num = in.readInteger()){
+                if (num < 1 || num > static_cast<long long>(n)) in.fail("depot number out of range");
+                depots.push_back(num);
+            }
+            if (depots.size() != 1 || depots[0] != 1) in.fail("only a single depot numbered 1 is supported");
+        }
+        else if (keyword == "EDGE_WEIGHT_SECTION"){
+            if (edgeWeightType != "EXPLICIT") in.fail("EDGE_WEIGHT_SECTION requires EDGE_WEIGHT_TYPE EXPLICIT");
+            // Column-wise formats list the same pairs as the opposite row-wise format, swapped, which makes no
+            // difference to a symmetric matrix
+            string format = edgeWeightFormat;
+            if (format == "UPPER_COL") format = "LOWER_ROW";
+            else if (format == "LOWER_COL") format = "UPPER_ROW";
+            else if (format == "UPPER_DIAG_COL") format = "LOWER_DIAG_ROW";
+            else if (format == "LOWER_DIAG_COL") format = "UPPER_DIAG_ROW";
+            bool full = format == "FULL_MATRIX";
+            bool upper = format == "UPPER_ROW" || format == "UPPER_DIAG_ROW";
+            bool lower = format == "LOWER_ROW" || format == "LOWER_DIAG_ROW";
+            bool diagonal = format == "UPPER_DIAG_ROW" || format == "LOWER_DIAG_ROW";
+            if (!full && !upper && !lower) in.fail("unsupported EDGE_WEIGHT_FORMAT '" + edgeWeightFormat + "'");
+            vector<double>& weights = problem.edgeWeights;
+            weights.assign(n*n, 0);
+            for (size_t i = 0; i < n; i++){
+                size_t jBegin = full || lower ? 0 : (diagonal ? i : i + 1);
+                size_t jEnd = full || upper ? n : (diagonal ? i + 1 : i);
+                for (size_t j = jBegin; j < jEnd; j++){
+                    double weight = in.readNumber();
+                    if (!(weight >= 0) || !isfinite(weight)) in.fail("edge weight out of range");
+                    weights[i*n + j] = weight;
+                    if (!full) weights[j*n + i] = weight;
+                }
+            }
+            for (size_t i = 0; i < n; i++){
+                weights[i*n + i] = 0;
+                for (size_t j = 0; j < i; j++){
+                    double a = weights[i*n + j], b = weights[j*n + i];
+                    if (fabs(a - b) > 1e-9 * max(1.0, max(a, b))) in.fail("asymmetric edge weights are not supported");
+                }
+            }
+            hasWeights = true;
+        }
+        else if (isSection){
+            in.fail("unsupported section " + keyword);
+        }
+        else{
+            // Header line
+            const char* valueText;
+            size_t valueLength;
+            in.readValue(valueText, valueLength);
+            string value(valueText, valueLength);
+            auto integerValue = [&](long long minimum, long long maximum){
+                const char* p = valueText;
+                long long result;
+                if (!scanInteger(p, valueText + valueLength, result) || p != valueText + valueLength){
+                    in.fail(keyword + " must be an integer");
+                }
+                if (result < minimum || result > maximum) in.fail(keyword + " out of range");
+                return result;
+            };
+            auto numberValue = [&](){
+                const char* p = valueText;
+                double result;
+                if (!scanNumber(p, valueText + valueLength, result) || p != valueText + valueLength || result < 0){
+                    in.fail(keyword + " must be a non-negative number");
+                }
+                return result;
+            };
+            if (keyword == "NAME"){
+                problem.name = value;
+            }
+            else if (keyword == "TYPE"){
+                if (value != "CVRP" && value != "DCVRP") in.fail("unsupported problem TYPE '" + value + "'");
+            }
+            else if (keyword == "DIMENSION"){
+                if (n != 0) in.fail("DIMENSION given twice");
+                n = static_cast<size_t>(integerValue(2, UINT16_MAX));
+                problem.dimension = static_cast<int>(n);
+            }
+            else if (keyword == "CAPACITY"){
+                problem.capacity = static_cast<int>(integerValue(1, UINT16_MAX));
+            }
+            else if (keyword == "VEHICLES"){
+                problem.vehicles = static_cast<int>(integerValue(1, UINT16_MAX));
+            }
+            else if (keyword == "DISTANCE"){
+                problem.maxRouteLength = numberValue();
+            }
+            else if (keyword == "SERVICE_TIME"){
+                problem.serviceTime = numberValue();
+            }
+            else if (keyword == "EDGE_WEIGHT_TYPE"){
+                if (value != "EUC_2D" && value != "CEIL_2D" && value != "ATT" && value != "MAN_2D" && value != "MAX_2D"
+                    && value != "GEO" && value != "EXPLICIT"){
+                    in.fail("unsupported EDGE_WEIGHT_TYPE '" + value + "'");
+                }
+                edgeWeightType = value;
+            }
+            else if (keyword == "EDGE_WEIGHT_FORMAT"){
+                edgeWeightFormat = value;
+            }
+            else if (keyword == "NODE_COORD_TYPE"){
+                if (value != "TWOD_COORDS" && value != "NO_COORDS") in.fail("unsupported NODE_COORD_TYPE '" + value + "'");
+            }
+            // Other headers, such as COMMENT and DISPLAY_DATA_TYPE, do not affect the problem
+        }
+    }
+
+    auto fail = [&](const string& message){
+        throw runtime_error(sourceName + ": " + message);
+    };
+    if (n == 0) fail("missing DIMENSION");
+    if (problem.capacity == 0) fail("missing CAPACITY");
+    if (!hasDemands) fail("missing DEMAND_SECTION");
+    bool explicitWeights = edgeWeightType == "EXPLICIT";
+    if (explicitWeights && !hasWeights) fail("missing EDGE_WEIGHT_SECTION");
+    if (!explicitWeights && !hasCoordinates) fail("missing NODE_COORD_SECTION");
+    if (demands[0] != 0) fail("the depot must have no demand");
+    for (size_t i = 0; i < n; i++){
+        if (demands[i] > problem.capacity) fail("demand of node " + to_string(i + 1) + " exceeds the vehicle capacity");
+    }
+
+    // Nodes without coordinates take their display coordinates, if any, so that solutions can still be drawn
+    const vector<double>& x = hasCoordinates ? xs : displayXs;
+    const vector<double>& y = hasCoordinates ? ys : displayYs;
+    problem.nodes.resize(n);
+    for (size_t i = 0; i < n; i++){
+        node& v = problem.nodes[i];
+        v.num = static_cast<uint16_t>(i + 1);
+        v.demand = static_cast<uint16_t>(demands[i]);
+        v.x = x.empty() ? 0.0f : static_cast<float>(x[i]);
+        v.y = y.empty() ? 0.0f : static_cast<float>(y[i]);
+    }
+    if (!explicitWeights && edgeWeightType != "EUC_2D"){
+        problem.edgeWeights.assign(n*n, 0);
+        for (size_t i = 0; i < n; i++){
+            for (size_t j = 0; j < i; j++){
+                double weight = tsplibDistance(edgeWeightType, xs[i], ys[i], xs[j], ys[j]);
+                problem.edgeWeights[i*n + j] = weight;
+                problem.edgeWeights[j*n + i] = weight;
+            }
+        }
+    }
+    return problem;
+}
+
+problemParameters cvrp::loadProblem(const string& filename){
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    mappedFile file(filename);
+    problemParameters problem = parseProblem(file.data(), file.size(), filename);
+    problem.parseSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    return problem;
+}
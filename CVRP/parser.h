@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Largest absolute coordinate accepted, beyond which single precision coordinates stop being exact integers
+    const double maxCoordinate = 16777216.0;
+
+    // Parses a problem in TSPLIB/CVRPLIB format held in memory, throwing runtime_error with the offending line
+    // number if it is malformed or out of range.
+    // Coordinates may be integers or floating point numbers. EUC_2D distances are exact euclidean distances, as
+    // used throughout the solver; CEIL_2D, ATT, MAN_2D, MAX_2D and GEO distances are computed as defined by
+    // TSPLIB, and these and EXPLICIT weights (in any EDGE_WEIGHT_FORMAT) are returned in edgeWeights.
+    // The solver requires a single depot numbered 1 and symmetric distances.
+    problemParameters parseProblem(const char* data, size_t size, const string& sourceName = "problem");
+
+    // Maps a problem file into memory and parses it in place, recording the time taken in parseSeconds
+    problemParameters loadProblem(const string& filename);
+
+}
@@ -0,0 +1,75 @@
+#include "routecache.h"
+#include <random>
+#include "telemetry.h"
+
+using namespace std;
+using namespace cvrp;
+
+routeHasher::routeHasher(size_t nodeCount, uint64_t seed)
+    : keys(nodeCount){
+    mt19937_64 rng(seed);
+    for (auto& key : keys) key = rng();
+}
+
+uint64_t routeHasher::hash(const uint16_t* customers, size_t count) const{
+    if (count == 0) return 0;
+    uint64_t h = edge(0, customers[0]) ^ edge(customers[count - 1], 0);
+    for (size_t p = 0; p + 1 < count; p++) h ^= edge(customers[p], customers[p + 1]);
+    return h;
+}
+
+routeCache::routeCache(size_t capacity)
+    : shardCapacity(max<size_t>(1, capacity / routeCacheShards)), hitCount(0), missCount(0){
+    for (size_t s = 0; s < routeCacheShards; s++) shards.emplace_back(new shard());
+}
+
+bool routeCache::find(uint64_t hash, size_t length, routeEntry& entry){
+    shard& s = shardOf(hash);
+    {
+        lock_guard<mutex> guard(s.lock);
+        auto found = s.index.find(hash);
+        if (found != s.index.end() && found->second->length == length){
+            // Move the entry to the front of the recency list
+            s.entries.splice(s.entries.begin(), s.entries, found->second);
+            entry = found->second->entry;
+            hitCount.fetch_add(1, memory_order_relaxed);
+            CVRP_COUNT(routeCacheHits, 1);
+            return true;
+        }
+    }
+    missCount.fetch_add(1, memory_order_relaxed);
+    CVRP_COUNT(routeCacheMisses, 1);
+    return false;
+}
+
+void routeCache::insert(uint64_t hash, size_t length, const routeEntry& entry){
+    shard& s = shardOf(hash);
+    lock_guard<mutex> guard(s.lock);
+    auto found = s.index.find(hash);
+    if (found != s.index.end()){
+        found->second->length = length;
+        found->second->entry = entry;
+        s.entries.splice(s.entries.begin(), s.entries, found->second);
+        return;
+    }
+    if (s.entries.size() >= shardCapacity){
+        s.index.erase(s.entries.back().hash);
+        s.entries.pop_back();
+        CVRP_COUNT(routeCacheEvictions, 1);
+    }
+    stored added;
+    added.hash = hash;
+    added.length = length;
+    added.entry = entry;
+    s.entries.push_front(move(added));
+    s.index[hash] = s.entries.begin();
+}
+
+size_t routeCache::size() const{
+    size_t total = 0;
+    for (const auto& s : shards){
+        lock_guard<mutex> guard(s->lock);
+        total += s->entries.size();
+    }
+    return total;
+}
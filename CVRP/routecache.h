@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <stdint.h>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Number of routes kept by a route cache unless otherwise requested
+    const size_t defaultRouteCacheSize = 1 << 16;
+    // Number of independently locked shards of a route cache
+    const size_t routeCacheShards = 16;
+
+    // Zobrist hashing of routes. Each node is given a random 64-bit key, each directed edge a key mixed from the
+    // keys of its ends, and a route's hash is the exclusive or of the keys of its edges, including those to and
+    // from the depot. As the edges of a route determine its order, routes visiting the same customers in a
+    // different order hash differently.
+    class routeHasher{
+    public:
+        explicit routeHasher(size_t nodeCount, uint64_t seed = 0x5eed);
+        // Returns the key of the edge from node a to node b
+        uint64_t edge(size_t a, size_t b) const{
+            uint64_t h = keys[a] ^ (keys[b] * 0x9e3779b97f4a7c15ull);
+            h ^= h >> 31;
+            h *= 0xbf58476d1ce4e5b9ull;
+            return h ^ (h >> 29);
+        }
+        // Returns the hash of the route visiting 'count' customers in order, starting and ending at the depot
+        uint64_t hash(const uint16_t* customers, size_t count) const;
+    private:
+        vector<uint64_t> keys;
+    };
+
+    // The order of a route's customers after intra-route 2-opt, with the cost of that order
+    struct routeEntry{
+        routeEntry()
+            : optimizedCost(0) {}
+        double optimizedCost;
+        vector<uint16_t> optimized;
+    };
+
+    // Routes of one problem by hash, shared by every thread solving it. The cache is split into shards chosen by
+    // hash, each with its own lock and holding at most its share of the capacity, so that threads rarely wait
+    // for each other; each shard evicts its least recently used route when full. Entries also record their
+    // route's length, which is checked on lookup to reject the rare hash collision between routes of different
+    // lengths.
+    class routeCache{
+    public:
+        explicit routeCache(size_t capacity = defaultRouteCacheSize);
+
+        // Copies the entry of the route with the given hash and length to 'entry' and returns true, or returns
+        // false if there is none
+        bool find(uint64_t hash, size_t length, routeEntry& entry);
+        // Adds or replaces the entry of the route with the given hash and length
+        void insert(uint64_t hash, size_t length, const routeEntry& entry);
+
+        // Returns the number of routes held
+        size_t size() const;
+        // Returns the number of lookups that found, or did not find, an entry
+        uint64_t hits() const { return hitCount.load(memory_order_relaxed); }
+        uint64_t misses() const { return missCount.load(memory_order_relaxed); }
+
+    private:
+        struct stored{
+            uint64_t hash;
+            size_t length;
+            routeEntry entry;
+        };
+        struct shard{
+            mutex lock;
+            // Most recently used first
+            list<stored> entries;
+            unordered_map<uint64_t, list<stored>::iterator> index;
+        };
+        shard& shardOf(uint64_t hash) { return *shards[hash % shards.size()]; }
+
+        size_t shardCapacity;
+        vector<unique_ptr<shard>> shards;
+        atomic<uint64_t> hitCount;
+        atomic<uint64_t> missCount;
+    };
+
+}
@@ -0,0 +1,204 @@
+#include "routes.h"
+#include "distances.h"
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace cvrp;
+
+const uint16_t compactSolution::noRoute;
+
+compactSolution::compactSolution(const vector<node>& nodes, const distanceCache& distances)
+    : nodes(&nodes), distances(&distances), routeStarts(1, 0), nodeRoute(nodes.size(), noRoute),
+      nodePosition(nodes.size(), 0){
+    if (nodes.size() > noRoute) throw invalid_argument("Too many nodes for a compact solution.");
+}
+
+compactSolution::compactSolution(const solution& initial, const vector<node>& nodes, const distanceCache& distances)
+    : compactSolution(nodes, distances){
+    vector<uint16_t> customers;
+    for (const auto& v : initial.vehicles){
+        customers.clear();
+        for (size_t p = 1; p < v.route.size(); p++) customers.push_back(v.route[p].num - 1);
+        appendRoute(customers.data(), customers.size());
+    }
+}
+
+double compactSolution::cost() const{
+    double totalCost = 0;
+    for (double c : routeCosts) totalCost += c;
+    return totalCost;
+}
+
+double compactSolution::reportedCost() const{
+    if (costPolicy::exact) return cost();
+    double totalCost = 0;
+    for (size_t r = 0; r < routeCount(); r++){
+        size_t previous = 0;
+        for (size_t p = 0; p <= routeLength(r); p++){
+            size_t v = p < routeLength(r) ? route(r)[p] : 0;
+            totalCost += distances->exactDistance(previous, v);
+            previous = v;
+        }
+    }
+    return totalCost;
+}
+
+double compactSolution::centroidAngle(size_t r) const{
+    double x = 0, y = 0;
+    for (size_t p = 0; p < routeLength(r); p++){
+        x += (*nodes)[route(r)[p]].x;
+        y += (*nodes)[route(r)[p]].y;
+    }
+    double length = static_cast<double>(max<size_t>(1, routeLength(r)));
+    return atan2(y / length - (*nodes)[0].y, x / length - (*nodes)[0].x);
+}
+
+// Records the route and position of the customers of route r from 'fromPosition' onwards
+void compactSolution::indexRoute(size_t r, size_t fromPosition){
+    const uint16_t* customers = route(r);
+    for (size_t p = fromPosition; p < routeLength(r); p++){
+        nodeRoute[customers[p]] = static_cast<uint16_t>(r);
+        nodePosition[customers[p]] = static_cast<uint16_t>(p);
+    }
+}
+
+double compactSolution::computeRouteCost(size_t r) const{
+    const uint16_t* customers = route(r);
+    size_t length = routeLength(r);
+    if (length == 0) return 0;
+    const distanceCache& d = *distances;
+    double routeCost = d(0, customers[0]) + d(customers[length - 1], 0);
+    for (size_t p = 0; p + 1 < length; p++) routeCost += d(customers[p], customers[p + 1]);
+    return routeCost;
+}
+
+size_t compactSolution::addRoute(){
+    routeStarts.push_back(routeStarts.back());
+    routeLoads.push_back(0);
+    routeCosts.push_back(0);
+    return routeLoads.size() - 1;
+}
+
+void compactSolution::appendRoute(const uint16_t* customers, size_t count){
+    size_t r = addRoute();
+    setRoute(r, customers, count);
+}
+
+void compactSolution::setRoute(size_t r, const uint16_t* customers, size_t count){
+    for (size_t p = 0; p < routeLength(r); p++) nodeRoute[route(r)[p]] = noRoute;
+    // Resize the route's slice of the buffer, moving every later route along
+    size_t oldLength = routeLength(r);
+    auto begin = tour.begin() + routeStarts[r];
+    if (count > oldLength) tour.insert(begin + oldLength, count - oldLength, 0);
+    else tour.erase(begin + count, begin + oldLength);
+    for (size_t t = r + 1; t < routeStarts.size(); t++) routeStarts[t] += static_cast<uint32_t>(count - oldLength);
+    copy(customers, customers + count, tour.begin() + routeStarts[r]);
+    routeLoads[r] = 0;
+    for (size_t p = 0; p < count; p++) routeLoads[r] += (*nodes)[customers[p]].demand;
+    routeCosts[r] = computeRouteCost(r);
+    indexRoute(r, 0);
+}
+
+double compactSolution::insertionDelta(size_t v, size_t a, size_t b) const{
+    const distanceCache& d = *distances;
+    return d(a, v) + d(v, b) - d(a, b);
+}
+
+double compactSolution::removalDelta(size_t v) const{
+    size_t a = previous(v);
+    size_t b = next(v);
+    const distanceCache& d = *distances;
+    return d(a, b) - d(a, v) - d(v, b);
+}
+
+void compactSolution::insert(size_t v, size_t r, size_t position){
+    size_t length = routeLength(r);
+    size_t a = position == 0 ? 0 : route(r)[position - 1];
+    size_t b = position == length ? 0 : route(r)[position];
+    routeCosts[r] += insertionDelta(v, a, b);
+    routeLoads[r] += (*nodes)[v].demand;
+    tour.insert(tour.begin() + routeStarts[r] + position, static_cast<uint16_t>(v));
+    for (size_t t = r + 1; t < routeStarts.size(); t++) routeStarts[t]++;
+    indexRoute(r, position);
+}
+
+void compactSolution::remove(size_t v){
+    size_t r = nodeRoute[v];
+    size_t position = nodePosition[v];
+    routeCosts[r] += removalDelta(v);
+    routeLoads[r] -= (*nodes)[v].demand;
+    // A route left empty costs nothing, whatever rounding the deltas accumulated
+    if (routeLength(r) == 1) routeCosts[r] = 0;
+    tour.erase(tour.begin() + routeStarts[r] + position);
+    for (size_t t = r + 1; t < routeStarts.size(); t++) routeStarts[t]--;
+    nodeRoute[v] = noRoute;
+    indexRoute(r, position);
+}
+
+void compactSolution::removeRoute(size_t r){
+    setRoute(r, nullptr, 0);
+    routeStarts.erase(routeStarts.begin() + r + 1);
+    routeLoads.erase(routeLoads.begin() + r);
+    routeCosts.erase(routeCosts.begin() + r);
+    for (size_t t = r; t < routeCount(); t++) indexRoute(t, 0);
+}
+
+void compactSolution::removeEmptyRoutes(){
+    size_t kept = 0;
+    for (size_t r = 0; r < routeCount(); r++){
+        if (routeLength(r) == 0) continue;
+        routeStarts[kept + 1] = routeStarts[r + 1];
+        routeLoads[kept] = routeLoads[r];
+        routeCosts[kept] = routeCosts[r];
+        if (kept != r) indexRoute(kept, 0);
+        kept++;
+    }
+    routeStarts.resize(kept + 1);
+    routeLoads.resize(kept);
+    routeCosts.resize(kept);
+}
+
+bool compactSolution::isFeasible(uint16_t vehicleCapacity) const{
+    if (tour.size() != nodes->size() - 1) return false;
+    vector<bool> nodeFound(nodes->size(), false);
+    nodeFound[0] = true;
+    for (uint16_t v : tour){
+        if (v >= nodes->size() || nodeFound[v]) return false;
+        nodeFound[v] = true;
+    }
+    for (int32_t load : routeLoads){
+        if (load > vehicleCapacity) return false;
+    }
+    return true;
+}
+
+solution compactSolution::toSolution() const{
+    solution result;
+    for (size_t r = 0; r < routeCount(); r++){
+        result.vehicles.emplace_back((*nodes)[0]);
+        vector<node>& vehicleRoute = result.vehicles.back().route;
+        for (size_t p = 0; p < routeLength(r); p++) vehicleRoute.push_back((*nodes)[route(r)[p]]);
+    }
+    return result;
+}
+
+string compactSolution::getRouteString(size_t r) const{
+    string output = "1->";
+    for (size_t p = 0; p < routeLength(r); p++){
+        output += to_string(route(r)[p] + 1);
+        output += "->";
+    }
+    output += "1";
+    return output;
+}
+
+void compactSolution::printSolution(ostream& out) const{
+    out << "cost " << setprecision(10) << reportedCost();
+    for (size_t r = 0; r < routeCount(); r++){
+        out << '\n' << getRouteString(r);
+    }
+    out << endl;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+#include "cvrp.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // A solution stored as node indices (node.num - 1). The customers of every route lie in one flat buffer,
+    // route after route, without the depot that starts and ends each route. Each node's route and position are
+    // looked up in O(1), and each route's load and cost are cached. The mutation methods keep all of these
+    // consistent, computing cost changes from the edges they add and remove.
+    // A solution refers to the nodes and distances of its problem, which must outlive it.
+    class compactSolution{
+    public:
+        // Route of a node that is not in any route, such as the depot
+        static const uint16_t noRoute = UINT16_MAX;
+
+        compactSolution()
+            : nodes(nullptr), distances(nullptr), routeStarts(1, 0) {}
+        // Creates a solution with no routes
+        compactSolution(const vector<node>& nodes, const distanceCache& distances);
+        // Converts a solution made of vehicles
+        compactSolution(const solution& initial, const vector<node>& nodes, const distanceCache& distances);
+
+        const vector<node>& problemNodes() const { return *nodes; }
+        const distanceCache& problemDistances() const { return *distances; }
+
+        size_t routeCount() const { return routeLoads.size(); }
+        // Returns the number of customers in route r
+        size_t routeLength(size_t r) const { return routeStarts[r + 1] - routeStarts[r]; }
+        // Returns the customers of route r in visiting order
+        const uint16_t* route(size_t r) const { return tour.data() + routeStarts[r]; }
+        // Returns the route containing node v, or noRoute
+        uint16_t routeOf(size_t v) const { return nodeRoute[v]; }
+        // Returns the position of node v within its route
+        uint16_t positionOf(size_t v) const { return nodePosition[v]; }
+        // Returns the nodes before and after node v in its route, 0 being the depot
+        size_t previous(size_t v) const{
+            return nodePosition[v] == 0 ? 0 : tour[routeStarts[nodeRoute[v]] + nodePosition[v] - 1];
+        }
+        size_t next(size_t v) const{
+            size_t r = nodeRoute[v];
+            return nodePosition[v] + 1u == routeLength(r) ? 0 : tour[routeStarts[r] + nodePosition[v] + 1];
+        }
+        // Returns the total demand of route r
+        int load(size_t r) const { return routeLoads[r]; }
+        // Returns the travel cost of route r
+        double routeCost(size_t r) const { return routeCosts[r]; }
+        // Returns the total travel cost of every route
+        double cost() const;
+        // Returns the total cost in the problem's units, which is cost() for exact distances; with another cost
+        // policy, the routes' length summed from the exact distances, euclidean or given as edge weights, that
+        // the policy rounded
+        double reportedCost() const;
+        // Returns the polar angle around the depot of the centroid of route r's customers, for ordering routes
+        // so that neighbouring routes are adjacent
+        double centroidAngle(size_t r) const;
+        // Returns the number of customers in any route
+        size_t routedCount() const { return tour.size(); }
+
+        // Appends an empty route and returns its index
+        size_t addRoute();
+        // Appends a route visiting 'count' customers in order
+        void appendRoute(const uint16_t* customers, size_t count);
+        // Replaces the customers of route r; customers no longer in it are left without a route
+        void setRoute(size_t r, const uint16_t* customers, size_t count);
+        // Inserts node v, which must not be in a route, into route r before the customer at 'position'
+        void insert(size_t v, size_t r, size_t position);
+        // Removes node v from its route
+        void remove(size_t v);
+        // Removes route r, leaving its customers without a route; later routes move down one index
+        void removeRoute(size_t r);
+        // Removes every route without customers
+        void removeEmptyRoutes();
+
+        // Returns the change in cost of inserting node v between the adjacent nodes a and b, either of which
+        // may be the depot
+        double insertionDelta(size_t v, size_t a, size_t b) const;
+        // Returns the change in cost of removing node v from its route
+        double removalDelta(size_t v) const;
+
+        // Returns true if every customer is in exactly one route and no route exceeds the vehicle capacity
+        bool isFeasible(uint16_t vehicleCapacity) const;
+        // Returns the equivalent solution made of vehicles
+        solution toSolution() const;
+        // Prints the solution in the same format as solution::printSolution
+        void printSolution(ostream& out) const;
+        // Returns the route r in the form "a->b->c->...->a", using node numbers
+        string getRouteString(size_t r) const;
+
+    private:
+        void indexRoute(size_t r, size_t fromPosition);
+        double computeRouteCost(size_t r) const;
+
+        const vector<node>* nodes;
+        const distanceCache* distances;
+        vector<uint16_t> tour;
+        // Offset of the first customer of each route in 'tour', with a final entry for the end of the buffer
+        vector<uint32_t> routeStarts;
+        vector<uint16_t> nodeRoute;
+        vector<uint16_t> nodePosition;
+        vector<int32_t> routeLoads;
+        vector<double> routeCosts;
+    };
+
+}
@@ -2,8 +2,15 @@
 #include <stdint.h>
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
 #include "cvrp.h"
+#include "distances.h"
+#include "kernels.h"
+#include "telemetry.h"
+#include "parallel.h"
 #include <iostream>
+#include <limits>
+#include <cmath>
 
 using namespace std;
 using namespace cvrp;
@@ -16,83 +23,317 @@ saving::saving(node depot, node a, node b){
     double abDist = cvrp::distance(a, b);
     saved = aDist + bDist - abDist;
 }
+saving::saving(uint16_t a, uint16_t b, double saved)
+    : nodeA(a), nodeB(b), saved(saved) {}
+saving::saving(node depot, node a, node b, const distanceCache& distances){
+    nodeA = a.num;
+    nodeB = b.num;
+    saved = distances(depot, a) + distances(depot, b) - distances(a, b);
+}
+
+// Returns each node's demand divided by the mean customer demand, the demand term of the generalized savings
+static vector<double> demandWeights(const vector<node>& nodes){
+    vector<double> weights(nodes.size(), 0);
+    double total = 0;
+    for (size_t i = 1; i < nodes.size(); i++) total += nodes[i].demand;
+    if (total <= 0) return weights;
+    double mean = total / (nodes.size() - 1);
+    for (size_t i = 1; i < nodes.size(); i++) weights[i] = nodes[i].demand / mean;
+    return weights;
+}
+
+// Returns the generalized saving of joining customers i and j
+static double generalizedSaving(double depotI, double depotJ, double distance, double demandI, double demandJ,
+                                const savingsParameters& parameters){
+    return depotI + depotJ - parameters.lambda*distance + parameters.mu*fabs(depotI - depotJ)
+         + parameters.nu*(demandI + demandJ);
+}
+
+// Returns the distances from node j to nodes 1 to j - 1: in place from a stored matrix of exact distances, or
+// otherwise computed into 'scratch' by the distance kernels, which is faster than widening a stored row of
+// floats or integers
+static inline const double* lowerRowDistances(const basicDistanceCache<exactCost>& distances, size_t j, vector<double>& scratch){
+    if (!distances.isComputed()) return distances.lowerRow(j) + 1;
+    distances.distancesFrom(j, 1, j, scratch.data());
+    return scratch.data();
+}
+template<typename Policy>
+static const double* lowerRowDistances(const basicDistanceCache<Policy>& distances, size_t j, vector<double>& scratch){
+    distances.distancesFrom(j, 1, j, scratch.data());
+    return scratch.data();
+}
+
+// Calls f(i, j, saved) for every pair of customer indices i < j, computing each lower row of savings with
+// a single vectorised kernel call, or for generalized savings, a scalar pass over the row's distances
+template<typename F>
+static void forEachSaving(const vector<double>& depotDistances, const distanceCache& distances,
+                          const savingsParameters& parameters, const vector<double>& demands, F f){
+    vector<double> rowSavings(depotDistances.size());
+    vector<double> rowDistances(depotDistances.size());
+    for (size_t j = 2; j < depotDistances.size(); j++){
+        const double* row = lowerRowDistances(distances, j, rowDistances);
+        if (parameters.isClassic()){
+            kernels::savingsRow(depotDistances.data() + 1, depotDistances[j], row, j - 1, rowSavings.data());
+        }
+        else{
+            for (size_t i = 1; i < j; i++){
+                rowSavings[i - 1] = generalizedSaving(depotDistances[i], depotDistances[j], row[i - 1], demands[i],
+                                                      demands[j], parameters);
+            }
+        }
+        for (size_t i = 1; i < j; i++){
+            f(i, j, rowSavings[i - 1]);
+        }
+    }
+}
 
 // Returns the complete list of savings between the nodes in 'nodes', sorted
 // by saving value ascending (the last element has the greatest saving)
 // Discounts the first node as the depot
 vector<saving> calculateSavings(const vector<node> nodes){
+    return calculateSavings(nodes, distanceCache(nodes, 0));
+}
+// As above, reading distances from a precomputed cache
+// The savings are bucket sorted: they are generated directly into buckets covering equal ranges of saving
+// value, and only the contents of each (small) bucket are then sorted. Equal savings are ordered with the
+// pair generated first placed last, matching the order produced by inserting each saving at its lower bound.
+vector<saving> calculateSavings(const vector<node>& nodes, const distanceCache& distances){
+    return calculateSavings(nodes, distances, savingsParameters());
+}
+vector<saving> calculateSavings(const vector<node>& nodes, const distanceCache& distances,
+                                const savingsParameters& parameters){
+    CVRP_SCOPE("savings");
     vector<saving> savings;
-    if (nodes.size() < 2) return savings;
-    savings.reserve(((nodes.size()-1)*(nodes.size()-2))/2);
-    for (size_t i = 1; i < nodes.size() - 1; i++){
-        for (size_t j = i + 1; j < nodes.size(); j++){
-            saving ijSaving(nodes[0], nodes[i], nodes[j]);
-            vector<saving>::iterator pos = lower_bound(savings.begin(), savings.end(), ijSaving);
-            savings.insert(pos, ijSaving);
+    if (nodes.size() < 3) return savings;
+    size_t savingCount = ((nodes.size()-1)*(nodes.size()-2))/2;
+    vector<double> depotDistances(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) depotDistances[i] = distances(0, i);
+    vector<double> demands = demandWeights(nodes);
+    double minSaved = numeric_limits<double>::max();
+    double maxSaved = numeric_limits<double>::lowest();
+    forEachSaving(depotDistances, distances, parameters, demands, [&](size_t, size_t, double saved){
+        minSaved = min(minSaved, saved);
+        maxSaved = max(maxSaved, saved);
+    });
+    // The bucket of a saving is a non-decreasing function of its value, so equal savings share a bucket
+    size_t bucketCount = max<size_t>(1, savingCount / savingsPerBucket);
+    double bucketScale = maxSaved > minSaved ? (bucketCount - 1) / (maxSaved - minSaved) : 0;
+    auto bucketOf = [&](double saved) { return min(bucketCount - 1, static_cast<size_t>((saved - minSaved) * bucketScale)); };
+    vector<size_t> bucketStart(bucketCount + 1, 0);
+    forEachSaving(depotDistances, distances, parameters, demands, [&](size_t, size_t, double saved){ bucketStart[bucketOf(saved) + 1]++; });
+    for (size_t b = 0; b < bucketCount; b++) bucketStart[b + 1] += bucketStart[b];
+    savings.resize(savingCount);
+    vector<size_t> bucketEnd(bucketStart.begin(), bucketStart.end() - 1);
+    forEachSaving(depotDistances, distances, parameters, demands, [&](size_t i, size_t j, double saved){
+        savings[bucketEnd[bucketOf(saved)]++] = saving(nodes[i].num, nodes[j].num, saved);
+    });
+    for (size_t b = 0; b < bucketCount; b++){
+        sort(savings.begin() + bucketStart[b], savings.begin() + bucketStart[b + 1], [](const saving& lhs, const saving& rhs){
+            if (lhs.saved != rhs.saved) return lhs.saved < rhs.saved;
+            if (lhs.nodeA != rhs.nodeA) return lhs.nodeA > rhs.nodeA;
+            return lhs.nodeB > rhs.nodeB;
+        });
+    }
+    CVRP_COUNT(savingsGenerated, savingCount);
+    return savings;
+}
+
+// Each pair of customers appears once, even when each is among the other's nearest neighbours. Equal savings
+// are ordered by node numbers so that the order does not depend on the sort implementation.
+vector<compactSaving> calculateSparseSavings(const vector<node>& nodes, const distanceCache& distances,
+                                             size_t neighbourCount, const savingsParameters& parameters){
+    CVRP_SCOPE("savings");
+    vector<compactSaving> savings;
+    vector<double> demands = demandWeights(nodes);
+    // A cache holding every other node for each node has all the neighbours there are
+    if (neighbourCount > distances.neighbourCount() && distances.neighbourCount() + 1 < nodes.size()){
+        throw invalid_argument("Sparse savings need more neighbours than the distance cache holds.");
+    }
+    size_t k = min(neighbourCount, distances.neighbourCount());
+    savings.reserve(nodes.size() * k);
+    for (size_t i = 1; i < nodes.size(); i++){
+        const uint16_t* neighbours = distances.neighbours(i);
+        for (size_t n = 0; n < k; n++){
+            size_t j = neighbours[n];
+            if (j == 0) continue;
+            // A pair found from both ends is kept from the lower index
+            if (j < i){
+                const uint16_t* reverse = distances.neighbours(j);
+                if (find(reverse, reverse + k, i) != reverse + k) continue;
+            }
+            compactSaving s;
+            s.nodeA = nodes[min(i, j)].num;
+            s.nodeB = nodes[max(i, j)].num;
+            s.saved = static_cast<float>(generalizedSaving(distances(0, i), distances(0, j), distances(i, j),
+                                                           demands[i], demands[j], parameters));
+            savings.push_back(s);
         }
     }
+    sort(savings.begin(), savings.end(), [](const compactSaving& lhs, const compactSaving& rhs){
+        if (lhs.saved != rhs.saved) return lhs.saved < rhs.saved;
+        if (lhs.nodeA != rhs.nodeA) return lhs.nodeA > rhs.nodeA;
+        return lhs.nodeB > rhs.nodeB;
+    });
+    CVRP_COUNT(savingsGenerated, savings.size());
     return savings;
 }
 
 // Given the set of nodes (with the first node being the depot) and their corresponding savings,
 // returns the heuristic solution given by the Clarke-Wright algorithm
-solution calculateClarkeWrightSolution(const vector<node>& nodes, vector<saving> savings, uint16_t vehicleCapacity){
+// Savings are applied in a single pass from greatest to least: a saving that cannot be applied when it is
+// reached can never be applied later, as routes only grow and nodes only stop being route endpoints.
+// Each route is tracked by the index of the single-customer vehicle it started as, and only needs its
+// endpoints and load to be known while merging, so every saving is checked and applied in constant time.
+// Runs the Clarke-Wright algorithm and calls f(customers, count) with the node indices of each route in turn
+template<typename S, typename F>
+static void forEachClarkeWrightRoute(const vector<node>& nodes, const vector<S>& savings, uint16_t vehicleCapacity,
+                                     F f){
+    if (nodes.size() < 2) return;
+    size_t customerCount = nodes.size() - 1;
+    // Route state, indexed by route
+    vector<uint16_t> routeFirst(customerCount);
+    vector<uint16_t> routeLast(customerCount);
+    vector<uint32_t> routeLoad(customerCount);
+    vector<bool> routeUsed(customerCount, true);
+    // Node state, indexed by node index (num - 1); routeOf is only kept up to date for route endpoints
+    vector<size_t> routeOf(nodes.size());
+    vector<bool> interior(nodes.size(), false);
+    // The (up to two) customers adjacent to each customer, in no particular order; 0 marks the depot
+    vector<uint16_t> linkA(nodes.size(), 0);
+    vector<uint16_t> linkB(nodes.size(), 0);
+    for (size_t r = 0; r < customerCount; r++){
+        routeFirst[r] = routeLast[r] = static_cast<uint16_t>(r + 1);
+        routeLoad[r] = nodes[r + 1].demand;
+        routeOf[r + 1] = r;
+    }
+    size_t merges = 0;
+    for (auto s = savings.rbegin(); s != savings.rend(); ++s){
+        size_t a = s->nodeA - 1;
+        size_t b = s->nodeB - 1;
+        if (interior[a] || interior[b]) continue;
+        size_t routeA = routeOf[a];
+        size_t routeB = routeOf[b];
+        if (routeA == routeB || routeLoad[routeA] + routeLoad[routeB] > vehicleCapacity) continue;
+        // Orient route A so that it ends at a, and route B so that it starts at b
+        if (routeLast[routeA] != a) swap(routeFirst[routeA], routeLast[routeA]);
+        if (routeLast[routeB] == b) swap(routeFirst[routeB], routeLast[routeB]);
+        // Nodes stop being endpoints when they join a route containing other customers
+        if (routeFirst[routeA] != a) interior[a] = true;
+        if (routeLast[routeB] != b) interior[b] = true;
+        (linkA[a] == 0 ? linkA[a] : linkB[a]) = static_cast<uint16_t>(b);
+        (linkA[b] == 0 ? linkA[b] : linkB[b]) = static_cast<uint16_t>(a);
+        routeLast[routeA] = routeLast[routeB];
+        routeLoad[routeA] += routeLoad[routeB];
+        routeOf[routeLast[routeA]] = routeA;
+        routeUsed[routeB] = false;
+        merges++;
+    }
+    CVRP_COUNT(routeMerges, merges);
+    // Walk each remaining route from its first customer
+    vector<uint16_t> route;
+    for (size_t r = 0; r < customerCount; r++){
+        if (!routeUsed[r]) continue;
+        route.clear();
+        size_t prev = 0;
+        size_t current = routeFirst[r];
+        while (current != 0){
+            route.push_back(static_cast<uint16_t>(current));
+            size_t next = linkA[current] != prev ? linkA[current] : linkB[current];
+            prev = current;
+            current = next;
+        }
+        f(route.data(), route.size());
+    }
+}
+
+solution calculateClarkeWrightSolution(const vector<node>& nodes, const vector<saving>& savings, uint16_t vehicleCapacity){
+    CVRP_SCOPE("clarkeWright");
     solution result;
-    for (size_t i = 1; i < nodes.size(); i++){
+    forEachClarkeWrightRoute(nodes, savings, vehicleCapacity, [&](const uint16_t* customers, size_t count){
         result.vehicles.emplace_back(nodes[0]);
-        result.vehicles.back().route.insert(result.vehicles.back().route.end(), nodes[i]);
+        vector<node>& route = result.vehicles.back().route;
+        for (size_t p = 0; p < count; p++) route.push_back(nodes[customers[p]]);
+    });
+    return result;
+}
+
+compactSolution calculateClarkeWrightRoutes(const vector<node>& nodes, const vector<saving>& savings,
+                                            uint16_t vehicleCapacity, const distanceCache& distances){
+    CVRP_SCOPE("clarkeWright");
+    compactSolution result(nodes, distances);
+    forEachClarkeWrightRoute(nodes, savings, vehicleCapacity, [&](const uint16_t* customers, size_t count){
+        result.appendRoute(customers, count);
+    });
+    return result;
+}
+
+compactSolution calculateClarkeWrightRoutes(const vector<node>& nodes, const vector<compactSaving>& savings,
+                                            uint16_t vehicleCapacity, const distanceCache& distances){
+    CVRP_SCOPE("clarkeWright");
+    compactSolution result(nodes, distances);
+    forEachClarkeWrightRoute(nodes, savings, vehicleCapacity, [&](const uint16_t* customers, size_t count){
+        result.appendRoute(customers, count);
+    });
+    return result;
+}
+
+compactSolution clarkeWrightRoutes(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                   size_t savingsNeighbours, const savingsParameters& parameters){
+    if (savingsNeighbours == 0 && nodes.size() < sparseSavingsThreshold){
+        return calculateClarkeWrightRoutes(nodes, calculateSavings(nodes, distances, parameters), vehicleCapacity,
+                                           distances);
     }
-    bool nodesMatched = true;
-    // At the end of each loop:
-    //   'savings' only contains savings for nodes that can be "attached" to other routes,
-    //   i.e. are the first or last node visited by their respective vehicle
-    //   'result' is a valid solution
-    while (nodesMatched){
-        nodesMatched = false;
-        for (int s = savings.size() - 1; s >= 0; s--){
-            uint16_t nodeA = savings[s].nodeA;
-            uint16_t nodeB = savings[s].nodeB;
-            auto vehicleA = result.containingVehicle(nodeA);
-            auto vehicleB = result.containingVehicle(nodeB);
-            uint16_t totalCapacity = vehicleA->usedCapacity() + vehicleB->usedCapacity();
-            // Merge the paths of vehicleA and vehicleB into vehicleA, such that nodeA and nodeB are adjacent, and remove vehicleB
-            if (totalCapacity <= vehicleCapacity && vehicleA != vehicleB){
-                vector<node> routeA = vehicleA->route;
-                vector<node> routeB = vehicleB->route;
-                // Remove savings containing nodeA and nodeB if they are no longer the first or last node of their
-                // respective vehicle, i.e. if their current vehicle's route does not contain only them, and remove
-                // the current saving
-                savings.erase(savings.begin() + s);
-                if (routeA.size() > 2){
-                    auto newEnd = remove_if(savings.begin(), savings.end(), [&](const saving& sav) { return sav.contains(nodeA); });
-                    savings.erase(newEnd, savings.end());
-                }
-                if (routeB.size() > 2){
-                    auto newEnd = remove_if(savings.begin(), savings.end(), [&](const saving& sav) { return sav.contains(nodeB); });
-                    savings.erase(newEnd, savings.end());
-                }
-                // WARNING: From this point onwards, previously defined references to elements of 'savings' are invalid.
-                // Set routeA so that the depot is at the front and nodeA is at the end
-                if (routeA.back().num != nodeA){
-                    reverse(routeA.begin()+1, routeA.end());
-                }
-                // Set routeB so that the depot is removed and nodeB is at the front
-                if (routeB.back().num != nodeB){
-                    routeB.erase(routeB.begin(), routeB.begin()+1);
-                }
-                else{
-                    reverse(routeB.begin(), routeB.end());
-                    routeB.pop_back();
-                }
-                // Combine the two routes such that nodeA and nodeB are adjacent, merge the result into vehicle A, and erase vehicle B
-                routeA.insert(routeA.end(), routeB.begin(), routeB.end());
-                vehicleA->route = routeA;
-                result.vehicles.erase(vehicleB, vehicleB + 1);
-                // Start back from the top of the loop
-                nodesMatched = true;
-                break;
+    size_t k = savingsNeighbours ? savingsNeighbours : defaultSparseSavingsNeighbours;
+    return calculateClarkeWrightRoutes(nodes, calculateSparseSavings(nodes, distances, k, parameters), vehicleCapacity,
+                                       distances);
+}
+
+vector<savingsParameters> defaultSavingsGrid(){
+    vector<savingsParameters> grid;
+    for (int lambda = 6; lambda <= 16; lambda += 2){
+        for (int mu = 0; mu <= 10; mu += 5){
+            for (int nu = 0; nu <= 5; nu += 5){
+                grid.push_back(savingsParameters(lambda / 10.0, mu / 10.0, nu / 10.0));
             }
         }
     }
-    return result;
+    return grid;
+}
+
+// Every parameter set is a task of its own, so the pool balances the (equal sized) tasks itself. Each worker
+// holds at most one savings list at a time besides its best solution.
+savingsSweepResult sweepClarkeWright(const vector<node>& nodes, uint16_t vehicleCapacity,
+                                     const distanceCache& distances, const vector<savingsParameters>& grid,
+                                     size_t threads, size_t savingsNeighbours){
+    savingsSweepResult result;
+    if (grid.empty()){
+        result.solution = clarkeWrightRoutes(nodes, vehicleCapacity, distances, savingsNeighbours);
+        result.cost = result.solution.cost();
+        return result;
+    }
+    threadPool pool(min(threads ? threads : thread::hardware_concurrency(), grid.size()));
+    // Each worker's best cost and the index of the parameter set giving it
+    vector<savingsSweepResult> best(pool.size());
+    vector<size_t> bestIndex(pool.size(), grid.size());
+    for (size_t g = 0; g < grid.size(); g++){
+        pool.submit([&, g](size_t worker){
+            compactSolution candidate = clarkeWrightRoutes(nodes, vehicleCapacity, distances, savingsNeighbours,
+                                                           grid[g]);
+            double cost = candidate.cost();
+            if (bestIndex[worker] < grid.size() && (cost > best[worker].cost
+                || (cost == best[worker].cost && g > bestIndex[worker]))) return;
+            best[worker].solution = move(candidate);
+            best[worker].parameters = grid[g];
+            best[worker].cost = cost;
+            bestIndex[worker] = g;
+        });
+    }
+    pool.wait();
+    size_t winner = 0;
+    for (size_t w = 1; w < best.size(); w++){
+        if (bestIndex[w] == grid.size()) continue;
+        if (bestIndex[winner] == grid.size() || best[w].cost < best[winner].cost
+            || (best[w].cost == best[winner].cost && bestIndex[w] < bestIndex[winner])) winner = w;
+    }
+    return best[winner];
 }
@@ -4,18 +4,50 @@
 #include <vector>
 #include <algorithm>
 #include "cvrp.h"
+#include "distances.h"
+#include "routes.h"
 
 using namespace cvrp;
 
+// Average number of savings per bucket when sorting the savings list
+const size_t savingsPerBucket = 64;
+
+// Weights of the generalized savings
+//   s(a, b) = d(0, a) + d(0, b) - lambda*d(a, b) + mu*|d(0, a) - d(0, b)| + nu*(q(a) + q(b))/q
+// where q(a) is the demand of a and q the mean customer demand. The defaults give the classic savings.
+struct savingsParameters{
+    savingsParameters()
+        : lambda(1), mu(0), nu(0) {}
+    savingsParameters(double lambda, double mu, double nu)
+        : lambda(lambda), mu(mu), nu(nu) {}
+    bool isClassic() const { return lambda == 1 && mu == 0 && nu == 0; }
+    // Weight of the distance between the two customers
+    double lambda;
+    // Weight of the asymmetry of their distances from the depot
+    double mu;
+    // Weight of their combined demand
+    double nu;
+};
+
 class saving{
 public:
+    saving() {}
     saving(node depot, node a, node b);
+    saving(node depot, node a, node b, const distanceCache& distances);
+    saving(uint16_t a, uint16_t b, double saved);
     bool contains(uint16_t n) const { return n == nodeA || n == nodeB; }
     uint16_t nodeA;
     uint16_t nodeB;
     double saved;
 };
 
+// A saving packed into 8 bytes, for savings lists on large instances
+struct compactSaving{
+    uint16_t nodeA;
+    uint16_t nodeB;
+    float saved;
+};
+
 inline bool operator< (const saving& lhs, const saving& rhs){ return lhs.saved < rhs.saved; }
 inline bool operator> (const saving& lhs, const saving& rhs){ return rhs < lhs; }
 inline bool operator<=(const saving& lhs, const saving& rhs){ return !(lhs > rhs); }
@@ -25,8 +57,58 @@ inline bool operator>=(const saving& lhs, const saving& rhs){ return !(lhs < rhs
 // by saving value ascending (the last element has the greatest saving)
 // Discounts the first node as the depot
 vector<saving> calculateSavings(const vector<node> nodes);
+// As above, reading distances from a precomputed cache
+vector<saving> calculateSavings(const vector<node>& nodes, const distanceCache& distances);
+// As above, with generalized savings
+vector<saving> calculateSavings(const vector<node>& nodes, const distanceCache& distances,
+                                const savingsParameters& parameters);
+
+// Number of nearest neighbours each customer's savings are taken from in a sparse savings list, unless
+// otherwise requested
+const size_t defaultSparseSavingsNeighbours = 30;
+// Node count from which Clarke-Wright solutions are built from a sparse savings list unless otherwise requested,
+// as the complete list grows with the square of the node count
+const size_t sparseSavingsThreshold = 8192;
+
+// Returns the savings between each customer and its 'neighbourCount' nearest customers, sorted by saving value
+// ascending as calculateSavings. Memory is linear in the number of nodes. Throws invalid_argument if
+// 'distances' holds fewer neighbours per node than asked for, unless it holds every node.
+vector<compactSaving> calculateSparseSavings(const vector<node>& nodes, const distanceCache& distances,
+                                             size_t neighbourCount = defaultSparseSavingsNeighbours,
+                                             const savingsParameters& parameters = savingsParameters());
 
 // Given the set of nodes (with the first node being the depot) and their corresponding savings,
 // returns the heuristic solution given by the Clarke-Wright algorithm
-solution calculateClarkeWrightSolution(const vector<node>& nodes, vector<saving> savings, uint16_t vehicleCapacity);
+solution calculateClarkeWrightSolution(const vector<node>& nodes, const vector<saving>& savings, uint16_t vehicleCapacity);
+// As above, returning a compact solution over the given distances
+compactSolution calculateClarkeWrightRoutes(const vector<node>& nodes, const vector<saving>& savings,
+                                            uint16_t vehicleCapacity, const distanceCache& distances);
+// As above, from a sparse savings list; customers without an applicable saving are left in routes of their own
+compactSolution calculateClarkeWrightRoutes(const vector<node>& nodes, const vector<compactSaving>& savings,
+                                            uint16_t vehicleCapacity, const distanceCache& distances);
+// Returns the Clarke-Wright solution from the savings between each customer and its 'savingsNeighbours'
+// nearest neighbours, or if that is 0, from the complete savings list below sparseSavingsThreshold nodes and
+// the defaultSparseSavingsNeighbours nearest above it
+compactSolution clarkeWrightRoutes(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                   size_t savingsNeighbours = 0,
+                                   const savingsParameters& parameters = savingsParameters());
+
+// The default grid of a savings parameter sweep: lambda from 0.6 to 1.6, mu from 0 to 1 and nu from 0 to 0.5
+vector<savingsParameters> defaultSavingsGrid();
+
+struct savingsSweepResult{
+    savingsSweepResult()
+        : cost(0) {}
+    compactSolution solution;
+    savingsParameters parameters;
+    double cost;
+};
+
+// Builds the Clarke-Wright solution for every parameter set of 'grid', as clarkeWrightRoutes, on 'threads'
+// worker threads (one per hardware thread if 0) sharing 'distances', and returns the cheapest. Each worker
+// keeps only its own best solution, and equal costs are resolved in favour of the earlier parameter set, so
+// the result does not depend on the number of threads.
+savingsSweepResult sweepClarkeWright(const vector<node>& nodes, uint16_t vehicleCapacity,
+                                     const distanceCache& distances, const vector<savingsParameters>& grid,
+                                     size_t threads = 0, size_t savingsNeighbours = 0);
 
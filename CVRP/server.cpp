@@ -0,0 +1,248 @@
+#include "server.h"
+#include "parser.h"
+#include <sstream>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    // Returns the value of a SOLVE setting as a count
+    size_t countSetting(const string& key, const string& value){
+        size_t end = 0;
+        unsigned long count = 0;
+        try{
+            count = stoul(value, &end);
+        }
+        catch (const exception&){}
+        if (value.empty() || end != value.size() || value[0] == '-') throw invalid_argument("Setting " + key + " needs a count.");
+        return count;
+    }
+
+    // Returns the value of a SOLVE setting as a count of at most 'limit'
+    size_t boundedSetting(const string& key, const string& value, size_t limit){
+        size_t count = countSetting(key, value);
+        if (count > limit) throw invalid_argument("Setting " + key + " is limited to " + to_string(limit) + ".");
+        return count;
+    }
+
+    // Returns the value of a SOLVE setting as a number of seconds
+    double secondsSetting(const string& key, const string& value){
+        size_t end = 0;
+        double seconds = -1;
+        try{
+            seconds = stod(value, &end);
+        }
+        catch (const exception&){}
+        if (end != value.size() || !(seconds >= 0)) throw invalid_argument("Setting " + key + " needs a number of seconds.");
+        return seconds;
+    }
+
+    // Returns the value of a SOLVE setting as a flag
+    bool flagSetting(const string& key, const string& value){
+        if (value != "0" && value != "1") throw invalid_argument("Setting " + key + " needs 0 or 1.");
+        return value == "1";
+    }
+
+}
+
+string cvrp::handleRequest(const string& request, serverState& state){
+    ostringstream response;
+    try{
+        size_t headerEnd = request.find('\n');
+        string header = request.substr(0, headerEnd);
+        if (!header.empty() && header.back() == '\r') header.pop_back();
+        istringstream words(header);
+        string command;
+        words >> command;
+        if (command == "PING") return "ok\n";
+        if (command == "SHUTDOWN"){
+            state.shutdown = true;
+            return "ok\n";
+        }
+        if (command != "SOLVE") throw invalid_argument("Unknown request " + command + ".");
+        solveOptions options;
+        string setting;
+        while (words >> setting){
+            size_t equals = setting.find('=');
+            if (equals == string::npos) throw invalid_argument("Setting " + setting + " has no value.");
+            string key = setting.substr(0, equals), value = setting.substr(equals + 1);
+            if (key == "algorithm") options.algorithm = value;
+            else if (key == "seed") options.seed = static_cast<unsigned>(countSetting(key, value));
+            else if (key == "threads") options.threads = boundedSetting(key, value, state.maxThreads);
+            else if (key == "starts") options.starts = max<size_t>(1, boundedSetting(key, value, state.maxThreads));
+            else if (key == "elite") options.eliteSize = boundedSetting(key, value, state.maxThreads);
+            else if (key == "time-limit") options.timeLimit = secondsSetting(key, value);
+            else if (key == "iteration-limit") options.iterationLimit = countSetting(key, value);
+            else if (key == "local-search") options.localSearch = flagSetting(key, value);
+            else if (key == "route-optimization") options.routeOptimization = flagSetting(key, value);
+            else throw invalid_argument("Unknown setting " + key + ".");
+        }
+        if (options.threads == 0) options.threads = state.maxThreads;
+        if (headerEnd == string::npos) throw invalid_argument("SOLVE needs a problem.");
+        problemParameters problem = parseProblem(request.data() + headerEnd + 1, request.size() - headerEnd - 1, "request");
+        validateProblem(problem.nodes, problem.capacity);
+        bool reused = false;
+        shared_ptr<const distanceCache> distances = state.caches.acquire(problem.nodes, problem.edgeWeights, reused);
+        compactSolution solved = solveProblem(problem.nodes, static_cast<uint16_t>(problem.capacity), *distances, options,
+                                              &state.workspace);
+        response << "ok " << (reused ? "reused" : "computed") << '\n';
+        solved.printSolution(response);
+    }
+    catch (const exception& e){
+        return string("error ") + e.what() + '\n';
+    }
+    return response.str();
+}
+
+#ifdef _WIN32
+
+void cvrp::serve(const serverOptions&, const atomic<bool>*, ostream*){
+    throw runtime_error("The solve server needs Unix domain sockets.");
+}
+
+#else
+
+namespace{
+
+    // Interval at which a server given a stop flag checks it while waiting for connections
+    const int stopCheckMilliseconds = 200;
+
+#ifdef MSG_NOSIGNAL
+    const int sendFlags = MSG_NOSIGNAL;
+#else
+    const int sendFlags = 0;
+#endif
+
+    // Closes a file descriptor when it goes out of scope
+    class descriptor{
+    public:
+        explicit descriptor(int fd)
+            : fd(fd) {}
+        ~descriptor() { if (fd >= 0) close(fd); }
+        descriptor(const descriptor&) = delete;
+        descriptor& operator=(const descriptor&) = delete;
+        int get() const { return fd; }
+    private:
+        int fd;
+    };
+
+    // Removes the socket file when the server stops, however it stops
+    class socketFile{
+    public:
+        explicit socketFile(const string& path)
+            : path(path) {}
+        ~socketFile() { unlink(path.c_str()); }
+    private:
+        string path;
+    };
+
+    enum readResult { requestRead, requestUnreadable, requestTimedOut };
+
+    // Reads a request until the client shuts down its side for writing, giving up if it cannot be read, is too
+    // large or is not complete by 'deadline'
+    readResult readRequest(int client, chrono::steady_clock::time_point deadline, string& request){
+        char buffer[65536];
+        while (true){
+            chrono::milliseconds remaining = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now());
+            if (remaining.count() <= 0) return requestTimedOut;
+            pollfd waiting = { client, POLLIN, 0 };
+            int ready = poll(&waiting, 1, static_cast<int>(min<chrono::milliseconds::rep>(remaining.count(), INT_MAX)));
+            if (ready < 0){
+                if (errno == EINTR) continue;
+                return requestUnreadable;
+            }
+            if (ready == 0) return requestTimedOut;
+            ssize_t count = read(client, buffer, sizeof(buffer));
+            if (count == 0) return requestRead;
+            if (count < 0){
+                if (errno == EINTR) continue;
+                return requestUnreadable;
+            }
+            if (request.size() + count > maxRequestBytes) return requestUnreadable;
+            request.append(buffer, count);
+        }
+    }
+
+    // Writes the whole response, giving up if the client has gone
+    void writeResponse(int client, const string& response){
+        size_t written = 0;
+        while (written < response.size()){
+            ssize_t count = send(client, response.data() + written, response.size() - written, sendFlags);
+            if (count < 0){
+                if (errno == EINTR) continue;
+                return;
+            }
+            written += count;
+        }
+    }
+
+}
+
+void cvrp::serve(const serverOptions& options, const atomic<bool>* stop, ostream* log){
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    const string& path = options.socketPath;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) throw runtime_error("Socket path is empty or too long.");
+    memcpy(address.sun_path, path.c_str(), path.size());
+    descriptor listener(socket(AF_UNIX, SOCK_STREAM, 0));
+    if (listener.get() < 0) throw runtime_error("Socket could not be created.");
+    // Only a socket left behind by an earlier server is replaced, never another kind of file
+    struct stat existing;
+    if (lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) unlink(path.c_str());
+    if (bind(listener.get(), reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0){
+        throw runtime_error("Socket could not be bound to " + path + ".");
+    }
+    socketFile removeOnExit(path);
+    if (listen(listener.get(), SOMAXCONN) != 0) throw runtime_error("Socket could not be listened on.");
+
+    serverState state(options.cachedProblems, options.maxThreads);
+    chrono::steady_clock::duration requestTimeout = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(options.requestTimeout));
+    size_t served = 0;
+    while (!state.shutdown){
+        if (stop){
+            if (stop->load()) break;
+            pollfd waiting = { listener.get(), POLLIN, 0 };
+            int ready = poll(&waiting, 1, stopCheckMilliseconds);
+            if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+        }
+        descriptor client(accept(listener.get(), nullptr, nullptr));
+        if (client.get() < 0){
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            throw runtime_error("Connection could not be accepted.");
+        }
+#ifdef SO_NOSIGPIPE
+        int noSignal = 1;
+        setsockopt(client.get(), SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        string request, response;
+        switch (readRequest(client.get(), start + requestTimeout, request)){
+        case requestRead: response = handleRequest(request, state); break;
+        case requestUnreadable: response = "error Request could not be read or is too large.\n"; break;
+        case requestTimedOut: response = "error Request was not received in time.\n"; break;
+        }
+        writeResponse(client.get(), response);
+        if (log){
+            chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+            *log << "request " << ++served << ": " << response.substr(0, response.find('\n')) << " in "
+                 << elapsed.count() * 1000 << " ms" << endl;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include "service.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Number of problems whose distances the solve server keeps for later requests
+    const size_t defaultCachedProblems = 4;
+    // Largest request the solve server reads
+    const size_t maxRequestBytes = size_t(256) << 20;
+    // Seconds a client has to send its whole request
+    const double defaultRequestTimeout = 30;
+
+    struct serverOptions{
+        serverOptions()
+            : cachedProblems(defaultCachedProblems), maxThreads(max(1u, thread::hardware_concurrency())),
+              requestTimeout(defaultRequestTimeout) {}
+        // Path of the Unix domain socket to listen on
+        string socketPath;
+        size_t cachedProblems;
+        // Largest threads, starts or elite setting a request may give, which also replaces threads=0
+        size_t maxThreads;
+        // Seconds after which a request that has not been received in full is answered with an error
+        double requestTimeout;
+    };
+
+    // State kept by the solve server from one request to the next: the distance caches of recent problems and
+    // the scratch space of single-search solves
+    struct serverState{
+        serverState(size_t cachedProblems, size_t maxThreads)
+            : caches(cachedProblems), maxThreads(max<size_t>(1, maxThreads)), shutdown(false) {}
+        distanceCachePool caches;
+        tabu::searchWorkspace workspace;
+        size_t maxThreads;
+        // Set by a SHUTDOWN request
+        bool shutdown;
+    };
+
+    // Handles the text of one request and returns the response. A request is one of
+    //   PING
+    //   SHUTDOWN
+    //   SOLVE [algorithm=tabu|hgs|decompose] [seed=S] [threads=N] [starts=N] [elite=N] [time-limit=SECONDS]
+    //         [iteration-limit=N] [local-search=0|1] [route-optimization=0|1]
+    // on its first line, a SOLVE line being followed by the problem in TSPLIB/CVRPLIB format. The response's
+    // first line is "ok", or for a SOLVE, "ok reused" or "ok computed" depending on whether the problem's
+    // distances were already held, followed by the solution as printed by printSolution. A request that
+    // cannot be served, including one whose threads, starts or elite exceed state.maxThreads, is answered with
+    // "error" and the reason.
+    string handleRequest(const string& request, serverState& state);
+
+    // Serves requests over a Unix domain socket, one connection at a time, until a SHUTDOWN request or until
+    // 'stop' is set. A client writes one request, shuts down its side of the connection for writing, and reads
+    // the response until the server closes the connection. A client that has not sent its whole request within
+    // options.requestTimeout seconds is answered with an error, so that it cannot hold up the clients after
+    // it. Each request is logged to 'log' if it is given.
+    // Throws runtime_error if the socket cannot be set up; an existing socket at the path is replaced.
+    void serve(const serverOptions& options, const atomic<bool>* stop = nullptr, ostream* log = nullptr);
+
+}
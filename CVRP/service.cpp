@@ -0,0 +1,89 @@
+#include "service.h"
+#include "hgs.h"
+#include "decomposition.h"
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+using namespace cvrp;
+
+void cvrp::validateProblem(const vector<node>& nodes, int vehicleCapacity){
+    if (nodes.size() < 2) throw invalid_argument("A problem needs a depot and at least one customer.");
+    if (nodes.size() > UINT16_MAX) throw invalid_argument("A problem can have at most 65535 nodes.");
+    if (vehicleCapacity <= 0 || vehicleCapacity > UINT16_MAX) throw invalid_argument("Vehicle capacity is out of range.");
+    for (size_t i = 0; i < nodes.size(); i++){
+        if (nodes[i].num != i + 1) throw invalid_argument("Nodes must be numbered from 1 in order.");
+        if (nodes[i].demand > vehicleCapacity) throw invalid_argument("A customer's demand exceeds the vehicle capacity.");
+    }
+}
+
+compactSolution cvrp::solveProblem(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                   const solveOptions& options, tabu::searchWorkspace* workspace){
+    validateProblem(nodes, vehicleCapacity);
+    tabu::searchControl control;
+    if (options.timeLimit > 0) control.setTimeLimit(options.timeLimit);
+    control.iterationLimit = options.iterationLimit;
+    control.localSearch = options.localSearch;
+    control.routeOptimization = options.routeOptimization;
+    control.sweepThreads = options.threads;
+    if (options.algorithm == "hgs"){
+        hgs::geneticOptions genetic;
+        genetic.threads = options.threads;
+        genetic.seed = options.seed;
+        return hgs::solve(nodes, vehicleCapacity, distances, genetic, control);
+    }
+    if (options.algorithm == "decompose"){
+        decomposition::decompositionOptions decompose;
+        decompose.threads = options.threads;
+        decompose.seed = options.seed;
+        return decomposition::solve(nodes, vehicleCapacity, distances, decompose, control);
+    }
+    if (options.algorithm != "tabu") throw invalid_argument("Unknown algorithm " + options.algorithm + ".");
+    if (options.starts > 1 || options.eliteSize > 0){
+        tabu::multiStartOptions multiStart;
+        multiStart.starts = options.starts;
+        multiStart.threads = options.threads;
+        multiStart.seed = options.seed;
+        multiStart.eliteSize = options.eliteSize;
+        return tabu::multiStartTaburoute(nodes, vehicleCapacity, distances, multiStart, control);
+    }
+    control.workspace = workspace;
+    default_random_engine rng(options.seed);
+    return tabu::taburoute(nodes, vehicleCapacity, distances, rng, control);
+}
+
+distanceCachePool::distanceCachePool(size_t capacity)
+    : capacity(max<size_t>(1, capacity)) {}
+
+shared_ptr<const distanceCache> distanceCachePool::acquire(const vector<node>& nodes, const vector<double>& weights,
+                                                           bool& reused){
+    vector<float> coordinates;
+    coordinates.reserve(2 * nodes.size());
+    for (const node& n : nodes){
+        coordinates.push_back(n.x);
+        coordinates.push_back(n.y);
+    }
+    // FNV-1a over the bytes of the coordinates and weights
+    uint64_t hash = 14695981039346656037ull;
+    auto addBytes = [&](const void* data, size_t size){
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+    addBytes(coordinates.data(), coordinates.size() * sizeof(float));
+    addBytes(weights.data(), weights.size() * sizeof(double));
+    for (auto e = entries.begin(); e != entries.end(); ++e){
+        if (e->hash != hash || e->coordinates != coordinates || e->weights != weights) continue;
+        entries.splice(entries.begin(), entries, e);
+        reused = true;
+        return entries.front().distances;
+    }
+    entry added;
+    added.hash = hash;
+    added.distances = make_shared<distanceCache>(nodes, weights);
+    added.coordinates.swap(coordinates);
+    added.weights = weights;
+    entries.push_front(move(added));
+    if (entries.size() > capacity) entries.pop_back();
+    reused = false;
+    return entries.front().distances;
+}
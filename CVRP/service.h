@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include "cvrp.h"
+#include "distances.h"
+#include "routes.h"
+#include "tabu.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Settings of a solve made through the library or the solve server
+    struct solveOptions{
+        solveOptions()
+            : algorithm("tabu"), seed(0), threads(0), starts(1), eliteSize(0), timeLimit(0), iterationLimit(0),
+              localSearch(true), routeOptimization(true) {}
+        // "tabu", "hgs" or "decompose"
+        string algorithm;
+        unsigned seed;
+        // Number of worker threads, or 0 for one per hardware thread; a Taburoute solve with a single start and
+        // no elite pool runs one search on the calling thread
+        size_t threads;
+        // Number of Taburoute searches run in parallel, and the size of the elite pool they share (0 for none)
+        size_t starts;
+        size_t eliteSize;
+        // Seconds after which the best solution found so far is returned (0 for no limit)
+        double timeLimit;
+        // Overrides the default iteration count of each search if nonzero
+        size_t iterationLimit;
+        bool localSearch;
+        bool routeOptimization;
+    };
+
+    // Throws invalid_argument unless the nodes are a depot followed by at least one customer, numbered from 1 in
+    // order, and the capacity is positive, fits a vehicle and is at least every customer's demand
+    void validateProblem(const vector<node>& nodes, int vehicleCapacity);
+
+    // Solves a problem with the algorithm and settings of 'options', using 'workspace', if given, as the scratch
+    // space of a single Taburoute search. Throws invalid_argument for an unknown algorithm or invalid problem.
+    compactSolution solveProblem(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                 const solveOptions& options, tabu::searchWorkspace* workspace = nullptr);
+
+    // Distance caches of recently solved problems, so that a later problem with the same nodes reuses a cache
+    // instead of computing its distances again. Caches are matched by the node coordinates and edge weights,
+    // which are all the distances depend on, so problems that differ only in demands or capacity share one.
+    // The least recently used cache is dropped once more than 'capacity' are held. Not safe for concurrent use.
+    class distanceCachePool{
+    public:
+        explicit distanceCachePool(size_t capacity);
+        // Returns the cache for the given nodes and row-major edge weights (empty for euclidean distances),
+        // building it if none is held, and sets 'reused' if one was
+        shared_ptr<const distanceCache> acquire(const vector<node>& nodes, const vector<double>& weights, bool& reused);
+        // Returns the number of caches held
+        size_t size() const { return entries.size(); }
+    private:
+        struct entry{
+            uint64_t hash;
+            vector<float> coordinates;
+            vector<double> weights;
+            shared_ptr<const distanceCache> distances;
+        };
+        // Most recently used first
+        list<entry> entries;
+        size_t capacity;
+    };
+
+}
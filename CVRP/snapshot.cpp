@@ -0,0 +1,408 @@
+#include "snapshot.h"
+#include "mappedfile.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <memory>
+
+using namespace std;
+using namespace cvrp;
+
+namespace{
+
+    const char magic[8] = { 'C', 'V', 'R', 'P', 'S', 'N', 'A', 'P' };
+    const uint32_t byteOrderMark = 0x01020304;
+
+    uint32_t sectionTag(const char* name){
+        return static_cast<uint32_t>(name[0]) | static_cast<uint32_t>(name[1]) << 8
+             | static_cast<uint32_t>(name[2]) << 16 | static_cast<uint32_t>(name[3]) << 24;
+    }
+    const uint32_t problemSection = sectionTag("PROB");
+    const uint32_t distanceSection = sectionTag("DIST");
+    const uint32_t neighbourSection = sectionTag("NEAR");
+    const uint32_t searchSection = sectionTag("SRCH");
+
+    // Layout codes of the stored matrix
+    const uint8_t fullLayout = 0;
+    const uint8_t symmetricLayout = 1;
+
+    // Returns the stored matrix of a cache of exact distances; only called for such caches
+    inline const double* exactMatrix(const double* matrix){
+        return matrix;
+    }
+    template<typename T>
+    const double* exactMatrix(const T*){
+        throw logic_error("Only exact distances are written to snapshots.");
+    }
+
+    // Writes values in the machine's byte order, counting the bytes written
+    class binaryWriter{
+    public:
+        explicit binaryWriter(ostream& out)
+            : out(out), written(0) {}
+        template<typename T>
+        void put(T value){
+            static_assert(is_arithmetic<T>::value, "only arithmetic values are written directly");
+            putBytes(&value, sizeof(value));
+        }
+        template<typename T>
+        void putArray(const T* values, size_t count){
+            put<uint64_t>(count);
+            if (count > 0) putBytes(values, count * sizeof(T));
+        }
+        template<typename T>
+        void putArray(const vector<T>& values) { putArray(values.data(), values.size()); }
+        void putString(const string& value) { putArray(value.data(), value.size()); }
+        // Writes a section holding the bytes of 'payload'
+        void putSection(uint32_t tag, const string& payload){
+            put(tag);
+            put<uint64_t>(payload.size());
+            putBytes(payload.data(), payload.size());
+        }
+        void putBytes(const void* bytes, size_t count){
+            out.write(static_cast<const char*>(bytes), count);
+            written += count;
+        }
+        // Returns the number of bytes written so far
+        size_t position() const { return written; }
+    private:
+        ostream& out;
+        size_t written;
+    };
+
+    // Reads values written by binaryWriter from a section payload held in memory
+    class binaryReader{
+    public:
+        binaryReader(const char* data, size_t size)
+            : data(data), size(size), offset(0) {}
+        template<typename T>
+        T get(){
+            T value;
+            take(&value, sizeof(value));
+            return value;
+        }
+        template<typename T>
+        vector<T> getArray(){
+            uint64_t count = get<uint64_t>();
+            if (count > (size - offset) / sizeof(T)) throw runtime_error("Snapshot is truncated.");
+            vector<T> values(static_cast<size_t>(count));
+            if (count > 0) take(values.data(), values.size() * sizeof(T));
+            return values;
+        }
+        string getString(){
+            vector<char> chars = getArray<char>();
+            return string(chars.begin(), chars.end());
+        }
+        // Returns the next 'bytes' bytes in place and moves past them
+        const char* skip(size_t bytes){
+            if (bytes > size - offset) throw runtime_error("Snapshot is truncated.");
+            const char* at = data + offset;
+            offset += bytes;
+            return at;
+        }
+        bool atEnd() const { return offset == size; }
+    private:
+        void take(void* to, size_t bytes){
+            if (bytes > size - offset) throw runtime_error("Snapshot is truncated.");
+            memcpy(to, data + offset, bytes);
+            offset += bytes;
+        }
+        const char* data;
+        size_t size;
+        size_t offset;
+    };
+
+    string problemPayload(const problemParameters& problem){
+        ostringstream payload;
+        binaryWriter out(payload);
+        out.putString(problem.name);
+        out.put<int32_t>(problem.dimension);
+        out.put<int32_t>(problem.capacity);
+        out.put<int32_t>(problem.vehicles);
+        out.put(problem.maxRouteLength);
+        out.put(problem.serviceTime);
+        out.put<uint64_t>(problem.nodes.size());
+        for (const node& n : problem.nodes){
+            out.put(n.num);
+            out.put(n.demand);
+            out.put(n.x);
+            out.put(n.y);
+        }
+        out.putArray(problem.edgeWeights);
+        return payload.str();
+    }
+
+    problemParameters readProblem(binaryReader& in){
+        problemParameters problem;
+        problem.name = in.getString();
+        problem.dimension = in.get<int32_t>();
+        problem.capacity = in.get<int32_t>();
+        problem.vehicles = in.get<int32_t>();
+        problem.maxRouteLength = in.get<double>();
+        problem.serviceTime = in.get<double>();
+        uint64_t nodeCount = in.get<uint64_t>();
+        if (nodeCount != static_cast<uint64_t>(problem.dimension) || nodeCount > UINT16_MAX){
+            throw runtime_error("Snapshot problem has an invalid node count.");
+        }
+        problem.nodes.resize(static_cast<size_t>(nodeCount));
+        for (size_t i = 0; i < problem.nodes.size(); i++){
+            node& n = problem.nodes[i];
+            n.num = in.get<uint16_t>();
+            n.demand = in.get<uint16_t>();
+            n.x = in.get<float>();
+            n.y = in.get<float>();
+            if (n.num != i + 1) throw runtime_error("Snapshot problem nodes are out of order.");
+        }
+        problem.edgeWeights = in.getArray<double>();
+        if (!problem.edgeWeights.empty() && problem.edgeWeights.size() != problem.nodes.size() * problem.nodes.size()){
+            throw runtime_error("Snapshot edge weights do not match the node count.");
+        }
+        return problem;
+    }
+
+    template<typename T>
+    void putIndexRoutes(binaryWriter& out, const vector<vector<T>>& routes){
+        out.put<uint64_t>(routes.size());
+        for (const auto& route : routes) out.putArray(route);
+    }
+
+    template<typename T>
+    vector<vector<T>> getIndexRoutes(binaryReader& in){
+        uint64_t count = in.get<uint64_t>();
+        vector<vector<T>> routes;
+        for (uint64_t r = 0; r < count; r++) routes.push_back(in.getArray<T>());
+        return routes;
+    }
+
+    // size_t values are written as 64 bits whatever their width
+    vector<uint64_t> widen(const vector<size_t>& values){
+        return vector<uint64_t>(values.begin(), values.end());
+    }
+    vector<size_t> narrow(const vector<uint64_t>& values){
+        return vector<size_t>(values.begin(), values.end());
+    }
+
+    string searchPayload(const tabu::searchState& state){
+        ostringstream payload;
+        binaryWriter out(payload);
+        out.put<uint64_t>(state.iteration);
+        out.put<uint64_t>(state.iterations);
+        out.put(state.selectionCount);
+        out.put(state.penalty);
+        out.put(state.maxObjectiveChange);
+        out.put<uint64_t>(state.infeasibleIterations);
+        putIndexRoutes(out, state.current);
+        out.put<uint64_t>(state.emptyRoute);
+        putIndexRoutes(out, state.best);
+        out.put(state.bestCost);
+        out.putArray(widen(state.tabuRoute));
+        out.putArray(widen(state.tabuUntil));
+        out.putArray(widen(state.moveCount));
+        out.putArray(state.candidates);
+        out.putArray(state.changed);
+        out.putString(state.rng);
+        return payload.str();
+    }
+
+    tabu::searchState readSearchState(binaryReader& in){
+        tabu::searchState state;
+        state.iteration = static_cast<size_t>(in.get<uint64_t>());
+        state.iterations = static_cast<size_t>(in.get<uint64_t>());
+        state.selectionCount = in.get<uint16_t>();
+        state.penalty = in.get<double>();
+        state.maxObjectiveChange = in.get<double>();
+        state.infeasibleIterations = static_cast<size_t>(in.get<uint64_t>());
+        state.current = getIndexRoutes<uint16_t>(in);
+        state.emptyRoute = static_cast<size_t>(in.get<uint64_t>());
+        state.best = getIndexRoutes<uint16_t>(in);
+        state.bestCost = in.get<double>();
+        // Tabu routes are 'none' as the largest size_t, which must stay the largest when narrowed
+        vector<uint64_t> tabuRoute = in.getArray<uint64_t>();
+        for (auto& r : tabuRoute) if (r == UINT64_MAX) r = numeric_limits<size_t>::max();
+        state.tabuRoute = narrow(tabuRoute);
+        state.tabuUntil = narrow(in.getArray<uint64_t>());
+        state.moveCount = narrow(in.getArray<uint64_t>());
+        state.candidates = in.getArray<uint16_t>();
+        state.changed = in.getArray<uint16_t>();
+        state.rng = in.getString();
+        return state;
+    }
+
+}
+
+void cvrp::writeSnapshot(ostream& out, const problemParameters& problem, const distanceCache& distances,
+                         bool includeMatrix, const tabu::searchState* state){
+    if (distances.size() != problem.nodes.size()) throw invalid_argument("Distances do not match the problem.");
+    binaryWriter writer(out);
+    writer.putBytes(magic, sizeof(magic));
+    writer.put(snapshotVersion);
+    writer.put(byteOrderMark);
+    writer.putSection(problemSection, problemPayload(problem));
+    // The matrix is written straight to the stream, as it may be far larger than everything else, after
+    // padding that aligns it within the file so that readers can use it in place from a mapping of the file.
+    // Snapshots hold exact distances only, which caches of other cost policies convert from the coordinates.
+    if (includeMatrix && !distances.isComputed() && costPolicy::exact){
+        size_t count = distances.storedDistanceCount();
+        size_t start = writer.position() + sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint8_t) + sizeof(uint64_t);
+        uint8_t padding = static_cast<uint8_t>((alignof(double) - start % alignof(double)) % alignof(double));
+        const char zeros[alignof(double)] = {};
+        writer.put(distanceSection);
+        writer.put<uint64_t>(2 * sizeof(uint8_t) + padding + sizeof(uint64_t) + count * sizeof(double));
+        writer.put(distances.isSymmetric() ? symmetricLayout : fullLayout);
+        writer.put(padding);
+        writer.putBytes(zeros, padding);
+        writer.putArray(exactMatrix(distances.storedDistances()), count);
+    }
+    const vector<uint16_t>& neighbours = distances.neighbourLists();
+    writer.put(neighbourSection);
+    writer.put<uint64_t>(2 * sizeof(uint64_t) + neighbours.size() * sizeof(uint16_t));
+    writer.put<uint64_t>(distances.neighbourCount());
+    writer.putArray(neighbours);
+    if (state) writer.putSection(searchSection, searchPayload(*state));
+    if (!out) throw runtime_error("Snapshot could not be written.");
+}
+
+namespace{
+
+    // Returns the stored matrix of exact distances, or null for a cache that holds other values
+    template<typename T>
+    const T* storedMatrix(const double*){
+        return nullptr;
+    }
+    template<>
+    inline const double* storedMatrix<double>(const double* matrix){
+        return matrix;
+    }
+
+    // Reads the snapshot held in the 'size' bytes at 'data', which 'owner' keeps alive; the distance matrix is
+    // used in place if it is suitably aligned, holding on to 'owner'
+    snapshot parseSnapshot(shared_ptr<const void> owner, const char* data, size_t size){
+        if (size < sizeof(magic) || memcmp(data, magic, sizeof(magic)) != 0) throw runtime_error("Not a snapshot.");
+        binaryReader in(data, size);
+        in.skip(sizeof(magic));
+        uint32_t version = in.get<uint32_t>();
+        if (in.get<uint32_t>() != byteOrderMark) throw runtime_error("Snapshot was written with a different byte order.");
+        if (version != snapshotVersion) throw runtime_error("Unsupported snapshot version.");
+
+        snapshot result;
+        bool hasProblem = false;
+        uint8_t layout = fullLayout;
+        const double* matrix = nullptr;
+        size_t matrixCount = 0;
+        shared_ptr<const void> matrixOwner;
+        vector<uint16_t> neighbours;
+        size_t neighbourCount = defaultNeighbourCount;
+        while (!in.atEnd()){
+            uint32_t tag = in.get<uint32_t>();
+            uint64_t length = in.get<uint64_t>();
+            if (length > size) throw runtime_error("Snapshot is truncated.");
+            binaryReader reader(in.skip(static_cast<size_t>(length)), static_cast<size_t>(length));
+            if (tag == problemSection){
+                result.problem = readProblem(reader);
+                hasProblem = true;
+            }
+            else if (tag == distanceSection){
+                layout = reader.get<uint8_t>();
+                if (layout != fullLayout && layout != symmetricLayout) throw runtime_error("Unknown snapshot matrix layout.");
+                reader.skip(reader.get<uint8_t>());
+                uint64_t count = reader.get<uint64_t>();
+                if (count > length / sizeof(double)) throw runtime_error("Snapshot matrix section is malformed.");
+                matrixCount = static_cast<size_t>(count);
+                const char* stored = reader.skip(matrixCount * sizeof(double));
+                if (!reader.atEnd()) throw runtime_error("Snapshot matrix section is malformed.");
+                if (reinterpret_cast<uintptr_t>(stored) % alignof(double) == 0){
+                    matrix = reinterpret_cast<const double*>(stored);
+                    matrixOwner = owner;
+                }
+                else{
+                    // Written without padding, so copied to aligned memory
+                    shared_ptr<vector<double>> copied = make_shared<vector<double>>(matrixCount);
+                    if (matrixCount > 0) memcpy(copied->data(), stored, matrixCount * sizeof(double));
+                    matrix = copied->data();
+                    matrixOwner = copied;
+                }
+            }
+            else if (tag == neighbourSection){
+                neighbourCount = static_cast<size_t>(reader.get<uint64_t>());
+                neighbours = reader.getArray<uint16_t>();
+            }
+            else if (tag == searchSection){
+                result.searchState = readSearchState(reader);
+                result.hasSearchState = true;
+            }
+            // Unknown sections are skipped
+        }
+        if (!hasProblem) throw runtime_error("Snapshot holds no problem.");
+        if (result.hasSearchState){
+            try{
+                tabu::validateSearchState(result.searchState, result.problem.nodes.size());
+            }
+            catch (const invalid_argument& e){
+                throw runtime_error(string("Invalid snapshot search state: ") + e.what());
+            }
+        }
+        const distanceCache::value_type* stored = storedMatrix<distanceCache::value_type>(matrix);
+        distanceStorage storage = distanceStorage::automatic;
+        if (stored) storage = layout == symmetricLayout ? distanceStorage::symmetric : distanceStorage::full;
+        try{
+            result.distances.reset(new distanceCache(result.problem.nodes, result.problem.edgeWeights, storage, stored,
+                                                     matrixCount, move(matrixOwner), move(neighbours), neighbourCount));
+        }
+        catch (const invalid_argument& e){
+            throw runtime_error(string("Invalid snapshot distances: ") + e.what());
+        }
+        return result;
+    }
+
+}
+
+snapshot cvrp::readSnapshot(istream& in){
+    shared_ptr<vector<char>> data = make_shared<vector<char>>();
+    const size_t chunk = 1 << 20;
+    while (in){
+        size_t used = data->size();
+        data->resize(used + chunk);
+        in.read(data->data() + used, chunk);
+        data->resize(used + static_cast<size_t>(in.gcount()));
+    }
+    if (in.bad()) throw runtime_error("Snapshot could not be read.");
+    return parseSnapshot(data, data->data(), data->size());
+}
+
+snapshot cvrp::loadSnapshot(const string& filename){
+    shared_ptr<mappedFile> file;
+    try{
+        file = make_shared<mappedFile>(filename, false);
+    }
+    catch (const runtime_error&){
+        throw runtime_error("Snapshot file could not be opened.");
+    }
+    return parseSnapshot(file, file->data(), file->size());
+}
+
+void cvrp::saveSnapshot(const string& filename, const problemParameters& problem, const distanceCache& distances,
+                        bool includeMatrix, const tabu::searchState* state){
+    string temporary = filename + ".tmp";
+    {
+        ofstream out(temporary, ios::binary | ios::trunc);
+        if (!out) throw runtime_error("Snapshot file could not be written.");
+        writeSnapshot(out, problem, distances, includeMatrix, state);
+        out.close();
+        if (!out) throw runtime_error("Snapshot file could not be written.");
+    }
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    remove(filename.c_str());
+#endif
+    if (rename(temporary.c_str(), filename.c_str()) != 0) throw runtime_error("Snapshot file could not be replaced.");
+}
+
+bool cvrp::isSnapshotFile(const string& filename){
+    ifstream in(filename, ios::binary);
+    char header[sizeof(magic)];
+    in.read(header, sizeof(header));
+    return in && memcmp(header, magic, sizeof(magic)) == 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <memory>
+#include "cvrp.h"
+#include "distances.h"
+#include "tabu.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Binary snapshots of problems and searches, for loading large problems without parsing text or computing
+    // distances again, and for carrying on a search that was stopped.
+    // A snapshot is the 8 bytes "CVRPSNAP", a 32-bit format version and a 32-bit byte order mark, followed by
+    // sections. Each section is a 32-bit tag, a 64-bit payload length and the payload, so that readers skip the
+    // sections they do not know. Values are stored in the byte order of the machine that wrote them; a
+    // snapshot written on a machine of the other byte order is rejected.
+    //   PROB  the problem: its header fields, nodes and any explicit edge weights
+    //   DIST  the distance cache's stored matrix, its layout and padding that aligns the matrix within the file
+    //   NEAR  the distance cache's neighbour lists
+    //   SRCH  the state of a tabu search
+
+    const uint32_t snapshotVersion = 1;
+
+    // Everything read from a snapshot
+    struct snapshot{
+        snapshot()
+            : hasSearchState(false) {}
+        problemParameters problem;
+        // Distances restored from the snapshot's stored matrix and neighbour lists, computing whatever was not
+        // stored; built for 'problem' as it was read
+        unique_ptr<distanceCache> distances;
+        bool hasSearchState;
+        tabu::searchState searchState;
+    };
+
+    // Writes 'problem' with the neighbour lists of 'distances', and its stored matrix if 'includeMatrix' is set
+    // and it has one, followed by 'state' if it is given
+    void writeSnapshot(ostream& out, const problemParameters& problem, const distanceCache& distances,
+                       bool includeMatrix, const tabu::searchState* state = nullptr);
+
+    // Reads a snapshot, throwing runtime_error if it is malformed or truncated, or holds a search state that
+    // cannot belong to its problem
+    snapshot readSnapshot(istream& in);
+    // Reads a snapshot file by mapping it into memory. A stored matrix is used in place from the mapping, so
+    // that loading takes time for the problem and neighbour lists only and the matrix is paged in as the
+    // solver touches it; the mapping lives as long as the distance cache.
+    snapshot loadSnapshot(const string& filename);
+
+    // Writes a snapshot to 'filename' by way of a temporary file that then replaces it, so that the file holds
+    // either the previous snapshot or the new one even if the process is stopped while writing
+    void saveSnapshot(const string& filename, const problemParameters& problem, const distanceCache& distances,
+                      bool includeMatrix, const tabu::searchState* state = nullptr);
+
+    // Returns true if the file starts like a snapshot
+    bool isSnapshotFile(const string& filename);
+
+}
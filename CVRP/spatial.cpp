@@ -0,0 +1,48 @@
+#include "spatial.h"
+#include <cmath>
+
+using namespace std;
+using namespace cvrp;
+
+spatialGrid::spatialGrid(const nodeArrays& nodes)
+    : columns(1), rows(1), originX(0), originY(0), cellSize(1){
+    size_t n = nodes.size();
+    if (n == 0){
+        cellStart.assign(2, 0);
+        return;
+    }
+    double minX = *min_element(nodes.x.begin(), nodes.x.end()), maxX = *max_element(nodes.x.begin(), nodes.x.end());
+    double minY = *min_element(nodes.y.begin(), nodes.y.end()), maxY = *max_element(nodes.y.begin(), nodes.y.end());
+    originX = minX;
+    originY = minY;
+    double width = maxX - minX, height = maxY - minY;
+    // Square cells sized for spatialNodesPerCell nodes each if the nodes were spread evenly over the bounding
+    // box; a box that is flat in one direction is treated as a strip
+    double cellCount = max(1.0, n / spatialNodesPerCell);
+    if (width > 0 && height > 0) cellSize = sqrt(width * height / cellCount);
+    else if (width > 0 || height > 0) cellSize = max(width, height) / cellCount;
+    // Keep the number of cells within a small multiple of the node count for very elongated boxes
+    double limit = 4 * cellCount;
+    while ((floor(width / cellSize) + 1) * (floor(height / cellSize) + 1) > limit) cellSize *= 2;
+    columns = static_cast<size_t>(floor(width / cellSize)) + 1;
+    rows = static_cast<size_t>(floor(height / cellSize)) + 1;
+
+    // Counting sort of the nodes by cell
+    vector<size_t> cellOf(n);
+    cellStart.assign(columns*rows + 1, 0);
+    for (size_t i = 0; i < n; i++){
+        cellOf[i] = row(nodes.y[i])*columns + column(nodes.x[i]);
+        cellStart[cellOf[i] + 1]++;
+    }
+    for (size_t c = 0; c < columns*rows; c++) cellStart[c + 1] += cellStart[c];
+    vector<uint32_t> fill(cellStart.begin(), cellStart.end() - 1);
+    x.resize(n);
+    y.resize(n);
+    index.resize(n);
+    for (size_t i = 0; i < n; i++){
+        uint32_t p = fill[cellOf[i]]++;
+        x[p] = nodes.x[i];
+        y[p] = nodes.y[i];
+        index[p] = static_cast<uint16_t>(i);
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include <stdint.h>
+#include "kernels.h"
+
+using namespace std;
+
+namespace cvrp{
+
+    // Average number of nodes per grid cell
+    const double spatialNodesPerCell = 2.0;
+
+    // Accepts every node; the default filter of spatialGrid queries
+    struct anyNode{
+        bool operator()(size_t) const { return true; }
+    };
+
+    // Uniform grid over the node coordinates, answering nearest neighbour and radius queries in time that
+    // depends on the number of nodes near the query point rather than on the total number of nodes.
+    // The bounding box of the nodes is divided into square cells holding spatialNodesPerCell nodes on average,
+    // and the nodes are stored cell by cell. Nearest neighbour queries search rings of cells of increasing
+    // size around the query point until no unsearched cell can hold a nearer node.
+    // Queries take a filter, called with node indices, so that they can be restricted to a subset of the nodes
+    // such as those of one route. Distances are exact euclidean distances, and equally distant nodes are
+    // ordered by index, so results do not depend on the layout of the grid.
+    class spatialGrid{
+    public:
+        spatialGrid()
+            : columns(0), rows(0), originX(0), originY(0), cellSize(1) {}
+        explicit spatialGrid(const nodeArrays& nodes);
+
+        // Returns the number of nodes in the grid
+        size_t size() const { return index.size(); }
+
+        // Writes the indices of the (up to) k nodes accepted by 'filter' that are nearest to (x, y) to out,
+        // nearest first, and returns their number
+        template<typename Filter>
+        size_t nearest(double x, double y, size_t k, uint16_t* out, Filter filter) const;
+        size_t nearest(double x, double y, size_t k, uint16_t* out) const { return nearest(x, y, k, out, anyNode()); }
+
+        // Appends the indices of every node accepted by 'filter' within 'radius' of (x, y) to out, in no
+        // particular order
+        template<typename Filter>
+        void within(double x, double y, double radius, vector<uint16_t>& out, Filter filter) const;
+        void within(double x, double y, double radius, vector<uint16_t>& out) const { within(x, y, radius, out, anyNode()); }
+
+    private:
+        // Returns the column or row of a coordinate, clamped to the grid
+        size_t column(double x) const { return clampCell((x - originX) / cellSize, columns); }
+        size_t row(double y) const { return clampCell((y - originY) / cellSize, rows); }
+        static size_t clampCell(double c, size_t count){
+            return c <= 0 ? 0 : min(count - 1, static_cast<size_t>(c));
+        }
+
+        size_t columns;
+        size_t rows;
+        double originX;
+        double originY;
+        double cellSize;
+        // Offset of the first node of each cell, row by row, with a final entry for the end
+        vector<uint32_t> cellStart;
+        // Node coordinates and indices in cell order
+        vector<double> x;
+        vector<double> y;
+        vector<uint16_t> index;
+    };
+
+    template<typename Filter>
+    size_t spatialGrid::nearest(double qx, double qy, size_t k, uint16_t* out, Filter filter) const{
+        if (k == 0 || index.empty()) return 0;
+        // Max-heap of the best nodes found so far, by squared distance then index
+        vector<pair<double, uint16_t>> best;
+        best.reserve(k + 1);
+        size_t cx = column(qx), cy = row(qy);
+        auto visitCell = [&](size_t c, size_t r){
+            size_t cell = r*columns + c;
+            for (uint32_t p = cellStart[cell]; p < cellStart[cell + 1]; p++){
+                if (!filter(index[p])) continue;
+                double dx = x[p] - qx, dy = y[p] - qy;
+                pair<double, uint16_t> candidate(dx*dx + dy*dy, index[p]);
+                if (best.size() == k && !(candidate < best.front())) continue;
+                best.push_back(candidate);
+                push_heap(best.begin(), best.end());
+                if (best.size() > k){
+                    pop_heap(best.begin(), best.end());
+                    best.pop_back();
+                }
+            }
+        };
+        for (size_t ring = 0;; ring++){
+            // Cells at Chebyshev distance 'ring' from the query cell, clipped to the grid
+            size_t left = cx >= ring ? cx - ring : 0, right = min(columns - 1, cx + ring);
+            size_t bottom = cy >= ring ? cy - ring : 0, top = min(rows - 1, cy + ring);
+            bool leftEdge = cx >= ring, rightEdge = cx + ring < columns;
+            bool bottomEdge = cy >= ring, topEdge = cy + ring < rows;
+            if (bottomEdge) for (size_t c = left; c <= right; c++) visitCell(c, cy - ring);
+            if (topEdge && ring > 0) for (size_t c = left; c <= right; c++) visitCell(c, cy + ring);
+            for (size_t r = bottom; r <= top; r++){
+                if (r == cy - ring && bottomEdge) continue;
+                if (r == cy + ring && topEdge) continue;
+                if (leftEdge) visitCell(cx - ring, r);
+                if (rightEdge && ring > 0) visitCell(cx + ring, r);
+            }
+            if (!leftEdge && !rightEdge && !bottomEdge && !topEdge) break;
+            // Any node not yet seen lies outside the searched block, beyond one of its sides that has not
+            // reached the edge of the grid
+            if (best.size() == k){
+                double bound = numeric_limits<double>::max();
+                if (cx > ring) bound = min(bound, qx - (originX + (cx - ring)*cellSize));
+                if (cx + ring + 1 < columns) bound = min(bound, originX + (cx + ring + 1)*cellSize - qx);
+                if (cy > ring) bound = min(bound, qy - (originY + (cy - ring)*cellSize));
+                if (cy + ring + 1 < rows) bound = min(bound, originY + (cy + ring + 1)*cellSize - qy);
+                bound = max(0.0, bound);
+                if (bound == numeric_limits<double>::max() || bound*bound > best.front().first) break;
+            }
+        }
+        sort_heap(best.begin(), best.end());
+        for (size_t i = 0; i < best.size(); i++) out[i] = best[i].second;
+        return best.size();
+    }
+
+    template<typename Filter>
+    void spatialGrid::within(double qx, double qy, double radius, vector<uint16_t>& out, Filter filter) const{
+        if (index.empty() || radius < 0) return;
+        size_t left = column(qx - radius), right = column(qx + radius);
+        size_t bottom = row(qy - radius), top = row(qy + radius);
+        double limit = radius*radius;
+        for (size_t r = bottom; r <= top; r++){
+            for (uint32_t p = cellStart[r*columns + left]; p < cellStart[r*columns + right + 1]; p++){
+                double dx = x[p] - qx, dy = y[p] - qy;
+                if (dx*dx + dy*dy <= limit && filter(index[p])) out.push_back(index[p]);
+            }
+        }
+    }
+
+}
@@ -1,158 +1,820 @@
 #include "tabu.h"
 #include "helpers.h"
 #include "savings.h"
+#include "distances.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "elitepool.h"
+#include "telemetry.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
 
 using namespace std;
 using namespace cvrp;
 
-vector<node> tabu::geniType1(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k){
-    vector<node> result;
+// Builds the tour produced by a GENI Type I insertion of newNode into the closed tour 'initial' of length n
+template<typename T>
+static void geniType1Tour(const T* initial, size_t n, T newNode, size_t i, size_t j, size_t k, vector<T>& result){
+    result.clear();
     result.push_back(initial[i]);
     result.push_back(newNode);
     result.push_back(initial[j]);
     // Reverse (i+1,...,j)
-    size_t next = cyclePrev(initial.size(), j);
+    size_t next = cyclePrev(n, j);
     while (next != i) {
         result.push_back(initial[next]);
-        next = cyclePrev(initial.size(), next);
+        next = cyclePrev(n, next);
     }
     // Reverse (j+1,...,k)
     result.push_back(initial[k]);
-    next = cyclePrev(initial.size(), k);
+    next = cyclePrev(n, k);
     while (next != j) {
         result.push_back(initial[next]);
-        next = cyclePrev(initial.size(), next);
+        next = cyclePrev(n, next);
     }
-    next = cycleNext(initial.size(), k);
+    next = cycleNext(n, k);
     while (next != i) {
         result.push_back(initial[next]);
-        next = cycleNext(initial.size(), next);
+        next = cycleNext(n, next);
     }
-    return result;
 }
-vector<node> tabu::geniType2(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, size_t l){
-    vector<node> result;
+// Builds the tour produced by a GENI Type II insertion of newNode into the closed tour 'initial' of length n
+template<typename T>
+static void geniType2Tour(const T* initial, size_t n, T newNode, size_t i, size_t j, size_t k, size_t l, vector<T>& result){
+    result.clear();
     result.push_back(initial[i]);
     result.push_back(newNode);
     result.push_back(initial[j]);
-    size_t prevL = cyclePrev(initial.size(), l);
+    size_t prevL = cyclePrev(n, l);
     // Reverse (j,...,l)
-    size_t next = cyclePrev(initial.size(), j);
+    size_t next = cyclePrev(n, j);
     while (next != prevL){
         result.push_back(initial[next]);
-        next = cyclePrev(initial.size(), next);
+        next = cyclePrev(n, next);
     }
-    next = cycleNext(initial.size(), j);
+    next = cycleNext(n, j);
     while (next != k){
         result.push_back(initial[next]);
-        next = cycleNext(initial.size(), next);
+        next = cycleNext(n, next);
     }
     // Reverse (i+1,...,l-1)
     next = prevL;
     while (next != i){
         result.push_back(initial[next]);
-        next = cyclePrev(initial.size(), next);
+        next = cyclePrev(n, next);
     }
     next = k;
     while (next != i){
         result.push_back(initial[next]);
-        next = cycleNext(initial.size(), next);
+        next = cycleNext(n, next);
     }
-    return result;
 }
+// Builds the tour produced by applying 'move' to the closed tour 'initial' of length n
+template<typename T>
+static void geniApplyTour(const T* initial, size_t n, T newNode, const tabu::geniMove& move, vector<T>& result){
+    switch (move.type){
+    case tabu::geniMove::plain:
+        result.assign(initial, initial + move.i + 1);
+        result.push_back(newNode);
+        result.insert(result.end(), initial + move.i + 1, initial + n);
+        break;
+    case tabu::geniMove::type1:
+        geniType1Tour(initial, n, newNode, move.i, move.j, move.k, result);
+        break;
+    case tabu::geniMove::type2:
+        geniType2Tour(initial, n, newNode, move.i, move.j, move.k, move.l, result);
+        break;
+    default:
+        throw invalid_argument("No GENI move to apply.");
+    }
+}
+
+void tabu::geniType1(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, vector<node>& result){
+    geniType1Tour(initial.data(), initial.size(), newNode, i, j, k, result);
+}
+void tabu::geniType2(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, size_t l, vector<node>& result){
+    geniType2Tour(initial.data(), initial.size(), newNode, i, j, k, l, result);
+}
+
+// Orders the first 'count' entries of workspace.positions by their distance in 'tourDistances', nearest first
+static void rankPositions(tabu::geniWorkspace& workspace, const vector<double>& tourDistances, size_t count){
+    vector<size_t>& positions = workspace.positions;
+    positions.resize(tourDistances.size());
+    for (size_t p = 0; p < positions.size(); p++) positions[p] = p;
+    partial_sort(positions.begin(), positions.begin() + count, positions.end(),
+                 [&](size_t a, size_t b) { return tourDistances[a] < tourDistances[b]; });
+}
+
+// Scores every GENI Type I and Type II insertion of newNode into 'initial' around its nearest tour nodes, along
+// with plain insertion next to those nodes, and returns the cheapest. Each candidate is scored from the edges
+// it adds and removes (reversed paths cost the same in either direction), so no candidate tour is built.
+// Short tours rank every tour node by distance with the vectorised kernels; tours of at least
+// geniSpatialThreshold nodes query the spatial index for the nearest tour nodes instead, so that the work no
+// longer grows with the length of the tour.
+tabu::geniMove tabu::geniEvaluate(const uint16_t* tour, size_t n, size_t v, const distanceCache& distances,
+                                  geniWorkspace& workspace){
+    const spatialGrid* grid = n >= tabu::geniSpatialThreshold ? distances.spatialIndex() : nullptr;
+    vector<uint32_t>& tourPosition = workspace.tourPosition;
+    if (grid){
+        tourPosition.resize(distances.size(), 0);
+        for (size_t p = 0; p < n; p++) tourPosition[tour[p]] = static_cast<uint32_t>(p + 1);
+    }
+    const nodeArrays& coords = distances.coordinates();
+    // Writes the tour positions of the 'count' tour nodes nearest to node 'from', other than itself, to out
+    auto nearestInTour = [&](size_t from, size_t count, vector<size_t>& out){
+        vector<uint16_t>& found = workspace.found;
+        found.resize(count);
+        found.resize(grid->nearest(coords.x[from], coords.y[from], count, found.data(),
+                                   [&](size_t i) { return i != from && tourPosition[i] != 0; }));
+        for (uint16_t i : found) out.push_back(tourPosition[i] - 1);
+    };
+    auto d = [&](size_t a, size_t b) { return distances(tour[a], tour[b]); };
+    auto dv = [&](size_t a) { return grid ? distances(v, tour[a]) : workspace.newNodeDistances[a]; };
+    // Find the tour positions of the nearest 'geniNeighbours' nodes to the new node
+    size_t nearestCount = min(tabu::geniNeighbours, n);
+    vector<size_t>& nearest = workspace.nearest;
+    if (grid){
+        nearest.clear();
+        nearestInTour(v, nearestCount, nearest);
+    }
+    else{
+        workspace.newNodeDistances.resize(n);
+        distances.distancesTo(v, tour, n, workspace.newNodeDistances.data());
+        rankPositions(workspace, workspace.newNodeDistances, nearestCount);
+        nearest.assign(workspace.positions.begin(), workspace.positions.begin() + nearestCount);
+    }
+    // Only the nearest neighbours that actually exist in the tour can be used as k and l candidates; the
+    // nearest candidate is skipped as it is the node itself
+    size_t candidateCount = min(tabu::geniNeighbours, n - 1);
+    // Writes the tour positions of the node at 'position' followed by its 'candidateCount' nearest tour nodes
+    // to out
+    vector<double>& candidateDistances = workspace.candidateDistances;
+    auto rankCandidates = [&](size_t position, vector<size_t>& out){
+        if (grid){
+            out.assign(1, position);
+            nearestInTour(tour[position], candidateCount, out);
+            return;
+        }
+        distances.distancesTo(tour[position], tour, n, candidateDistances.data());
+        rankPositions(workspace, candidateDistances, candidateCount + 1);
+        out.assign(workspace.positions.begin(), workspace.positions.begin() + candidateCount + 1);
+    };
 
-vector<node> tabu::geniInsert(const vector<node>& initial, node newNode){
-    // Initialize a distance matrix containing square distances between every pair of
-    // nodes in the initial set of nodes, preserving indexing
-    vector<vector<uint32_t>> distanceMatrix(initial.size(), vector<uint32_t>(initial.size(), 0));
-    for (size_t i = 0; i < initial.size()-1; i++){
-        for (size_t j = i+1; j < initial.size(); j++){
-            uint32_t ijDist = sqrDistance(initial[i], initial[j]);
-            distanceMatrix[i][j] = ijDist;
-            distanceMatrix[j][i] = ijDist;
-        }
-    }
-    vector<size_t> nodeList;
-    for (size_t i = 0; i < initial.size(); i++) nodeList.push_back(i);
-    // Find the nearest 'geniNeighbours' nodes to the new node
-    vector<node> nearest = initial;
-    std::sort(nearest.begin(), nearest.end(), [&](const node& a, const node& b) { return sqrDistance(newNode,a) < sqrDistance(newNode,b); });
-    if (nearest.size() > tabu::geniNeighbours){
-        nearest.erase(nearest.begin() + tabu::geniNeighbours - 1, nearest.end());
-    }
-    // Iterate through all possible values for i,j,k,l and save the best solution
-    vector<node> bestResult;
-    uint64_t bestDistance = numeric_limits<uint64_t>::max();
+    geniMove best;
+    // Plain insertion on either side of each neighbour, which is the only option for tours too small for a
+    // GENI move (fewer than 4 nodes); the cost of every insertion is computed in one kernel call
+    if (!grid){
+        workspace.insertionCosts.resize(n);
+        distances.insertionCosts(v, tour, n, workspace.insertionCosts.data());
+    }
+    for (size_t i = 0; i < nearest.size(); i++){
+        for (size_t after : { cyclePrev(n, nearest[i]), nearest[i] }){
+            size_t next = cycleNext(n, after);
+            double delta = grid ? dv(after) + dv(next) - d(after, next) : workspace.insertionCosts[after];
+            if (delta < best.delta){
+                best = geniMove();
+                best.type = geniMove::plain;
+                best.i = after;
+                best.delta = delta;
+            }
+        }
+    }
+    candidateDistances.resize(n);
+    size_t scored = 0;
     /////////
     // I loop
     for (size_t i = 0; i < nearest.size(); i++){
-        // Index of i
-        size_t iIdx = find_if(initial.begin(), initial.end(),
-                              [&](const node& n) { return n.num == nearest[i].num; }) - initial.begin();
-        size_t iNext = cycleNext(initial.size(), iIdx);
+        size_t iIdx = nearest[i];
+        size_t iNext = cycleNext(n, iIdx);
+        // The k candidates depend only on i, so only the nearest of them need to be ordered
+        rankCandidates(iNext, workspace.kCandidates);
         /////////
         // J loop
         for (size_t j = 0; j < nearest.size(); j++){
             if (i == j) continue;
-            // Index of j
-            size_t jIdx = find_if(initial.begin(), initial.end(),
-                                  [&](const node& n) { return n.num == nearest[j].num; }) - initial.begin();
-            size_t jNext = cycleNext(initial.size(), jIdx);
-            vector<size_t> kCandidates = nodeList;
-            std::sort(kCandidates.begin(), kCandidates.end(),
-                      [&](const size_t& a, const size_t& b) { return distanceMatrix[iNext][a] < distanceMatrix[iNext][b]; });
+            size_t jIdx = nearest[j];
+            size_t jNext = cycleNext(n, jIdx);
+            vector<size_t>& lCandidates = workspace.lCandidates;
+            rankCandidates(jNext, lCandidates);
+            // Inserting v between i and j always adds (i,v), (v,j) and removes (i,i+1), (j,j+1)
+            double commonDelta = dv(iIdx) + dv(jIdx) - d(iIdx, iNext) - d(jIdx, jNext);
             /////////
             // K loop
-            for (size_t k = 1; k <= tabu::geniNeighbours; k++){
-                // Index of k
-                size_t kIdx = kCandidates[k];
-                if (!cycleBetween(initial.size(), kIdx, jIdx, iIdx)) continue;
+            for (size_t k = 1; k < workspace.kCandidates.size(); k++){
+                // Index of k, which must lie on the path (j+1,...,i)
+                size_t kIdx = workspace.kCandidates[k];
+                if (!cycleBetween(n, kIdx, jIdx, iIdx)) continue;
+                size_t kNext = cycleNext(n, kIdx);
+                size_t kPrev = cyclePrev(n, kIdx);
                 if (kIdx != iIdx){
-                    vector<node> trialResult = geniType1(initial, newNode, iIdx, jIdx, kIdx);
-                    uint64_t trialDistance = sqrCost(trialResult);
-                    if (trialDistance < bestDistance){
-                        bestDistance = trialDistance;
-                        bestResult = trialResult;
+                    // Type I: adds (i+1,k), (j+1,k+1) and removes (k,k+1)
+                    double delta = commonDelta + d(iNext, kIdx) + d(jNext, kNext) - d(kIdx, kNext);
+                    scored++;
+                    if (delta < best.delta){
+                        best.type = geniMove::type1;
+                        best.i = iIdx;
+                        best.j = jIdx;
+                        best.k = kIdx;
+                        best.delta = delta;
                     }
                 }
-                vector<size_t> lCandidates = nodeList;
-                std::sort(lCandidates.begin(), lCandidates.end(),
-                          [&](const size_t& a, const size_t& b) { return distanceMatrix[jNext][a] < distanceMatrix[jNext][b]; });
+                if (kIdx == jNext) continue;
                 /////////
                 // L loop
-                for (size_t l = 1; l <= tabu::geniNeighbours; l++){
-                    // Index of l
+                for (size_t l = 1; l < lCandidates.size(); l++){
+                    // Index of l, which must lie on the path (i+2,...,j)
                     size_t lIdx = lCandidates[l];
-                    if (!cycleBetween(initial.size(), lIdx, iIdx, kIdx)) continue;
-                    if (kIdx != jNext && lIdx != iNext){
-                        vector<node> trialResult = geniType2(initial, newNode, iIdx, jIdx, kIdx, lIdx);
-                        uint64_t trialDistance = sqrCost(trialResult);
-                        if (trialDistance < bestDistance){
-                            bestDistance = trialDistance;
-                            bestResult = trialResult;
-                        }
+                    if (!cycleBetween(n, lIdx, iIdx, jIdx) || lIdx == iNext) continue;
+                    size_t lPrev = cyclePrev(n, lIdx);
+                    // Type II: adds (l,j+1), (k-1,l-1), (i+1,k) and removes (l-1,l), (k-1,k)
+                    double delta = commonDelta + d(lIdx, jNext) + d(kPrev, lPrev) + d(iNext, kIdx)
+                                 - d(lPrev, lIdx) - d(kPrev, kIdx);
+                    scored++;
+                    if (delta < best.delta){
+                        best.type = geniMove::type2;
+                        best.i = iIdx;
+                        best.j = jIdx;
+                        best.k = kIdx;
+                        best.l = lIdx;
+                        best.delta = delta;
                     }
                 }
             }
         }
     }
-    return bestResult;
+    if (grid){
+        for (size_t p = 0; p < n; p++) tourPosition[tour[p]] = 0;
+    }
+    CVRP_COUNT(geniCandidates, scored);
+    return best;
 }
 
-// Tabu Search not currently implemented
-solution tabu::search(solution initial, vector<uint16_t> movableNodes, uint16_t selectionCount, size_t iterations){
-    return initial;
+tabu::geniMove tabu::geniEvaluate(const vector<node>& initial, node newNode, const distanceCache& distances,
+                                  geniWorkspace& workspace){
+    vector<uint16_t>& tour = workspace.tourIndices;
+    tour.resize(initial.size());
+    for (size_t p = 0; p < initial.size(); p++) tour[p] = initial[p].num - 1;
+    return geniEvaluate(tour.data(), tour.size(), newNode.num - 1, distances, workspace);
 }
 
-solution tabu::taburoute(vector<node> nodes, uint16_t vehicleCapacity, default_random_engine& rng){
-    vector<saving> savings = calculateSavings(nodes);
-    // Stage 1: Calculate initial heuristic estimate
-    solution solution = calculateClarkeWrightSolution(nodes, savings, vehicleCapacity);
-    // Stage 2: Improve initial estimate with tabu search
+void tabu::geniApply(const uint16_t* tour, size_t n, uint16_t v, const geniMove& move, vector<uint16_t>& result){
+    geniApplyTour(tour, n, v, move, result);
+}
+void tabu::geniApply(const vector<node>& initial, node newNode, const geniMove& move, vector<node>& result){
+    geniApplyTour(initial.data(), initial.size(), newNode, move, result);
+}
+
+double tabu::geniInsert(const vector<node>& initial, node newNode, const distanceCache& distances,
+                        geniWorkspace& workspace, vector<node>& result){
+    geniMove move = geniEvaluate(initial, newNode, distances, workspace);
+    geniApply(initial, newNode, move, result);
+    return move.delta;
+}
+
+vector<node> tabu::geniInsert(const vector<node>& initial, node newNode, const distanceCache& distances){
+    geniWorkspace workspace;
+    vector<node> result;
+    geniInsert(initial, newNode, distances, workspace, result);
+    return result;
+}
+
+// Taburoute search (Gendreau, Hertz & Laporte, 1994): at each iteration a random sample of 'selectionCount'
+// movable nodes is considered for relocation into a route containing one of their nearest neighbours (or into
+// an unused vehicle), the best non-tabu move is made using GENI insertion, and moving the node back into its
+// previous route is forbidden for a random number of iterations. Capacity violations are allowed but penalised
+// as in solution::getInfeasibleCost, with the penalty adjusted every 'feasibilityModTime' iterations.
+// Moves are evaluated from the few edges they touch, using the route costs and loads cached by the solution,
+// so that only the move that is actually made needs a route rebuilt.
+// If enabled, both routes changed by each move are then reordered by intra-route 2-opt. The search keeps
+// returning to the same routes, so the reordering of each route is looked up in a route cache by the route's
+// hash and only computed the first time the route is seen.
+// If enabled, each new best solution is first polished by local search starting from the nodes whose edges
+// have changed since it last ran, and the search carries on from the polished solution.
+// A search given a state to resume (control.resume) takes every variable below from it instead, and one given a
+// checkpoint callback saves them all at the end of an iteration whenever the checkpoint interval has passed.
+// Returns the best feasible solution found.
+compactSolution tabu::search(compactSolution current, const vector<uint16_t>& movableNodes, uint16_t selectionCount,
+                             size_t iterations, uint16_t vehicleCapacity, default_random_engine& rng,
+                             const searchControl& control){
+    if (movableNodes.empty() || iterations == 0) return current;
+    CVRP_SCOPE("tabuSearch");
+    const searchState* resume = control.resume;
+    const vector<node>& nodes = current.problemNodes();
+    const distanceCache& distances = current.problemDistances();
+    // Keep a single empty vehicle available so that a node can always be moved into a new route
+    size_t emptyRoute;
+    if (resume){
+        validateSearchState(*resume, nodes.size());
+        emptyRoute = resume->emptyRoute;
+    }
+    else{
+        current.removeEmptyRoutes();
+        emptyRoute = current.addRoute();
+    }
+    searchWorkspace temporaryScratch;
+    searchWorkspace& scratch = control.workspace ? *control.workspace : temporaryScratch;
+    auto overload = [&](int load) { return load > vehicleCapacity ? load - vehicleCapacity : 0; };
+    double penalty = resume ? resume->penalty : 1.0;
+    double currentCost = current.cost();
+    int currentOverload = 0;
+    for (size_t r = 0; r < current.routeCount(); r++) currentOverload += overload(current.load(r));
+
+    // The best solution is kept without the spare empty route
+    compactSolution best;
+    auto recordBest = [&]{
+        best = current;
+        best.removeEmptyRoutes();
+    };
+    double bestCost;
+    if (resume){
+        best = compactSolution(nodes, distances);
+        for (const auto& route : resume->best) best.appendRoute(route.data(), route.size());
+        bestCost = resume->bestCost;
+    }
+    else{
+        recordBest();
+        bestCost = currentOverload == 0 ? currentCost : numeric_limits<double>::max();
+        if (currentOverload == 0 && control.improved) control.improved(best, bestCost, 0);
+    }
+
+    // Tabu status: a node may not return to the route it last left until the given iteration
+    vector<size_t>& tabuRoute = scratch.tabuRoute;
+    vector<size_t>& tabuUntil = scratch.tabuUntil;
+    tabuRoute.assign(nodes.size(), numeric_limits<size_t>::max());
+    tabuUntil.assign(nodes.size(), 0);
+    uniform_int_distribution<size_t> tabuDuration(tabuDurationMin, tabuDurationMax);
+    // Number of times each node has been moved, used to penalise frequently repeated moves
+    vector<size_t>& moveCount = scratch.moveCount;
+    moveCount.assign(nodes.size(), 0);
+    double maxObjectiveChange = resume ? resume->maxObjectiveChange : 0;
+    size_t infeasibleIterations = resume ? resume->infeasibleIterations : 0;
+    if (resume){
+        tabuRoute = resume->tabuRoute;
+        tabuUntil = resume->tabuUntil;
+        moveCount = resume->moveCount;
+    }
+    // Tallies for telemetry
+    size_t accepted = 0, rejected = 0, decreases = 0, increases = 0, improvements = 0;
+
+    // Scratch space reused by every insertion
+    geniWorkspace& workspace = scratch.geni;
+
+    vector<uint16_t>& candidates = scratch.candidates;
+    candidates.assign(movableNodes.begin(), movableNodes.end());
+    if (resume) candidates = resume->candidates;
+    size_t sampleSize = min<size_t>(selectionCount, candidates.size());
+    size_t neighbourCount = min(distances.neighbourCount(), tabuNeighbours);
+
+    vector<uint16_t>& changed = scratch.changed;
+    vector<bool>& isChanged = scratch.isChanged;
+    changed.clear();
+    isChanged.assign(nodes.size(), false);
+    auto markChanged = [&](size_t v){
+        if (v == 0 || isChanged[v]) return;
+        isChanged[v] = true;
+        changed.push_back(static_cast<uint16_t>(v));
+    };
+    if (resume){
+        for (uint16_t v : resume->changed) markChanged(v);
+    }
+    // Removes route r, which must be empty; later routes move down one index
+    auto removeEmptyRoute = [&](size_t r){
+        current.removeRoute(r);
+        if (emptyRoute > r) emptyRoute--;
+        for (size_t n = 0; n < nodes.size(); n++){
+            if (tabuRoute[n] == r) tabuRoute[n] = numeric_limits<size_t>::max();
+            else if (tabuRoute[n] != numeric_limits<size_t>::max() && tabuRoute[n] > r) tabuRoute[n]--;
+        }
+    };
+
+    unique_ptr<routeCache> ownCache;
+    routeCache* cache = control.routeOptimization ? control.routes : nullptr;
+    if (control.routeOptimization && !cache){
+        ownCache.reset(new routeCache());
+        cache = ownCache.get();
+    }
+    routeHasher hasher(cache ? nodes.size() : 0);
+    routeEntry entry;
+    // Replaces route t with its 2-opt reordering if that is cheaper
+    auto optimizeRoute = [&](size_t t){
+        size_t length = current.routeLength(t);
+        if (length < 3) return;
+        uint64_t hash = hasher.hash(current.route(t), length);
+        if (!cache->find(hash, length, entry)){
+            entry.optimized.assign(current.route(t), current.route(t) + length);
+            entry.optimizedCost = current.routeCost(t) - local::twoOptRoute(entry.optimized.data(), length, distances);
+            cache->insert(hash, length, entry);
+        }
+        if (entry.optimizedCost >= current.routeCost(t) - local::improvementEpsilon) return;
+        current.setRoute(t, entry.optimized.data(), length);
+        for (size_t p = 0; p < length; p++) markChanged(current.route(t)[p]);
+    };
+
+    // Clock reads are spread over several iterations, doubling or halving the spacing to keep them roughly
+    // deadlineCheckPeriod apart
+    size_t firstIteration = resume ? resume->iteration + 1 : 1;
+    size_t clockInterval = 1;
+    size_t nextClockCheck = firstIteration;
+    chrono::steady_clock::time_point lastClockCheck = chrono::steady_clock::now();
+
+    // Passes the state at the end of the given iteration to the checkpoint callback
+    chrono::steady_clock::time_point lastCheckpoint = lastClockCheck;
+    auto checkpointPeriod = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(control.checkpointSeconds));
+    auto saveState = [&](size_t iteration){
+        searchState state;
+        state.iteration = iteration;
+        state.iterations = iterations;
+        state.selectionCount = selectionCount;
+        state.penalty = penalty;
+        state.maxObjectiveChange = maxObjectiveChange;
+        state.infeasibleIterations = infeasibleIterations;
+        for (size_t r = 0; r < current.routeCount(); r++){
+            state.current.emplace_back(current.route(r), current.route(r) + current.routeLength(r));
+        }
+        state.emptyRoute = emptyRoute;
+        for (size_t r = 0; r < best.routeCount(); r++){
+            state.best.emplace_back(best.route(r), best.route(r) + best.routeLength(r));
+        }
+        state.bestCost = bestCost;
+        state.tabuRoute = tabuRoute;
+        state.tabuUntil = tabuUntil;
+        state.moveCount = moveCount;
+        state.candidates = candidates;
+        state.changed = changed;
+        ostringstream engine;
+        engine << rng;
+        state.rng = engine.str();
+        control.checkpoint(state);
+    };
+
+    for (size_t iteration = firstIteration; iteration <= iterations; iteration++){
+        if (control.stop && control.stop->load(memory_order_relaxed)) break;
+        if (control.hasDeadline && iteration == nextClockCheck){
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (now >= control.deadline) break;
+            if (now - lastClockCheck < deadlineCheckPeriod) clockInterval *= 2;
+            else if (clockInterval > 1) clockInterval /= 2;
+            lastClockCheck = now;
+            nextClockCheck = iteration + clockInterval;
+        }
+        // Partial Fisher-Yates shuffle to select the sample of nodes to be considered
+        for (size_t s = 0; s < sampleSize; s++){
+            uniform_int_distribution<size_t> pick(s, candidates.size() - 1);
+            swap(candidates[s], candidates[pick(rng)]);
+        }
+        // Non-improving moves are penalised in proportion to how often the moved node has been moved before
+        double diversification = tabuPenaltyScaling * maxObjectiveChange
+                               * sqrt(static_cast<double>(current.routeCount())) / iteration;
+        bool moveFound = false;
+        double bestScore = numeric_limits<double>::max();
+        double bestDelta = 0;
+        uint16_t moveNode = 0;
+        size_t moveTarget = 0;
+        for (size_t s = 0; s < sampleSize; s++){
+            size_t v = candidates[s] - 1;
+            size_t r = current.routeOf(v);
+            double removeDelta = current.removalDelta(v);
+            int demand = nodes[v].demand;
+            int removeOverload = overload(current.load(r) - demand) - overload(current.load(r));
+            const uint16_t* neighbours = distances.neighbours(v);
+            // Evaluates the insertion of v into route t with cost change insertDelta
+            auto evaluate = [&](size_t t, double insertDelta){
+                double delta = removeDelta + insertDelta;
+                int overloadDelta = removeOverload + overload(current.load(t) + demand) - overload(current.load(t));
+                double objectiveDelta = delta + penalty * overloadDelta;
+                bool aspiration = currentOverload + overloadDelta == 0 && currentCost + delta < bestCost - 1e-9;
+                if (tabuRoute[v] == t && tabuUntil[v] >= iteration && !aspiration){
+                    rejected++;
+                    return;
+                }
+                double score = objectiveDelta;
+                if (objectiveDelta > 0) score += diversification * moveCount[v];
+                if (score < bestScore){
+                    bestScore = score;
+                    bestDelta = objectiveDelta;
+                    moveNode = static_cast<uint16_t>(v);
+                    moveTarget = t;
+                    moveFound = true;
+                }
+            };
+            // Insertion next to each of the nearest neighbours of v that lie in a different route
+            for (size_t n = 0; n < neighbourCount; n++){
+                size_t w = neighbours[n];
+                if (w == 0 || current.routeOf(w) == r) continue;
+                double beforeDelta = current.insertionDelta(v, current.previous(w), w);
+                double afterDelta = current.insertionDelta(v, w, current.next(w));
+                evaluate(current.routeOf(w), min(beforeDelta, afterDelta));
+            }
+            // Insertion into the empty vehicle, unless v would just leave a route of its own
+            if (current.routeLength(r) > 1) evaluate(emptyRoute, 2 * distances(0, v));
+        }
+        if (moveFound){
+            size_t v = moveNode;
+            size_t r = current.routeOf(v);
+            accepted++;
+            markChanged(v);
+            markChanged(current.previous(v));
+            markChanged(current.next(v));
+            current.remove(v);
+            // Insert v into its new route with GENI, which starts the tour at an arbitrary node
+            vector<uint16_t>& tour = workspace.tourIndices;
+            tour.assign(1, 0);
+            tour.insert(tour.end(), current.route(moveTarget), current.route(moveTarget) + current.routeLength(moveTarget));
+            geniMove move = geniEvaluate(tour.data(), tour.size(), v, distances, workspace);
+            vector<uint16_t>& inserted = workspace.insertedTour;
+            geniApply(tour.data(), tour.size(), static_cast<uint16_t>(v), move, inserted);
+            rotate(inserted.begin(), find(inserted.begin(), inserted.end(), 0), inserted.end());
+            current.setRoute(moveTarget, inserted.data() + 1, inserted.size() - 1);
+            // GENI may reorder the whole of the new route
+            for (size_t p = 0; p < current.routeLength(moveTarget); p++) markChanged(current.route(moveTarget)[p]);
+            if (cache){
+                optimizeRoute(moveTarget);
+                optimizeRoute(r);
+            }
+
+            tabuRoute[v] = r;
+            tabuUntil[v] = iteration + tabuDuration(rng);
+            moveCount[v]++;
+            maxObjectiveChange = max(maxObjectiveChange, fabs(bestDelta));
+            // Keep exactly one empty vehicle available
+            bool sourceEmpty = current.routeLength(r) == 0;
+            if (moveTarget == emptyRoute && sourceEmpty){
+                emptyRoute = r;
+            }
+            else if (moveTarget == emptyRoute){
+                emptyRoute = current.addRoute();
+            }
+            else if (sourceEmpty){
+                removeEmptyRoute(r);
+            }
+            currentCost = current.cost();
+            currentOverload = 0;
+            for (size_t t = 0; t < current.routeCount(); t++) currentOverload += overload(current.load(t));
+            if (currentOverload == 0 && currentCost < bestCost - 1e-9){
+                if (control.localSearch){
+                    local::improve(current, vehicleCapacity, changed.data(), changed.size(), scratch.localSearch);
+                    // Local search may empty routes, but never uses the spare one
+                    for (size_t t = current.routeCount(); t-- > 0;){
+                        if (t != emptyRoute && current.routeLength(t) == 0) removeEmptyRoute(t);
+                    }
+                    currentCost = current.cost();
+                }
+                for (uint16_t c : changed) isChanged[c] = false;
+                changed.clear();
+                improvements++;
+                bestCost = currentCost;
+                recordBest();
+                if (control.improved) control.improved(best, bestCost, iteration);
+            }
+        }
+        // Adjust the capacity penalty depending on how often recent solutions were infeasible
+        if (currentOverload > 0) infeasibleIterations++;
+        if (iteration % feasibilityModTime == 0){
+            if (infeasibleIterations == 0){
+                penalty /= 2;
+                decreases++;
+            }
+            else if (infeasibleIterations == feasibilityModTime){
+                penalty *= 2;
+                increases++;
+            }
+            infeasibleIterations = 0;
+        }
+        if (control.checkpoint && iteration % checkpointCheckIterations == 0){
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (now - lastCheckpoint >= checkpointPeriod){
+                saveState(iteration);
+                lastCheckpoint = now;
+            }
+        }
+    }
+    CVRP_COUNT(tabuMovesAccepted, accepted);
+    CVRP_COUNT(tabuMovesRejected, rejected);
+    CVRP_COUNT(penaltyDecreases, decreases);
+    CVRP_COUNT(penaltyIncreases, increases);
+    CVRP_COUNT(bestSolutions, improvements);
+    if (ownCache) CVRP_GAUGE(routeCacheRoutes, ownCache->size());
+    return best;
+}
+
+compactSolution tabu::improve(const compactSolution& initial, uint16_t vehicleCapacity, default_random_engine& rng,
+                              const searchControl& control){
+    size_t nodeCount = initial.problemNodes().size();
     vector<uint16_t> movableNodes;
-    for (uint16_t i = 2; i <= nodes.size(); i++) movableNodes.push_back(i);
-    uint16_t selectionCount = 5 * solution.vehicles.size();
-    solution = tabu::search(solution, movableNodes, selectionCount, 50*nodes.size());
+    for (size_t i = 2; i <= nodeCount; i++) movableNodes.push_back(static_cast<uint16_t>(i));
+    uint16_t selectionCount = 5 * initial.routeCount();
+    size_t iterations = control.iterationLimit ? control.iterationLimit : 50*nodeCount;
+    return tabu::search(initial, movableNodes, selectionCount, iterations, vehicleCapacity, rng, control);
+}
+
+void tabu::validateSearchState(const searchState& state, size_t nodeCount){
+    auto isCustomer = [nodeCount](uint16_t v) { return v != 0 && v < nodeCount; };
+    // Throws unless the routes visit every customer exactly once
+    auto checkRoutes = [&](const vector<vector<uint16_t>>& routes, const char* which){
+        vector<bool> routed(nodeCount, false);
+        size_t routedCount = 0;
+        for (const auto& route : routes){
+            for (uint16_t v : route){
+                if (!isCustomer(v) || routed[v]){
+                    throw invalid_argument(string("Search state's ") + which + " solution does not match the problem.");
+                }
+                routed[v] = true;
+                routedCount++;
+            }
+        }
+        if (routedCount + 1 != nodeCount){
+            throw invalid_argument(string("Search state's ") + which + " solution leaves customers unrouted.");
+        }
+    };
+    checkRoutes(state.current, "current");
+    checkRoutes(state.best, "best");
+    if (state.emptyRoute >= state.current.size() || !state.current[state.emptyRoute].empty()){
+        throw invalid_argument("Search state has no spare route.");
+    }
+    if (state.tabuRoute.size() != nodeCount || state.tabuUntil.size() != nodeCount || state.moveCount.size() != nodeCount){
+        throw invalid_argument("Search state does not match the problem.");
+    }
+    // Candidates are node numbers, one more than their indices
+    vector<bool> isCandidate(nodeCount, false);
+    for (uint16_t number : state.candidates){
+        if (number == 0 || !isCustomer(number - 1) || isCandidate[number - 1]){
+            throw invalid_argument("Search state has invalid candidates.");
+        }
+        isCandidate[number - 1] = true;
+    }
+    for (uint16_t v : state.changed){
+        if (!isCustomer(v)) throw invalid_argument("Search state has invalid changed nodes.");
+    }
+    if (state.selectionCount == 0) throw invalid_argument("Search state has no selection count.");
+}
+
+compactSolution tabu::resumeSearch(const searchState& state, const vector<node>& nodes, uint16_t vehicleCapacity,
+                                  const distanceCache& distances, const searchControl& control){
+    validateSearchState(state, nodes.size());
+    compactSolution current(nodes, distances);
+    for (const auto& route : state.current) current.appendRoute(route.data(), route.size());
+    default_random_engine rng;
+    istringstream engine(state.rng);
+    engine >> rng;
+    if (!engine) throw invalid_argument("Search state has an invalid random engine state.");
+    searchControl resumed = control;
+    resumed.resume = &state;
+    vector<uint16_t> movableNodes(state.candidates);
+    sort(movableNodes.begin(), movableNodes.end());
+    return tabu::search(current, movableNodes, state.selectionCount, state.iterations, vehicleCapacity, rng, resumed);
+}
+
+solution tabu::taburoute(vector<node> nodes, uint16_t vehicleCapacity, default_random_engine& rng,
+                         const searchControl& control){
+    distanceCache distances(nodes);
+    return tabu::taburoute(nodes, vehicleCapacity, distances, rng, control).toSolution();
+}
+
+// Returns the Clarke-Wright solution chosen by 'control', improved by local search if enabled
+static compactSolution initialRoutes(const vector<node>& nodes, uint16_t vehicleCapacity,
+                                     const distanceCache& distances, const tabu::searchControl& control){
+    compactSolution solution;
+    if (control.savingsSweep){
+        solution = sweepClarkeWright(nodes, vehicleCapacity, distances, defaultSavingsGrid(), control.sweepThreads,
+                                     control.savingsNeighbours).solution;
+    }
+    else{
+        solution = clarkeWrightRoutes(nodes, vehicleCapacity, distances, control.savingsNeighbours);
+    }
+    if (control.localSearch){
+        local::workspace temporaryScratch;
+        local::improve(solution, vehicleCapacity, control.workspace ? control.workspace->localSearch : temporaryScratch);
+        solution.removeEmptyRoutes();
+    }
     return solution;
 }
+
+compactSolution tabu::taburoute(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                default_random_engine& rng, const searchControl& control){
+    // Stage 1: Calculate initial heuristic estimate
+    compactSolution solution = initialRoutes(nodes, vehicleCapacity, distances, control);
+    // Stage 2: Improve initial estimate with tabu search
+    return tabu::improve(solution, vehicleCapacity, rng, control);
+}
+
+// Runs a Taburoute search from 'initial' in legs that share their solutions through 'elite', publishing each
+// leg's new best solutions to the pool. Every leg after the first starts from a random member of the pool or,
+// after every other leg, from the cheapest solution on the path relinking two random members, polished by local
+// search; a leg carries on from the previous leg's result while it finds the pool empty. Returns the best
+// solution of any leg.
+static compactSolution cooperativeSearch(const compactSolution& initial, uint16_t vehicleCapacity,
+                                         default_random_engine& rng, const tabu::searchControl& control,
+                                         elitePool& elite, size_t participant, size_t legs){
+    size_t nodeCount = initial.problemNodes().size();
+    size_t iterations = control.iterationLimit ? control.iterationLimit : 50*nodeCount;
+    legs = max<size_t>(1, min(legs, iterations));
+    tabu::searchControl legControl = control;
+    legControl.iterationLimit = iterations / legs;
+    // Iterations of the legs before the current one, so that improvements are reported with the search's
+    // cumulative iteration count rather than the leg's own
+    size_t legIterations = 0;
+    legControl.improved = [&](const compactSolution& improved, double cost, size_t iteration){
+        elite.offer(improved, cost, participant);
+        if (control.improved) control.improved(improved, cost, legIterations + iteration);
+    };
+    local::workspace temporaryScratch;
+    local::workspace& scratch = control.workspace ? control.workspace->localSearch : temporaryScratch;
+    uniform_int_distribution<size_t> pick(0, elite.capacity() - 1);
+    compactSolution start = initial;
+    compactSolution best = initial;
+    double bestCost = initial.cost();
+    compactSolution first, second, relinked;
+    double firstCost, secondCost;
+    for (size_t leg = 0; leg < legs; leg++){
+        if (control.stop && control.stop->load(memory_order_relaxed)) break;
+        if (control.hasDeadline && chrono::steady_clock::now() >= control.deadline) break;
+        compactSolution found = tabu::improve(start, vehicleCapacity, rng, legControl);
+        legIterations += legControl.iterationLimit;
+        double foundCost = found.cost();
+        if (foundCost < bestCost){
+            best = found;
+            bestCost = foundCost;
+        }
+        start = found;
+        if (!elite.get(pick(rng), first, firstCost, participant)) continue;
+        start = first;
+        if (leg % 2 != 0 || !elite.get(pick(rng), second, secondCost, participant)) continue;
+        if (!pathRelink(first, second, vehicleCapacity, relinked)) continue;
+        if (control.localSearch){
+            local::improve(relinked, vehicleCapacity, scratch);
+            relinked.removeEmptyRoutes();
+        }
+        double relinkedCost = relinked.cost();
+        if (relinkedCost < bestCost){
+            best = relinked;
+            bestCost = relinkedCost;
+        }
+        // Reported as found at the end of the leg just run
+        legControl.improved(relinked, relinkedCost, 0);
+        start = relinked;
+    }
+    return best;
+}
+
+// Each start improves the shared Clarke-Wright solution with its own random engine, seeded from the base
+// seed and the start's index so that a start's trajectory does not depend on which worker runs it or when.
+// Starts publish every improvement to a shared best solution, which is only used for reporting and to decide
+// when the target cost has been reached; the returned solution is chosen from the final results of all starts,
+// preferring the lowest start index among equal costs. Cooperating starts also share the elite pool, whose
+// members at any time depend on how the starts' legs interleave.
+compactSolution tabu::multiStartTaburoute(const vector<node>& nodes, uint16_t vehicleCapacity,
+                                          const distanceCache& distances, const multiStartOptions& options,
+                                          const searchControl& control){
+    CVRP_SCOPE("multiStart");
+    compactSolution initial = initialRoutes(nodes, vehicleCapacity, distances, control);
+    size_t starts = max<size_t>(1, options.starts);
+    vector<compactSolution> results(starts);
+    vector<double> resultCosts(starts, numeric_limits<double>::max());
+    sharedBestSolution shared;
+    atomic<bool> stop(false);
+    mutex reportLock;
+    searchControl startControl = control;
+    startControl.stop = &stop;
+    startControl.improved = [&](const compactSolution& improved, double cost, size_t iteration){
+        if (cost >= shared.cost()) return;
+        lock_guard<mutex> guard(reportLock);
+        if (!shared.offer(improved, cost)) return;
+        if (control.improved) control.improved(improved, cost, iteration);
+        if (cost <= options.targetCost) stop.store(true);
+    };
+    // The starts share one route cache, as they reorder the same routes of the same problem
+    unique_ptr<routeCache> sharedRoutes;
+    if (control.routeOptimization && !control.routes){
+        sharedRoutes.reset(new routeCache());
+        startControl.routes = sharedRoutes.get();
+    }
+    threadPool pool(options.threads);
+    vector<searchWorkspace> workspaces(pool.size());
+    unique_ptr<elitePool> elite;
+    if (options.eliteSize) elite.reset(new elitePool(options.eliteSize, pool.size()));
+    for (size_t start = 0; start < starts; start++){
+        pool.submit([&, start](size_t worker){
+            seed_seq seeds{ options.seed, static_cast<unsigned>(start) };
+            default_random_engine rng(seeds);
+            searchControl workerControl = startControl;
+            workerControl.workspace = &workspaces[worker];
+            if (elite){
+                results[start] = cooperativeSearch(initial, vehicleCapacity, rng, workerControl, *elite, worker,
+                                                   options.cooperationLegs);
+            }
+            else{
+                results[start] = tabu::improve(initial, vehicleCapacity, rng, workerControl);
+            }
+            resultCosts[start] = results[start].cost();
+        });
+    }
+    pool.wait();
+    if (sharedRoutes) CVRP_GAUGE(routeCacheRoutes, sharedRoutes->size());
+    size_t bestStart = min_element(resultCosts.begin(), resultCosts.end()) - resultCosts.begin();
+    return results[bestStart];
+}
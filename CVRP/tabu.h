@@ -1,7 +1,16 @@
 #pragma once
 
 #include <random>
+#include <limits>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <string>
+#include <vector>
 #include "cvrp.h"
+#include "routes.h"
+#include "localsearch.h"
+#include "routecache.h"
 
 namespace cvrp{
 
@@ -16,14 +25,217 @@ namespace cvrp{
 
         const size_t geniNeighbours = 5;
 
-        vector<node> geniType1(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k);
-        vector<node> geniType2(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, size_t l);
+        // Length of tour from which GENI finds the nearest tour nodes with the spatial index rather than by
+        // ranking every node of the tour
+        const size_t geniSpatialThreshold = 256;
 
-        vector<node> geniInsert(const vector<node>& initial, node newNode);
+        // Number of nearest neighbours of a node whose routes are considered as destinations for that node
+        const size_t tabuNeighbours = 10;
 
-        solution search(solution initial, vector<uint16_t> movableNodes, uint16_t selectionCount, size_t iterations);
+        // A candidate insertion of a node into a tour, identified by its type and the tour positions it uses
+        struct geniMove{
+            enum moveType { none, plain, type1, type2 };
+            geniMove()
+                : type(none), i(0), j(0), k(0), l(0), delta(numeric_limits<double>::max()) {}
+            moveType type;
+            size_t i;
+            size_t j;
+            size_t k;
+            size_t l;
+            // Change in tour cost caused by the insertion
+            double delta;
+        };
+
+        // Scratch buffers for GENI insertion; keeping one alive across insertions means they stop allocating
+        // once the buffers have grown to the largest tour seen
+        struct geniWorkspace{
+            vector<uint16_t> tourIndices;
+            vector<double> newNodeDistances;
+            vector<double> candidateDistances;
+            vector<double> insertionCosts;
+            vector<size_t> positions;
+            vector<size_t> nearest;
+            vector<size_t> kCandidates;
+            vector<size_t> lCandidates;
+            // Position + 1 of each node in the tour being evaluated, or 0, for spatial index queries
+            vector<uint32_t> tourPosition;
+            vector<uint16_t> found;
+            vector<node> route;
+            vector<uint16_t> insertedTour;
+        };
+
+        void geniType1(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, vector<node>& result);
+        void geniType2(const vector<node>& initial, node newNode, size_t i, size_t j, size_t k, size_t l, vector<node>& result);
+
+        // Returns the cheapest GENI insertion of node index v into the closed tour of node indices 'tour' of
+        // length n
+        geniMove geniEvaluate(const uint16_t* tour, size_t n, size_t v, const distanceCache& distances,
+                              geniWorkspace& workspace);
+        // Returns the cheapest GENI insertion of newNode into the tour 'initial'
+        geniMove geniEvaluate(const vector<node>& initial, node newNode, const distanceCache& distances,
+                              geniWorkspace& workspace);
+        // Writes the tour produced by applying 'move' to the tour of node indices 'tour' into 'result'
+        void geniApply(const uint16_t* tour, size_t n, uint16_t v, const geniMove& move, vector<uint16_t>& result);
+        // Writes the tour produced by applying 'move' to 'initial' into 'result'
+        void geniApply(const vector<node>& initial, node newNode, const geniMove& move, vector<node>& result);
+
+        // Inserts newNode into the tour 'initial' using the GENI heuristic, writing the new tour into 'result'
+        // and returning the change in tour cost
+        double geniInsert(const vector<node>& initial, node newNode, const distanceCache& distances,
+                          geniWorkspace& workspace, vector<node>& result);
+        // As above, returning the new tour
+        vector<node> geniInsert(const vector<node>& initial, node newNode, const distanceCache& distances);
+
+        // Scratch buffers for a tabu search; a worker that keeps one alive across searches reuses its allocations
+        // from one search, or problem, to the next
+        struct searchWorkspace{
+            vector<size_t> tabuRoute;
+            vector<size_t> tabuUntil;
+            vector<size_t> moveCount;
+            vector<uint16_t> candidates;
+            // Nodes whose edges have changed since local search last ran
+            vector<uint16_t> changed;
+            vector<bool> isChanged;
+            geniWorkspace geni;
+            local::workspace localSearch;
+        };
+
+        // Everything a tabu search needs to carry on from the end of an iteration exactly as if it had not stopped
+        struct searchState{
+            searchState()
+                : iteration(0), iterations(0), selectionCount(0), penalty(1), maxObjectiveChange(0),
+                  infeasibleIterations(0), emptyRoute(0), bestCost(numeric_limits<double>::max()) {}
+            // Iterations completed, and the number the search runs for
+            size_t iteration;
+            size_t iterations;
+            uint16_t selectionCount;
+            double penalty;
+            double maxObjectiveChange;
+            size_t infeasibleIterations;
+            // Routes of the current solution as node indices, including the spare empty route
+            vector<vector<uint16_t>> current;
+            size_t emptyRoute;
+            // Routes of the best feasible solution and its cost, which is the largest double if there is none yet
+            vector<vector<uint16_t>> best;
+            double bestCost;
+            vector<size_t> tabuRoute;
+            vector<size_t> tabuUntil;
+            vector<size_t> moveCount;
+            // Movable node numbers in their current sampling order
+            vector<uint16_t> candidates;
+            // Nodes whose edges have changed since local search last ran
+            vector<uint16_t> changed;
+            // State of the random engine, as written by its operator<<
+            string rng;
+        };
+
+        // Target interval between clock reads when a search has a deadline; the number of iterations between
+        // reads is adapted to the observed iteration speed
+        const chrono::microseconds deadlineCheckPeriod(1000);
+        // Number of iterations between clock reads when a search has a checkpoint callback
+        const size_t checkpointCheckIterations = 64;
+
+        // Optional controls for a running search
+        struct searchControl{
+            searchControl()
+                : stop(nullptr), hasDeadline(false), iterationLimit(0), localSearch(true), savingsNeighbours(0),
+                  savingsSweep(false), sweepThreads(0), routeOptimization(true),
+                  routes(nullptr), checkpointSeconds(60), resume(nullptr), workspace(nullptr) {}
+            // Sets the deadline to the given number of seconds from now
+            void setTimeLimit(double seconds){
+                hasDeadline = true;
+                deadline = chrono::steady_clock::now()
+                         + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(seconds));
+            }
+            // The search returns its best solution as soon as this flag is set
+            const atomic<bool>* stop;
+            // The search returns its best solution once this time has passed, if hasDeadline is set
+            bool hasDeadline;
+            chrono::steady_clock::time_point deadline;
+            // Overrides the default iteration count of improve() if nonzero
+            size_t iterationLimit;
+            // Applies granular local search to the Clarke-Wright solution and to each new best solution
+            bool localSearch;
+            // Builds the Clarke-Wright solution from the savings with this many nearest neighbours of each
+            // customer, or if 0, chooses between the complete and sparse savings lists by problem size
+            size_t savingsNeighbours;
+            // Starts from the cheapest Clarke-Wright solution over defaultSavingsGrid() instead of the classic
+            // savings, built on 'sweepThreads' threads (one per hardware thread if 0)
+            bool savingsSweep;
+            size_t sweepThreads;
+            // Reorders both routes changed by each move with intra-route 2-opt, remembering the result for each
+            // route in 'routes', or if that is null, in a cache of the search's own; 'routes' is not used when
+            // this is off
+            bool routeOptimization;
+            routeCache* routes;
+            // Called with each new best feasible solution, its cost and the iteration it was found at; the
+            // starting solution is reported as iteration 0 if it is feasible
+            function<void(const compactSolution& best, double cost, size_t iteration)> improved;
+            // Called with the search's state about every 'checkpointSeconds' seconds, if set
+            function<void(const searchState& state)> checkpoint;
+            double checkpointSeconds;
+            // Carries on a search from this state instead of starting one; see resumeSearch()
+            const searchState* resume;
+            // Scratch space to use instead of a temporary one; it must not be shared by concurrent searches
+            searchWorkspace* workspace;
+        };
+
+        compactSolution search(compactSolution initial, const vector<uint16_t>& movableNodes, uint16_t selectionCount,
+                               size_t iterations, uint16_t vehicleCapacity, default_random_engine& rng,
+                               const searchControl& control = searchControl());
+
+        // Improves 'initial' using tabu search with the standard Taburoute settings
+        compactSolution improve(const compactSolution& initial, uint16_t vehicleCapacity, default_random_engine& rng,
+                                const searchControl& control = searchControl());
         
-        solution taburoute(vector<node> nodes, uint16_t vehicleCapacity, default_random_engine& rng);
+        solution taburoute(vector<node> nodes, uint16_t vehicleCapacity, default_random_engine& rng,
+                           const searchControl& control = searchControl());
+        compactSolution taburoute(const vector<node>& nodes, uint16_t vehicleCapacity, const distanceCache& distances,
+                                  default_random_engine& rng, const searchControl& control = searchControl());
+
+        // Number of legs that each cooperating search's iterations are divided into
+        const size_t defaultCooperationLegs = 8;
+
+        struct multiStartOptions{
+            multiStartOptions()
+                : starts(1), threads(0), seed(0), targetCost(0), eliteSize(0),
+                  cooperationLegs(defaultCooperationLegs) {}
+            // Number of searches
+            size_t starts;
+            // Number of worker threads, or 0 for one per hardware thread
+            size_t threads;
+            unsigned seed;
+            // Stop every search once a solution at most this cost is found (0 disables)
+            double targetCost;
+            // Number of solutions in the elite pool shared by the searches, or 0 for independent searches.
+            // Cooperating searches publish each new best solution to the pool and run in 'cooperationLegs'
+            // legs; every leg after the first starts from a member of the pool or, every other leg, from the
+            // best solution on the path relinking two members.
+            size_t eliteSize;
+            size_t cooperationLegs;
+        };
+
+        // Throws invalid_argument unless 'state' could be the state of a search of a problem with 'nodeCount'
+        // nodes: every node index it holds is a customer of the problem, the current and best solutions route
+        // each customer exactly once, the current solution has its spare empty route, the per-node arrays
+        // cover every node and the selection count is positive
+        void validateSearchState(const searchState& state, size_t nodeCount);
+
+        // Carries on the search that was in the given state, as saved by a checkpoint, returning the best
+        // feasible solution found over the whole search. The problem must be the one the search was solving;
+        // a state that cannot belong to it is rejected with invalid_argument.
+        compactSolution resumeSearch(const searchState& state, const vector<node>& nodes, uint16_t vehicleCapacity,
+                                     const distanceCache& distances, const searchControl& control = searchControl());
+
+        // Runs several differently seeded Taburoute searches in parallel from the same Clarke-Wright solution
+        // and returns the best result. The deadline and iteration limit of 'control' apply to every search, and
+        // its callback is called, one at a time, with each solution that improves on those found by all searches.
+        // Unless 'control' gives a route cache, the searches share one.
+        // The result depends only on the options and not on thread scheduling, unless a target cost or deadline
+        // stops the searches early, or the searches cooperate through an elite pool.
+        compactSolution multiStartTaburoute(const vector<node>& nodes, uint16_t vehicleCapacity,
+                                            const distanceCache& distances, const multiStartOptions& options,
+                                            const searchControl& control = searchControl());
 
     }
 
@@ -0,0 +1,167 @@
+#include "telemetry.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <iomanip>
+
+using namespace std;
+using namespace cvrp;
+
+// Visual C++ before 2015 only supports thread-local storage of plain data
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define CVRP_THREAD_LOCAL __declspec(thread)
+#else
+#define CVRP_THREAD_LOCAL thread_local
+#endif
+
+namespace{
+
+    struct span{
+        const char* name;
+        int64_t start;
+        int64_t duration;
+    };
+
+    // Telemetry of one thread. Only the owning thread writes to it; counters are atomic so that totals()
+    // can read them while the thread runs, but are updated with plain loads and stores as there is one writer.
+    struct threadData{
+        threadData(){
+            for (auto& c : counters) c.store(0, memory_order_relaxed);
+        }
+        atomic<uint64_t> counters[telemetry::counterCount];
+        vector<span> spans;
+    };
+
+    // Every thread's data lives until the program exits, so that counts from finished threads are kept
+    struct registry{
+        mutex lock;
+        vector<unique_ptr<threadData>> threads;
+    };
+
+    registry& threadRegistry(){
+        static registry instance;
+        return instance;
+    }
+
+    atomic<bool> recordingSpans(false);
+
+    atomic<uint64_t> gauges[telemetry::gaugeCount];
+
+    CVRP_THREAD_LOCAL threadData* currentThread = nullptr;
+
+    threadData& thisThread(){
+        if (!currentThread){
+            registry& r = threadRegistry();
+            lock_guard<mutex> guard(r.lock);
+            r.threads.push_back(unique_ptr<threadData>(new threadData()));
+            currentThread = r.threads.back().get();
+        }
+        return *currentThread;
+    }
+
+    int64_t nowMicroseconds(){
+        static const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+    }
+
+    const char* counterNames[] = { "savingsGenerated", "routeMerges", "geniCandidates", "tabuMovesAccepted",
+                                   "tabuMovesRejected", "penaltyDecreases", "penaltyIncreases", "localSearchMoves",
+                                   "bestSolutions", "routeCacheHits", "routeCacheMisses", "routeCacheEvictions",
+                                   "geneticOffspring", "populationRestarts", "eliteInsertions", "pathRelinks" };
+
+    const char* gaugeNames[] = { "routeCacheRoutes" };
+
+}
+
+const char* telemetry::counterName(counter c){
+    return c < counterCount ? counterNames[c] : "unknown";
+}
+
+void telemetry::add(counter c, uint64_t n){
+    atomic<uint64_t>& value = thisThread().counters[c];
+    value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+const char* telemetry::gaugeName(gauge g){
+    return g < gaugeCount ? gaugeNames[g] : "unknown";
+}
+
+void telemetry::raise(gauge g, uint64_t value){
+    uint64_t current = gauges[g].load(memory_order_relaxed);
+    while (current < value && !gauges[g].compare_exchange_weak(current, value, memory_order_relaxed)){}
+}
+
+vector<uint64_t> telemetry::gaugeValues(){
+    vector<uint64_t> values(gaugeCount);
+    for (size_t g = 0; g < gaugeCount; g++) values[g] = gauges[g].load(memory_order_relaxed);
+    return values;
+}
+
+vector<uint64_t> telemetry::totals(){
+    vector<uint64_t> sums(counterCount, 0);
+    registry& r = threadRegistry();
+    lock_guard<mutex> guard(r.lock);
+    for (const auto& thread : r.threads){
+        for (size_t c = 0; c < counterCount; c++) sums[c] += thread->counters[c].load(memory_order_relaxed);
+    }
+    return sums;
+}
+
+void telemetry::setTracing(bool enabled){
+    recordingSpans.store(enabled && compiledIn);
+}
+
+bool telemetry::tracing(){
+    return recordingSpans.load(memory_order_relaxed);
+}
+
+void telemetry::reset(){
+    for (auto& g : gauges) g.store(0, memory_order_relaxed);
+    registry& r = threadRegistry();
+    lock_guard<mutex> guard(r.lock);
+    for (const auto& thread : r.threads){
+        for (auto& c : thread->counters) c.store(0, memory_order_relaxed);
+        thread->spans.clear();
+    }
+}
+
+void telemetry::writeCounters(ostream& out){
+    vector<uint64_t> sums = totals();
+    for (size_t c = 0; c < counterCount; c++) out << counterNames[c] << ' ' << sums[c] << '\n';
+    vector<uint64_t> values = gaugeValues();
+    for (size_t g = 0; g < gaugeCount; g++) out << gaugeNames[g] << ' ' << values[g] << '\n';
+    out.flush();
+}
+
+void telemetry::writeChromeTrace(ostream& out){
+    vector<uint64_t> sums = totals();
+    registry& r = threadRegistry();
+    lock_guard<mutex> guard(r.lock);
+    out << "{\"traceEvents\": [";
+    bool first = true;
+    for (size_t t = 0; t < r.threads.size(); t++){
+        for (const span& s : r.threads[t]->spans){
+            out << (first ? "\n" : ",\n") << "{\"name\": \"" << s.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                << t + 1 << ", \"ts\": " << s.start << ", \"dur\": " << s.duration << '}';
+            first = false;
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {";
+    for (size_t c = 0; c < counterCount; c++) out << (c ? ", " : "") << '"' << counterNames[c] << "\": \"" << sums[c] << '"';
+    vector<uint64_t> values = gaugeValues();
+    for (size_t g = 0; g < gaugeCount; g++) out << ", \"" << gaugeNames[g] << "\": \"" << values[g] << '"';
+    out << "}}" << endl;
+}
+
+telemetry::scope::scope(const char* name)
+    : name(name), start(tracing() ? nowMicroseconds() : -1) {}
+
+telemetry::scope::~scope(){
+    if (start < 0) return;
+    span s;
+    s.name = name;
+    s.start = start;
+    s.duration = nowMicroseconds() - start;
+    thisThread().spans.push_back(s);
+}
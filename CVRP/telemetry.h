@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+// Instrumentation of the solver's phases and hot paths, compiled in only when CVRP_INSTRUMENT is defined
+// (make INSTRUMENT=1). Without it the macros below expand to nothing that is evaluated, so the instrumented
+// code is exactly as fast as uninstrumented code; the functions remain available but report nothing.
+//   CVRP_COUNT(counter, n)  adds n to one of the telemetry::counter totals of the calling thread
+//   CVRP_SCOPE("name")      times the rest of the enclosing block as a span of the calling thread
+//   CVRP_GAUGE(gauge, v)    raises one of the telemetry::gauge high-water marks to v
+// Counters in hot loops should be tallied in a local variable and added once, which keeps the overhead of an
+// instrumented build to an increment per event.
+
+namespace cvrp{
+
+    namespace telemetry{
+
+        enum counter{
+            // Entries in full savings lists
+            savingsGenerated,
+            // Savings that joined two Clarke-Wright routes
+            routeMerges,
+            // GENI Type I and Type II insertions scored
+            geniCandidates,
+            // Moves made by the tabu search
+            tabuMovesAccepted,
+            // Moves discarded by the tabu search because of their tabu status
+            tabuMovesRejected,
+            // Changes to the tabu search's capacity penalty, made every feasibilityModTime iterations when the
+            // recent solutions were all feasible (decreases) or all infeasible (increases)
+            penaltyDecreases,
+            penaltyIncreases,
+            // Moves made by local search
+            localSearchMoves,
+            // New best solutions found by the tabu search
+            bestSolutions,
+            // Route cache lookups that found, or did not find, the route, and routes evicted to make room
+            routeCacheHits,
+            routeCacheMisses,
+            routeCacheEvictions,
+            // Offspring bred and educated by the hybrid genetic search, and restarts of its population
+            geneticOffspring,
+            populationRestarts,
+            // Solutions that entered an elite pool, and path relinkings between two of its members
+            eliteInsertions,
+            pathRelinks,
+            counterCount
+        };
+
+        // Quantities sampled now and then, of which the largest value seen is kept
+        enum gauge{
+            // Routes held by a route cache, sampled when the searches using it finish
+            routeCacheRoutes,
+            gaugeCount
+        };
+
+        // True if instrumentation is compiled in
+#ifdef CVRP_INSTRUMENT
+        const bool compiledIn = true;
+#else
+        const bool compiledIn = false;
+#endif
+
+        // Returns the name of a counter as used in reports
+        const char* counterName(counter c);
+
+        // Adds n to a counter of the calling thread
+        void add(counter c, uint64_t n);
+
+        // Returns the name of a gauge as used in reports
+        const char* gaugeName(gauge g);
+
+        // Raises a gauge to value if it is below it
+        void raise(gauge g, uint64_t value);
+
+        // Returns the value of every gauge
+        vector<uint64_t> gaugeValues();
+
+        // Returns the totals of every counter, summed over all threads that have counted anything. Counts made
+        // by other threads at the same time may or may not be included.
+        vector<uint64_t> totals();
+
+        // Starts or stops recording spans for writeChromeTrace; spans are only timed while recording
+        void setTracing(bool enabled);
+        bool tracing();
+
+        // Clears the gauges, and the counters and recorded spans of every thread; no thread may be counting at
+        // the time
+        void reset();
+
+        // Writes every counter total and gauge value as a "name value" line
+        void writeCounters(ostream& out);
+
+        // Writes the recorded spans as a Chrome trace (JSON viewable in chrome://tracing or Perfetto), with the
+        // counter totals and gauge values as metadata; no thread may be recording at the time
+        void writeChromeTrace(ostream& out);
+
+        // Records the time from its construction to its destruction as a span, if tracing
+        class scope{
+        public:
+            explicit scope(const char* name);
+            ~scope();
+        private:
+            scope(const scope&);
+            scope& operator=(const scope&);
+            const char* name;
+            int64_t start;
+        };
+
+    }
+
+}
+
+#define CVRP_TELEMETRY_JOIN2(a, b) a##b
+#define CVRP_TELEMETRY_JOIN(a, b) CVRP_TELEMETRY_JOIN2(a, b)
+
+#ifdef CVRP_INSTRUMENT
+#define CVRP_COUNT(c, n) ::cvrp::telemetry::add(::cvrp::telemetry::c, (n))
+#define CVRP_SCOPE(name) ::cvrp::telemetry::scope CVRP_TELEMETRY_JOIN(telemetryScope, __LINE__)(name)
+#define CVRP_GAUGE(g, v) ::cvrp::telemetry::raise(::cvrp::telemetry::g, (v))
+#else
+// sizeof keeps local tallies "used" without evaluating them, so they compile away without warnings
+#define CVRP_COUNT(c, n) ((void)sizeof(n))
+#define CVRP_SCOPE(name) ((void)0)
+#define CVRP_GAUGE(g, v) ((void)sizeof(v))
+#endif